@@ -0,0 +1,46 @@
+#pragma once
+#include <types/types.hpp>
+
+namespace nre {
+
+	//Checksums of the header and banner, in the order they have to be fixed in;
+	//the header checksum covers the secure area and logo checksum, so it's last
+	enum ChecksumType : u8 {
+		CHECKSUM_SECURE_AREA,			//NDS::sAC over [0x4000, 0x8000>; only if the secure area is still encrypted
+		CHECKSUM_LOGO,					//NDS::nLC over the logo; 0xCF56 for the real logo
+		CHECKSUM_BANNER,				//NDSBanner::Checksum over [0x20, 0x840>
+		CHECKSUM_BANNER_CHINESE,		//Version 2 and up, over [0x20, 0x940>
+		CHECKSUM_BANNER_KOREAN,			//Version 3 and up, over [0x20, 0xA40>
+		CHECKSUM_BANNER_ANIMATED,		//Version 0x103, over the animated icon [0x1240, 0x23C0>
+		CHECKSUM_HEADER,				//NDS::nHC over [0, 0x15E>
+		CHECKSUM_COUNT
+	};
+
+	struct Checksum {
+		ChecksumType type;
+		u32 offset;						//Where it's stored in the ROM
+		u16 stored, computed;
+
+		inline bool isValid() const { return stored == computed; }
+	};
+
+	struct ChecksumHelper {
+
+		//CRC16 with polynomial 0xA001 (reflected 0x8005), the one the BIOS has (SWI 0x0E)
+		//Uses slicing-by-8, so it does 8 bytes per step
+		static u16 crc16(const void *data, usz size, u16 crc = 0xFFFF);
+
+		//Returns false if the ROM doesn't have the checksum or if it can't be verified
+		static bool getChecksum(const u8 *rom, usz size, ChecksumType type, Checksum &checksum);
+
+		//All checksums the ROM has
+		static List<Checksum> getChecksums(const u8 *rom, usz size);
+
+		//Recomputes the checksums in place; returns the ones that were changed (with the old value as stored)
+		static List<Checksum> fixChecksums(u8 *rom, usz size);
+
+		static const c8 *getName(ChecksumType type);
+
+	};
+
+}
@@ -14,6 +14,48 @@ namespace nre {
 		struct { u8 r, g, b, a; };
 	};
 
+	//Bulk conversions that are dispatched to SIMD kernels the CPU supports (see color.cpp)
+	//Every kernel has a scalar version, that produces the exact same output
+	struct ColorKernels {
+
+		//Tiled 4 or 8 bit images (index with is4Bit) to linear images; w and h have to be a multiple of 8
+		//The palette has to have 16 colors for 4 bit and 256 for 8 bit images; R4_8 pads shorter palettes
+
+		using TilesToR8 = void (*)(const u8 *tiles, r8 *out, u16 w, u16 h);
+		using TilesToBGR5 = void (*)(const u8 *tiles, bgr5 *out, u16 w, u16 h, const bgr5 *palette);
+		using TilesToRGBA8 = void (*)(const u8 *tiles, rgba8 *out, u16 w, u16 h, const bgr5 *palette);
+
+		TilesToR8 tilesToR8[2];
+		TilesToBGR5 tilesToBGR5[2];
+		TilesToRGBA8 tilesToRGBA8[2];		//Palette index 0 is transparent, so those pixels aren't written
+
+		//Linear conversion between bgr5 and rgba8
+
+		using BGR5ToRGBA8 = void (*)(const bgr5 *in, rgba8 *out, usz len);
+		using RGBA8ToBGR5 = void (*)(const rgba8 *in, bgr5 *out, usz len);
+
+		BGR5ToRGBA8 bgr5ToRGBA8;
+		RGBA8ToBGR5 rgba8ToBGR5;
+
+		//Index of the closest palette color for every color, by the squared distance of the 5 bit components
+		//Ties go to the first palette color; the palette can have at most 256 colors
+
+		using NearestColors = void (*)(const bgr5 *in, u8 *out, usz len, const bgr5 *palette, usz colors);
+
+		NearestColors nearestColors;
+
+		const c8 *name;
+
+		//Best kernels for the current CPU
+		static const ColorKernels &get();
+
+		//Reference kernels
+		static const ColorKernels &scalar();
+
+		//bgr5 to rgba8 through a 32K entry lookup table (128 KiB, built on first use)
+		static void bgr5ToRGBA8Table(const bgr5 *in, rgba8 *out, usz len);
+	};
+
 	//Conversion functions for bgr5 type
 	struct BGR5 {
 
@@ -21,8 +63,9 @@ namespace nre {
 			return u8(u16(bit5) * 0xFF / 0x1F);
 		}
 
+		//Rounds to the nearest value, so from8Bit(to8Bit(x)) == x
 		static inline constexpr u16 from8Bit(u8 bit8) {
-			return u16(bit8) * 0x1F / 0xFF;
+			return u16((u16(bit8) * 0x1F + 0x7F) / 0xFF);
 		}
 
 		static inline constexpr Vec3u8 components(bgr5 v) {
@@ -30,7 +73,7 @@ namespace nre {
 		}
 
 		static inline constexpr bgr5 fromRGBA8(const rgba8 *col) {
-			return from8Bit(col->b) | (from8Bit(col->g) << 5) | (from8Bit(col->r) << 10);
+			return from8Bit(col->r) | (from8Bit(col->g) << 5) | (from8Bit(col->b) << 10);
 		}
 
 		static inline constexpr void toRGBA8(bgr5 in, rgba8 *out) {
@@ -42,13 +85,20 @@ namespace nre {
 		}
 
 		static inline void toRGBA8Image(const bgr5 *in, rgba8 *out, usz len) {
-			for (usz i = 0; i < len; ++i)
-				toRGBA8(in[i], out + i);
+			ColorKernels::get().bgr5ToRGBA8(in, out, len);
 		}
 
 		static inline void toBGR5Image(const rgba8 *in, bgr5 *out, usz len) {
-			for (usz i = 0; i < len; ++i)
-				out[i] = BGR5::fromRGBA8(in + i);
+			ColorKernels::get().rgba8ToBGR5(in, out, len);
+		}
+
+		static inline constexpr u32 distance(bgr5 a, bgr5 b) {
+			const i32 dr = i32(a & 0x1F) - (b & 0x1F), dg = i32((a >> 5) & 0x1F) - ((b >> 5) & 0x1F), db = i32((a >> 10) & 0x1F) - ((b >> 10) & 0x1F);
+			return u32(dr * dr + dg * dg + db * db);
+		}
+
+		static inline void toNearest(const bgr5 *in, u8 *out, usz len, const bgr5 *palette, usz colors) {
+			ColorKernels::get().nearestColors(in, out, len, palette, colors);
 		}
 	};
 
@@ -63,6 +113,23 @@ namespace nre {
 			return u8(u16(sample4Bit(beg, offset)) * 0xFF / 0xF);
 		}
 
+		//Palettes can be shorter than the indices can address (16 or 256 colors);
+		//those are copied into padded and zero-filled, so the conversions never read past them
+		template<bool is4Bit>
+		static inline const bgr5 *padPalette(const bgr5 *palette, usz colors, bgr5 (&padded)[is4Bit ? 16 : 256]) {
+
+			constexpr usz count = is4Bit ? 16 : 256;
+
+			if (colors >= count)
+				return palette;
+
+			if (colors)
+				std::memcpy(padded, palette, colors * sizeof(bgr5));
+
+			std::memset(padded + colors, 0, (count - colors) * sizeof(bgr5));
+			return padded;
+		}
+
 		//i = tile pixel
 		//j = tile index
 		//w = width in pixels
@@ -86,23 +153,19 @@ namespace nre {
 				if (w % 8 || h % 8)
 					return false;
 
-				usz tiles = (w >> 3) * (h >> 3);
-
-				if constexpr (!is4Bit)
-					for (usz j = 0; j < tiles; ++j)
-						for (usz i = 0; i < 64; ++i)
-							out[toLinearSpace(i, j, w)] = icon[i + (j << 6)];
-				else
-					for (usz j = 0; j < tiles; ++j)
-						for (usz i = 0; i < 64; ++i)
-							out[toLinearSpace(i, j, w)] = sample4Bit(icon, i + (j << 6));
+				ColorKernels::get().tilesToR8[is4Bit](icon, out, w, h);
 			}
 
 			return true;
 		}
 
+		//colors is the length of palette; indices past it get color 0
+
 		template<bool is4Bit, bool isTiled>
-		static inline bool toBGR5Image(const u8 *icon, bgr5 *out, u16 w, u16 h, const bgr5 *palette) {
+		static inline bool toBGR5Image(const u8 *icon, bgr5 *out, u16 w, u16 h, const bgr5 *palette, usz colors) {
+
+			bgr5 padded[is4Bit ? 16 : 256];
+			palette = padPalette<is4Bit>(palette, colors, padded);
 
 			if constexpr (!isTiled) {
 				if constexpr (!is4Bit)
@@ -116,23 +179,17 @@ namespace nre {
 				if (w % 8 || h % 8)
 					return false;
 
-				u16 tiles = (w >> 3) * (h >> 3);
-
-				if constexpr (!is4Bit)
-					for (usz j = 0; j < tiles; ++j)
-						for (usz i = 0; i < 64; ++i)
-							out[toLinearSpace(i, j, w)] = palette[icon[i + (j << 6)]];
-				else
-					for (usz j = 0; j < tiles; ++j)
-						for (usz i = 0; i < 64; ++i)
-							out[toLinearSpace(i, j, w)] = palette[sample4Bit(icon, i + (j << 6))];
+				ColorKernels::get().tilesToBGR5[is4Bit](icon, out, w, h, palette);
 			}
 
 			return true;
 		}
 
 		template<bool is4Bit, bool isTiled>
-		static inline bool toRGBA8Image(const u8 *icon, rgba8 *out, u16 w, u16 h, const bgr5 *palette) {
+		static inline bool toRGBA8Image(const u8 *icon, rgba8 *out, u16 w, u16 h, const bgr5 *palette, usz colors) {
+
+			bgr5 padded[is4Bit ? 16 : 256];
+			palette = padPalette<is4Bit>(palette, colors, padded);
 
 			if constexpr (!isTiled) {
 				if constexpr (!is4Bit)
@@ -149,19 +206,7 @@ namespace nre {
 				if (w % 8 || h % 8)
 					return false;
 
-				u16 tiles = (w >> 3) * (h >> 3);
-
-				if constexpr (!is4Bit)
-					for (usz j = 0; j < tiles; ++j)
-						for (usz i = 0; i < 64; ++i) {
-							if (auto pid = icon[i + (j << 6)])
-								BGR5::toRGBA8(palette[pid], out + toLinearSpace(i, j, w));
-						}
-				else
-					for (usz j = 0; j < tiles; ++j)
-						for (usz i = 0; i < 64; ++i)
-							if(auto pid = sample4Bit(icon, i + (j << 6)))
-								BGR5::toRGBA8(palette[pid], out + toLinearSpace(i, j, w));
+				ColorKernels::get().tilesToRGBA8[is4Bit](icon, out, w, h, palette);
 			}
 
 			return true;
@@ -0,0 +1,113 @@
+#pragma once
+#include <types/types.hpp>
+
+namespace nre {
+
+	//Compression types of the BIOS (and most games); stored in the first byte of the data
+	enum CompressionType : u8 {
+		COMPRESSION_NONE = 0x00,
+		COMPRESSION_LZ10 = 0x10,
+		COMPRESSION_LZ11 = 0x11,
+		COMPRESSION_HUFFMAN4 = 0x24,
+		COMPRESSION_HUFFMAN8 = 0x28,
+		COMPRESSION_RLE = 0x30
+	};
+
+	enum CompressionLevel : u8 {
+		COMPRESSION_FAST,				//Hash chains with a short search and one step of lazy matching
+		COMPRESSION_SMALLEST			//Longest match at every position and an optimal parse
+	};
+
+	struct CompressionInfo {
+		CompressionType type;
+		u32 headerSize;					//4, or 8 if the size didn't fit in 24 bits
+		u32 compressedSize;				//Bytes read by the decoder, including the header; only known after probe
+		u32 decompressedSize;
+	};
+
+	struct CompressionHelper {
+
+		//Anything bigger than this isn't considered compressed, since it wouldn't fit in memory on the DS anyway
+		static constexpr u32 maxDecompressedSize = 32 << 20;
+
+		//Compressed data can be followed by up to this many bytes of padding
+		static constexpr u32 maxPadding = 0x20;
+
+		//Only reads the header; a lot of uncompressed data starts with one of the type bytes, so this is only a hint
+		static bool getHeader(const u8 *data, usz size, CompressionInfo &info);
+
+		//Checks if the data is compressed by decoding it without writing any output
+		//This sets info.compressedSize and is a lot cheaper than decompressing
+		static bool probe(const u8 *data, usz size, CompressionInfo &info);
+
+		//Decompress into out; outSize has to be at least the decompressed size
+		//Returns false if the data is invalid; out can be partially written in that case
+		static bool decompress(const u8 *data, usz size, u8 *out, usz outSize);
+
+		//Decompress into a buffer that is sized from the header
+		static bool decompress(const u8 *data, usz size, Buffer &out);
+
+		//Compress with LZ10 or LZ11; the output is padded to 4 bytes like the games do
+		//Big inputs are split over threads; matches can still reach into the previous part, so that barely affects the ratio.
+		//Matches are never at distance 1, since the BIOS' VRAM decompression writes u16s and can't copy those.
+		static bool compress(
+			const u8 *data, usz size, CompressionType type, Buffer &out,
+			CompressionLevel level = COMPRESSION_FAST, usz threads = 1
+		);
+
+		static const c8 *getName(CompressionType type);
+
+		//Backward LZ ("BLZ"), used by arm9.bin and overlays; it has no type byte, but a footer at the end of the data.
+		//The data is decompressed from the back to the front in place, so the RAM it's loaded into is enough to decompress it;
+		//everything before the compressed part is stored as is.
+
+		//Only reads the footer; extraSize is how much bigger the data gets
+		static bool getBLZFooter(const u8 *data, usz size, u32 &compressedSize, u32 &footerSize, u32 &extraSize);
+
+		//Decompress into out; data without extra size (it wasn't worth compressing) is copied
+		static bool decompressBLZ(const u8 *data, usz size, Buffer &out);
+
+		//Compress with BLZ; the first uncompressed bytes are stored as is (0x4000 for arm9.bin, where the secure area is).
+		//More data can be left uncompressed if that's smaller, or if the decoder would overwrite data it still has to read.
+		//Returns false if the data doesn't get smaller, so it should be stored uncompressed.
+		static bool compressBLZ(
+			const u8 *data, usz size, Buffer &out, usz uncompressed = 0,
+			CompressionLevel level = COMPRESSION_FAST, usz threads = 1
+		);
+
+		//LCG the games use to scramble data
+		static inline constexpr u32 generateRandom(u32 seed) {
+			return seed * 0x41C64E6D + 0x6073;
+		}
+
+		//Random numbers that are XORed with u16s, from the last u16 to the first
+		//Only the low 16 bits of the seed are used as key, so the stream can be generated 8 u16s at a time.
+		//Calling xorBackward on consecutive chunks (last chunk first) is the same as calling it on all of them at once.
+		struct RandomStream {
+
+			u32 seed;
+
+			//out[i] = in[i] ^ key for i = count - 1 down to 0; in and out can be the same
+			void xorBackward(const u16 *in, u16 *out, usz count);
+		};
+
+		//Decrypts RAHC data in place; the last u16 is the seed
+		static inline void decryptRAHC(u16 *data, usz count) {
+			if (count)
+				RandomStream{ data[count - 1] }.xorBackward(data, data, count);
+		}
+
+		//Encrypts RAHC data in place
+		//The last u16 holds the seed (decrypting always makes it 0), so it has to be 0; returns false otherwise
+		static inline bool encryptRAHC(u16 *data, usz count, u16 seed) {
+
+			if (!count || data[count - 1])
+				return false;
+
+			RandomStream{ seed }.xorBackward(data, data, count);
+			return true;
+		}
+
+	};
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "nds_file_system.hpp"
+
+namespace nre {
+
+	//A file of a ROM and the hash of its data
+	struct ContentEntry {
+		String path;				//~/a/b.bin; files in archives are in ~/a/c.narc.d/
+		u32 offset, size;			//Offset into the ROM
+		u64 hash;					//XXH64 of the data
+	};
+
+	//The hashes of all files of a ROM, so ROMs can be compared without reading them again
+	//The index is saved next to the ROM and stores the size and modification time of the ROM;
+	//if either changed, the index is out of date and has to be built again.
+	//
+	class ContentIndex {
+
+	public:
+
+		ContentIndex() = default;
+
+		//Hashes all files in parallel, straight from the data the file system points to
+		ContentIndex(const NDSFileSystem &fs, bool walkArchives, usz threads);
+
+		//Returns false if the file isn't an index, or if it was made for another version of the ROM or other settings
+		bool load(const String &file, u64 romSize, i64 romTime, bool walkArchives);
+
+		bool save(const String &file, u64 romSize, i64 romTime) const;
+
+		inline const List<ContentEntry> &getEntries() const { return entries; }
+		inline bool hasArchives() const { return walkArchives; }
+
+		//Where the index of a ROM is stored (./rom.nds -> ./rom.index)
+		static String getPath(const String &rom);
+
+	private:
+
+		struct Header {
+			c8 magic[4];				//NRIX
+			u32 version;
+			u64 romSize;
+			i64 romTime;
+			u32 entries;
+			u32 flags;					//1 if archives were walked
+		};
+
+		static constexpr u32 version = 1;
+
+		List<ContentEntry> entries;
+		bool walkArchives{};
+	};
+
+}
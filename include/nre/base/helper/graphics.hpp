@@ -0,0 +1,58 @@
+#pragma once
+#include "../types/image.hpp"
+
+namespace nre {
+
+	//How an image is turned into graphics
+	struct GraphicsEncoding {
+
+		bool is4Bit = true;
+		bool hasScreen = true;				//Identical (and flipped) tiles are stored once and laid out by an NSCR
+		bool isLinear = false;				//Pixels are stored row by row instead of as tiles; can't be used with a screen
+
+		//Used as is if not empty (index 0 is transparent), otherwise a palette is made for the image.
+		//4-bit graphics with a screen can use up to 16 palettes of 16 colors here; every tile picks the one that fits it best.
+		List<bgr5> palette;
+
+		usz iterations = 4;					//k-means iterations when a palette is made
+	};
+
+	struct EncodedGraphics {
+
+		Buffer ncgr, nclr, nscr;			//nscr is empty without a screen
+		List<bgr5> palette;
+
+		usz tiles;
+		u64 error;							//Summed squared error of the bgr5 colors; 0 if the image is exact
+	};
+
+	//Decoding of graphics (NCGR) with their palette (NCLR) and screen (NSCR) into RGBA8 images, and encoding them again
+	//Palette index 0 is transparent, so those pixels are left as 0
+	struct GraphicsHelper {
+
+		//The size of the image; the screen decides it if there is one, otherwise the NCGR does
+		//If the NCGR doesn't store its size, the tiles are laid out at most 32 tiles wide
+		static bool getSize(const NCGR &ncgr, const NSCR *nscr, u16 &w, u16 &h);
+
+		//Decode the graphics into out; resized to w * h
+		//isEncrypted decrypts the characters first (CompressionHelper::decryptRAHC); only some titles encrypt their graphics
+		//and the NCGR doesn't say so, so this has to be known up front. Encrypted graphics are linear and can't have a screen.
+		static bool toRGBA8Image(
+			const NCGR &ncgr, const NCLR &nclr, const NSCR *nscr, List<rgba8> &out, u16 &w, u16 &h, bool isEncrypted = false
+		);
+
+		//Decode the graphics into palette indices, without losing which colors they point to
+		//4-bit graphics without a screen keep their 16 colors; with a screen, the palette of every tile is added to its indices.
+		//palette is resized to the colors the indices can reach (at most 256); colors the NCLR doesn't have are 0.
+		static bool toIndexedImage(
+			const NCGR &ncgr, const NCLR &nclr, const NSCR *nscr,
+			List<r8> &out, List<bgr5> &palette, u16 &w, u16 &h, bool isEncrypted = false
+		);
+
+		//Encode an image (w and h a multiple of 8) as unencrypted graphics
+		//Returns false if the size is invalid or if a screen would need more than 1024 different tiles
+		static bool fromRGBA8Image(const rgba8 *pixels, u16 w, u16 h, const GraphicsEncoding &encoding, EncodedGraphics &out);
+
+	};
+
+}
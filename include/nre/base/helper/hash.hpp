@@ -0,0 +1,15 @@
+#pragma once
+#include <types/types.hpp>
+
+namespace nre {
+
+	//Fast non-cryptographic hashes, for comparing files without comparing their data
+
+	struct HashHelper {
+
+		//XXH64; the same as the reference implementation, so hashes can be compared with other tools
+		static u64 xxh64(const void *data, usz size, u64 seed = 0);
+
+	};
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "../types/model.hpp"
+
+namespace nre {
+
+	//A texture of a TEX0; offsets are relative to the TEX0
+	struct TextureEntry {
+
+		String name;
+		String palette;						//Empty for direct color textures
+
+		TextureFormat format;
+		u16 w, h;
+		bool isColor0Transparent;			//Only for formats with a palette of 4, 16 or 256 colors
+
+		usz data;							//Texels
+		usz blockPalettes;					//Palette of every 4x4 block; usz_MAX for other formats
+		usz paletteData;					//usz_MAX if there's no palette
+	};
+
+	//The geometry of a model, as stored in its header
+	struct ModelSummary {
+		String name;
+		u16 vertices, polygons, triangles, quads;
+		u8 nodes, materials, shapes;
+	};
+
+	//Decoding of textures (TEX0) into RGBA8 images and summaries of models (MDL0)
+	//Transparent pixels are left as 0
+	struct ModelHelper {
+
+		//Textures with the palette they use; a texture uses the palette with its name (or its name + "_pl"),
+		//otherwise the palette with the same index or the only palette there is
+		static bool getTextures(const TEX0 *tex0, List<TextureEntry> &out);
+
+		static bool getModels(const MDL0 *mdl0, List<ModelSummary> &out);
+
+		//Size of the texels (and palette indices of 4x4 blocks) in VRAM
+		static usz getTextureSize(const TextureEntry &texture);
+
+		static const c8 *getFormatName(TextureFormat format);
+
+		//Decode a texture into out; resized to w * h
+		//Returns false if the texture or its palette doesn't fit in the TEX0
+		static bool toRGBA8Image(const TEX0 *tex0, const TextureEntry &texture, List<rgba8> &out);
+
+		//Decode every texture over the threads; textures that can't be decoded are left empty
+		//Returns how many textures were decoded
+		static usz toRGBA8Images(const TEX0 *tex0, const List<TextureEntry> &textures, List<List<rgba8>> &out, usz threads);
+
+		//Decode a 4x4 block into out, with stride pixels per row
+		//info is the mode (14-15) and palette offset (0-13) of the block, palette points to the colors at that offset;
+		//modes 0 and 2 read 3 and 4 colors, modes 1 and 3 read 2 and interpolate the others
+		static void decode4x4Block(u32 texels, u16 info, const bgr5 *palette, rgba8 *out, usz stride);
+
+	};
+
+}
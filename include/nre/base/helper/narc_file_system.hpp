@@ -0,0 +1,26 @@
+#pragma once
+#include "nds_file_system.hpp"
+#include "../types/archive.hpp"
+
+namespace nre {
+
+	//Implementation of oic FileSystem for a NARC
+	//The archive is read in place, so files point into the data it was opened from (usually the ROM mapping);
+	//that data has to outlive the file system and writes to files go straight into it.
+	//
+	class NARCFileSystem : public NDSFileSystem {
+
+	public:
+
+		NARCFileSystem(u8 *data, usz size) noexcept(false);
+
+		//If the data starts with a NARC header; doesn't check if the archive is valid
+		static bool isArchive(const void *data, usz size);
+
+	private:
+
+		//Archives without names get "<id>.bin" as names; the names have to outlive the file system
+		Buffer names;
+	};
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <system/file_system.hpp>
+#include <string_view>
+
+namespace nre {
+
+	//Lookup index for the files of a ROM, without any heap allocations per lookup
+	//Names point into the FNT and every entry is hashed by its full path (FNV-1a),
+	//so finding a path is one pass over the path and (usually) a single probe.
+	//The hash of a child continues from the hash of its parent, so it never has to build the path string.
+	//
+	class NDSFileIndex {
+
+	public:
+
+		static constexpr oic::FileHandle notFound = oic::FileHandle(-1);
+
+		//Ranges of the children of a folder; [folders, files> are folders and [files, end> are files
+		struct Children {
+			oic::FileHandle folders, files, end;
+		};
+
+		NDSFileIndex() = default;
+		NDSFileIndex(const List<oic::FileInfo> &files, List<std::string_view> names);
+
+		//Find a file or folder by path; ~/a/b.bin, /a/b.bin and a/b.bin are the same
+		oic::FileHandle find(std::string_view path) const;
+
+		//Find the direct child of a folder
+		oic::FileHandle findChild(oic::FileHandle folder, std::string_view name) const;
+
+		inline std::string_view getName(oic::FileHandle handle) const { return names[handle]; }
+		inline oic::FileHandle getParent(oic::FileHandle handle) const { return parents[handle]; }
+		inline const Children &getChildren(oic::FileHandle folder) const { return children[folder]; }
+		inline usz size() const { return names.size(); }
+
+	private:
+
+		static constexpr u64 rootHash = 0xCBF29CE484222325;
+
+		static inline u64 hash(u64 h, std::string_view str) {
+
+			for (const c8 c : str) {
+				h ^= u8(c);
+				h *= 0x100000001B3;
+			}
+
+			return h;
+		}
+
+		static inline u64 childHash(u64 parent, bool isRoot, std::string_view name) {
+			return hash(isRoot ? parent : hash(parent, "/"), name);
+		}
+
+		bool matches(oic::FileHandle handle, std::string_view path) const;
+
+		List<std::string_view> names;
+		List<oic::FileHandle> parents;
+		List<Children> children;
+		List<u64> hashes;
+
+		List<oic::FileHandle> table;		//Open addressing; handle + 1, 0 = empty
+		usz mask{};
+	};
+
+}
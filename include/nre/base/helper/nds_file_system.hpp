@@ -1,6 +1,9 @@
 #pragma once
 #include "../types/nds.hpp"
+#include "nds_file_index.hpp"
 #include <system/file_system.hpp>
+#include <memory>
+#include <mutex>
 
 namespace nre {
 
@@ -29,6 +32,34 @@ namespace nre {
 
 		oic::File *open(const oic::FileInfo &inf, ns, ns) final override;
 
+		//The id of a file is its index into the FAT, the id of a folder is its index into the FNT
+		inline u16 getId(oic::FileHandle handle) const { return ids[handle]; }
+
+		//Files before this id aren't in the FNT; they're used by the overlays
+		inline u16 getFirstFileId() const { return firstFileId; }
+
+		//nullptr if the file system isn't of a ROM (NARCFileSystem)
+		inline NDS *getNDS() const { return nds; }
+
+		//Allocation free path lookups; names point into the FNT
+		inline const NDSFileIndex &getIndex() const { return index; }
+
+		struct Overlay {
+			const OVTEntry *entry;
+			bool isArm7;
+			oic::FileInfo file;				//Virtual file with the data as stored (~/overlay9/overlay9_0000.bin)
+		};
+
+		//Overlays of the ARM9 and then the ARM7, in table order
+		//They're not in the FNT, so they're kept apart from the virtual files (and -export-files or the repacker don't see them)
+		inline const List<Overlay> &getOverlays() const { return overlays; }
+
+		//The data of an overlay or arm9.bin; BLZ compressed data is decompressed on first access and the result is kept,
+		//so the data stays valid as long as the file system. Safe to call from multiple threads.
+		//Returns false if it couldn't be decompressed (or there's no ROM)
+		bool getOverlayData(usz overlay, const u8 *&data, usz &size) const;
+		bool getArm9Data(const u8 *&data, usz &size) const;
+
 		const oic::FileInfo local(const String&) const final override { return {}; }
 		bool hasLocal(const String&) const final override { return false; }
 		bool hasLocalRegion(const String&, oic::FileSize, oic::FileSize) const final override { return false; }
@@ -39,6 +70,12 @@ namespace nre {
 
 	protected:
 
+		//Builds the files from a FNT and FAT; the FAT has the begin and end of every file, relative to data
+		void parse(u8 *fnt, usz fntSize, const u32 *fat, u32 fatCount, u8 *data, usz dataSize) noexcept(false);
+
+		//Reads an overlay table; the files are looked up in the FAT
+		void parseOverlays(u32 offset, u32 size, bool isArm7) noexcept(false);
+
 		//Only writes have to be reported, but currently there's no real use for this
 
 		void startFileWatcher(const String&) final override {}
@@ -49,6 +86,22 @@ namespace nre {
 		bool makeLocal(const String&, bool) final override { return false; }
 		bool delLocal(const String&) final override { return false; }
 		void initFiles() final override {}
+
+	private:
+
+		NDS *nds;
+		NDSFileIndex index;
+		List<u16> ids;
+		u16 firstFileId{};
+
+		struct Decompressed {
+			std::once_flag once;
+			Buffer data;
+			bool isValid{};
+		};
+
+		List<Overlay> overlays;
+		std::unique_ptr<Decompressed[]> decompressed;			//One per overlay, then one for arm9.bin
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+#include "../types/nds.hpp"
+#include <string_view>
+
+namespace nre {
+
+	//Lazy view of the FNT and FAT of a ROM, for tools that don't need the full NDSFileSystem
+	//Opening it only reads the folder table, so it's O(folders) instead of O(files + path bytes).
+	//The entries of a folder are decoded the first time it's enumerated or searched, names are views into the FNT.
+	//Decoding fills a cache, so a table can't be shared between threads.
+	//
+	class NDSFileTable {
+
+	public:
+
+		struct Entry {
+			std::string_view name;
+			u16 id;					//Folder id if isFolder, otherwise the file id
+			bool isFolder;
+		};
+
+		NDSFileTable(const NDS *nds) noexcept(false);
+
+		inline u16 getFolderCount() const { return folderCount; }
+		inline u16 getFirstFileId() const { return folders->firstFilePosition; }
+		inline u32 getFileCount() const { return fileCount; }
+
+		//The parent always has a lower id than the folder
+		inline u16 getParent(u16 folder) const { return folder ? u16(folders[folder].relation - 0xF000) : 0; }
+
+		//Entries of a folder, in the order of the FNT
+		const List<Entry> &getEntries(u16 folder) const noexcept(false);
+
+		//Find a file or folder by path (~/a/b.bin or a/b.bin); only decodes the folders along the path
+		bool find(std::string_view path, Entry &entry) const noexcept(false);
+
+		//Get the data of a file from the FAT
+		bool getFile(u16 fileId, const u8 *&data, u32 &size) const;
+
+	private:
+
+		void decode(u16 folder) const noexcept(false);
+
+		const u8 *rom;
+		const FNTFolder *folders;
+		const u32 *fat;
+
+		u32 fntSize, romSize, fileCount;
+		u16 folderCount;
+
+		mutable List<List<Entry>> entries;
+		mutable List<bool> decoded;
+	};
+
+}
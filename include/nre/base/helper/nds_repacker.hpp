@@ -0,0 +1,78 @@
+#pragma once
+#include "nds_file_system.hpp"
+#include "rom_mapping.hpp"
+
+namespace nre {
+
+	//Builds a new ROM from a parsed one, where files can be replaced (and grow) or added
+	//The layout, FNT, FAT and header offsets are regenerated and the ROM is written in one sequential pass
+	//Unchanged data is copied from the source ROM by the kernel where possible (copy_file_range/sendfile)
+	//
+	//The file system is only used for the folder structure, so it can come from any mapping of the same ROM.
+	//
+	//File ids are kept as long as no files are added, since games tend to load files by id.
+	//The overlay tables only refer to file ids, so those can be copied as is (unless they're replaced).
+	//
+	class NDSRepacker {
+
+	public:
+
+		NDSRepacker(const ROMMapping &rom, const NDSFileSystem &fs) noexcept(false);
+
+		//Replace the data of a file by path (~/a/b.bin) or by file id (for overlays)
+		bool replace(const String &path, Buffer data);
+		bool replace(u16 fileId, Buffer data);
+
+		//Add a file that doesn't exist yet; folders that don't exist yet are created
+		bool add(const String &path, Buffer data);
+
+		//Replace arm9.bin; the footer after it (that points to the module params) is kept
+		bool replaceArm9(Buffer data);
+
+		//Replace the overlay table of the ARM9 or ARM7 (the size of an overlay is in there, next to its file id)
+		bool replaceOverlayTable(bool isArm7, Buffer table);
+
+		//Write the new ROM to disk
+		bool write(const String &path) const;
+
+		inline bool hasChanges() const { return changes; }
+
+	private:
+
+		struct Entry {
+			String name;
+			u16 id;					//Folder id if isFolder, otherwise the file id
+			bool isFolder;
+		};
+
+		struct Folder {
+			u16 parent;
+			u16 firstFile;			//First file id in the source ROM; u16_MAX for new folders
+			List<Entry> entries;
+		};
+
+		struct FileData {
+			const u8 *ptr;			//Data in the source ROM if it isn't replaced
+			u32 size;
+			bool isReplaced;
+			Buffer replacement;
+		};
+
+		//Finds the folder and the entry in it (usz_MAX if it's the folder itself)
+		bool find(const String &path, u16 &folder, usz &entry) const;
+
+		const ROMMapping &rom;
+		const NDS *nds;
+
+		List<Folder> folders;		//Indexed by folder id
+		List<FileData> files;		//Indexed by file id of the source ROM; added files are appended
+
+		FileData arm9;				//Including the footer, if there is one
+		u32 arm9FooterSize{};
+		FileData overlayTables[2];	//ARM9, ARM7
+
+		u16 firstFileId;
+		bool changes{};
+	};
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <types/types.hpp>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+namespace nre {
+
+	//Helpers for spreading independent work items over threads
+
+	struct Parallel {
+
+		static inline usz hardwareThreads() {
+			return std::max(usz(1), usz(std::thread::hardware_concurrency()));
+		}
+
+		//Calls func(i) for every i in [0, count>
+		//Threads pull the next index when they're done, so uneven work items are still balanced
+		//The calling thread does work as well, so threads = 1 runs everything in place
+
+		template<typename Func>
+		static inline void forEach(usz count, usz threads, const Func &func) {
+
+			threads = std::min(threads, count);
+
+			if (threads <= 1) {
+
+				for (usz i = 0; i < count; ++i)
+					func(i);
+
+				return;
+			}
+
+			std::atomic<usz> next{};
+
+			auto worker = [&]() {
+				for (usz i = next++; i < count; i = next++)
+					func(i);
+			};
+
+			List<std::thread> pool;
+			pool.reserve(threads - 1);
+
+			for (usz i = 1; i < threads; ++i)
+				pool.emplace_back(worker);
+
+			worker();
+
+			for (auto &t : pool)
+				t.join();
+		}
+
+	};
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <types/types.hpp>
+
+namespace nre {
+
+	//Binary patches that turn one ROM into another
+	//
+	//A patch is a list of operations that write the target from front to back:
+	//COPY takes bytes from the source ROM and INSERT has the bytes in the patch.
+	//Files are matched by path (and overlays by id), so files that moved are still copied from the source.
+	//Everything else (header, binaries, tables and padding) is matched against the same part of the source.
+	//
+	//Format: Header, then ops until the target is complete; all numbers are LEB128
+	//op = (length - 1) << 1 | isCopy
+	//COPY: zigzag(offset - end of the previous COPY)
+	//INSERT: length bytes
+	//
+	struct PatchHelper {
+
+		struct Header {
+			c8 magic[4];				//NRPT
+			u32 version;
+			u64 sourceSize, targetSize;
+			u64 sourceHash, targetHash;	//XXH64
+		};
+
+		static constexpr u32 version = 1;
+
+		//Files are diffed in parallel with a rolling hash; the source or target doesn't have to be a ROM,
+		//but then it's diffed as a single file
+		static bool create(const u8 *source, usz sourceSize, const u8 *target, usz targetSize, Buffer &patch, usz threads = 1);
+
+		//Writes the target to a file while reading the patch, so the memory used doesn't depend on the size of either
+		//Returns false if the patch isn't for this source or if the result doesn't match the target it was made for
+		static bool apply(const u8 *source, usz sourceSize, const String &patch, const String &target);
+
+	};
+
+}
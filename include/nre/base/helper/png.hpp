@@ -0,0 +1,55 @@
+#pragma once
+#include "color.hpp"
+
+namespace nre {
+
+	enum PNGFormat : u8 {
+		PNG_R8,							//Grayscale; used for indices without a palette
+		PNG_RGBA8,
+		PNG_INDEXED4,					//Palette indices (one r8 per pixel, < 16); packed to 4 bits per pixel
+		PNG_INDEXED8					//Palette indices (one r8 per pixel)
+	};
+
+	//PNG encoding without any dependencies, tuned for exports of a lot of small images
+	//
+	//Rows of RGBA images pick the filter with the smallest sum of absolute differences;
+	//single channel images are indices (not gradients), so those aren't filtered at all.
+	//Indexed images store the bgr5 palette as is (PLTE) and palette index 0 as transparent (tRNS), like the DS does.
+	//The data is compressed with a fast deflate (greedy hash chains, a dynamic Huffman block per 64Ki symbols).
+	//
+	struct PNGHelper {
+
+		//Appends the PNG to out; pixels are w * h of r8 or rgba8
+		//Indexed formats need a palette of 1-16 (PNG_INDEXED4) or 1-256 (PNG_INDEXED8) colors
+		//and every index has to be in the palette; otherwise nothing is written and this returns false.
+		static bool encode(
+			const void *pixels, u16 w, u16 h, PNGFormat format, Buffer &out,
+			const bgr5 *palette = nullptr, u16 colors = 0
+		);
+
+		//Encodes and writes the PNG to a local file in one go
+		//This is safe to call from multiple threads, as long as the folder already exists
+		static bool write(
+			const String &file, const void *pixels, u16 w, u16 h, PNGFormat format,
+			const bgr5 *palette = nullptr, u16 colors = 0
+		);
+
+		//Decodes a PNG of any color type and bit depth (but not interlaced) to rgba8
+		//Images with 16 bits per channel keep the most significant 8 bits.
+		static bool decode(const u8 *data, usz size, List<rgba8> &out, u16 &w, u16 &h);
+
+		//Reads and decodes a PNG from a local file
+		static bool read(const String &file, List<rgba8> &out, u16 &w, u16 &h);
+
+		//Appends a zlib stream of the data to out
+		static void deflate(const u8 *data, usz size, Buffer &out);
+
+		//Appends the decompressed zlib stream to out; returns false if it's invalid or its checksum doesn't match
+		static bool inflate(const u8 *data, usz size, Buffer &out);
+
+		static u32 crc32(const void *data, usz size, u32 crc = 0);
+		static u32 adler32(const u8 *data, usz size, u32 adler = 1);
+
+	};
+
+}
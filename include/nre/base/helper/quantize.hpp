@@ -0,0 +1,29 @@
+#pragma once
+#include "color.hpp"
+
+namespace nre {
+
+	//Palettes for importing images as 4 or 8 bit graphics
+	//Palette index 0 is transparent on the DS, so pixels with a low alpha map to it and the colors start at index 1.
+	//Everything happens in bgr5, since that's all the DS can show; images with few enough bgr5 colors are kept exact.
+	struct QuantizeHelper {
+
+		//Pixels with a lower alpha are transparent
+		static constexpr u8 alphaThreshold = 0x80;
+
+		//Palette of at most maxColors (2-256, including the transparent index 0, which is set to 0) for the pixels
+		//Median cut on the histogram of bgr5 colors, refined by a few iterations of k-means
+		static void createPalette(const rgba8 *pixels, usz count, usz maxColors, List<bgr5> &palette, usz iterations = 4);
+
+		//Index of the nearest palette color (never index 0) for every pixel; transparent pixels get 0
+		//Colors are matched once per unique bgr5 color, so this is cheap for big images.
+		//Returns the summed squared error of the opaque pixels.
+		static u64 remap(const rgba8 *pixels, usz count, const bgr5 *palette, usz colors, r8 *indices);
+
+		//bgr5 of every pixel, or transparent if its alpha is too low
+		static constexpr bgr5 transparent = 0x8000;
+		static void toBGR5(const rgba8 *pixels, usz count, bgr5 *out);
+
+	};
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "../types/nds.hpp"
+
+namespace nre {
+
+	//Shape of a generated ROM; the same seed and shape always give the same ROM
+	struct ROMShape {
+
+		u64 seed{};
+
+		u32 files = 4096;					//Files in the FNT; together with the overlays there can be at most 65536 (ids are u16)
+		u16 folders = 256;					//1-4096, since folder ids are 0xF000-0xFFFF; folders can end up without files
+		u16 depth = 8;						//Folders are nested in chains of this depth under the root
+		u8 nameLength{};					//Names are padded to this length (up to 127); 0 keeps them short
+
+		u32 fileSize = 2048;				//Average size of plain files (and overlays); sizes are between 0.5x and 1.5x this
+
+		u16 arm9Overlays{}, arm7Overlays{};	//Their files come first in the FAT, like in real ROMs
+		u32 archives{};						//Files that are NARCs (without names) of archiveFiles plain files
+		u16 archiveFiles = 16;
+		u32 graphics{};						//256x192 4 bit NCGRs; each is followed by an NCLR with the same name, so files has to fit both
+		u32 textures{};						//BTX0s with a 64x64 texture of every format; these come after the graphics
+	};
+
+	//Generates structurally valid ROMs for scale testing, so no real dumps are needed:
+	//header, arm9 (with module params) and arm7 stubs, overlay tables, FNT, FAT, banner and the files.
+	//Files are generated one at a time, so writing to disk only keeps the FNT, FAT and the current file in memory.
+	//
+	struct ROMGenerator {
+
+		//Returns false if the shape doesn't fit in a ROM (too many files or folders, or more than 4 GiB)
+		static bool validate(const ROMShape &shape);
+
+		//Size of the ROM in bytes, or 0 if the shape isn't valid
+		static u64 getSize(const ROMShape &shape);
+
+		//Streams the ROM to a local file
+		static bool write(const String &file, const ROMShape &shape);
+
+		//Generates the ROM in memory; out is replaced
+		static bool generate(const ROMShape &shape, Buffer &out);
+
+	};
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <types/types.hpp>
+
+namespace nre {
+
+	//A ROM mapped into memory instead of being read into a Buffer
+	//Pages are only loaded once they are touched, so reading the header doesn't load the whole ROM
+	//
+	class ROMMapping {
+
+	public:
+
+		enum Mode : u8 {
+			READ,				//Read only view of the file; writing to it is an access violation
+			COPY_ON_WRITE		//Writes are allowed, but are private to this mapping and never reach the file
+		};
+
+		ROMMapping(const String &path, Mode mode = READ) noexcept(false);
+		~ROMMapping();
+
+		ROMMapping(const ROMMapping&) = delete;
+		ROMMapping(ROMMapping&&) = delete;
+		ROMMapping &operator=(const ROMMapping&) = delete;
+		ROMMapping &operator=(ROMMapping&&) = delete;
+
+		inline u8 *data() const { return ptr; }
+		inline usz size() const { return length; }
+		inline Mode getMode() const { return mode; }
+
+	#ifndef _WIN32
+		//Allows copying from the ROM file without going through the mapping (e.g. copy_file_range)
+		inline int getFileDescriptor() const { return fd; }
+	#endif
+
+	private:
+
+		u8 *ptr{};
+		usz length{};
+		Mode mode;
+
+	#ifdef _WIN32
+		void *file{}, *mapping{};
+	#else
+		int fd = -1;
+	#endif
+
+	};
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "generic_resource.hpp"
+#include "nds.hpp"
+
+namespace nre {
+
+	//File allocation table; begin and end of every file, relative to the data of GMIF
+	struct BTAF : GenericSection<SECTION_BTAF, u32> {
+		u16 fileCount;
+		u16 padding;						//0x0000
+	};
+
+	//File name table; same as the FNT of a ROM
+	//Archives without names only have the root folder, without any entries
+	struct BTNF : GenericSection<SECTION_BTNF, FNTFolder> {};
+
+	//File data
+	struct GMIF : GenericSection<SECTION_GMIF, u8> {};
+
+	//Archive ("Nitro archive") resource
+	typedef GenericResource<RESOURCE_NARC, BTAF, BTNF, GMIF> NARC;
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <types/types.hpp>
+#include <tuple>
 
 namespace nre {
 
@@ -8,7 +9,8 @@ namespace nre {
 		RESOURCE_NCGR = 0x4E434752,
 		RESOURCE_NCSR = 0x4E534352,
 		RESOURCE_NARC = 0x4352414E,
-		RESOURCE_BMD0 = 0x30444D42
+		RESOURCE_BMD0 = 0x30444D42,
+		RESOURCE_BTX0 = 0x30585442
 	};
 
 	struct GenericHeader {
@@ -35,10 +37,136 @@ namespace nre {
 	template<SectionType sectionType, typename DataType>
 	struct GenericSection {
 
+		using Data = DataType;
+
 		SectionType type;
 		u32 size;
 
 		static constexpr SectionType getSectionType() { return sectionType; }
 	};
 
+	//The data that follows the header of a section, and how many elements of it fit in the section
+
+	template<typename Section>
+	static inline const typename Section::Data *getSectionData(const Section *section) {
+		return (const typename Section::Data*)(section + 1);
+	}
+
+	template<typename Section>
+	static inline usz getSectionDataCount(const Section *section) {
+		return (section->size - sizeof(Section)) / sizeof(typename Section::Data);
+	}
+
+	//A resource that is read in place; the header and sections point into the file data
+	//The first section is required, the others are optional
+	template<ResourceType resourceType, typename ...Sections>
+	struct GenericResource {
+
+		const GenericHeader *header{};
+		std::tuple<const Sections*...> sections{};
+
+		static constexpr ResourceType getResourceType() { return resourceType; }
+
+		//Returns false if the data isn't this resource or if the first section is missing
+		//Sections that don't fit in the data (or are too small for their header) are ignored
+		bool parse(const u8 *data, usz size) {
+
+			header = nullptr;
+			sections = {};
+
+			if (size < sizeof(GenericHeader))
+				return false;
+
+			const GenericHeader *head = (const GenericHeader*) data;
+
+			if (head->type != resourceType || head->headerSize < sizeof(GenericHeader) || head->headerSize > size)
+				return false;
+
+			usz offset = head->headerSize;
+
+			for (u16 i = 0; i < head->sections && offset + 8 <= size; ++i) {
+
+				const SectionType type = *(const SectionType*)(data + offset);
+				const u32 sectionSize = *(const u32*)(data + offset + 4);
+
+				if (sectionSize < 8 || sectionSize > size - offset)
+					break;
+
+				(setSection<Sections>(data + offset, type, sectionSize), ...);
+				offset += sectionSize;
+			}
+
+			header = head;
+			return std::get<0>(sections);
+		}
+
+		template<typename Section>
+		inline const Section *get() const { return std::get<const Section*>(sections); }
+
+	private:
+
+		template<typename Section>
+		inline void setSection(const u8 *ptr, SectionType type, u32 sectionSize) {
+			if (type == Section::getSectionType() && sectionSize >= sizeof(Section))
+				std::get<const Section*>(sections) = (const Section*) ptr;
+		}
+	};
+
+	//A resource of the 3D engine; the header is followed by the offset of every section, rather than sections that follow each other
+	//The first section is required, the others are optional
+	template<ResourceType resourceType, typename ...Sections>
+	struct GenericOffsetResource {
+
+		const GenericHeader *header{};
+		std::tuple<const Sections*...> sections{};
+
+		static constexpr ResourceType getResourceType() { return resourceType; }
+
+		bool parse(const u8 *data, usz size) {
+
+			header = nullptr;
+			sections = {};
+
+			if (size < sizeof(GenericHeader))
+				return false;
+
+			const GenericHeader *head = (const GenericHeader*) data;
+
+			if (head->type != resourceType || head->headerSize < sizeof(GenericHeader) || head->headerSize + usz(head->sections) * 4 > size)
+				return false;
+
+			const u32 *offsets = (const u32*)(data + head->headerSize);
+
+			for (u16 i = 0; i < head->sections; ++i) {
+
+				const usz offset = offsets[i];
+
+				if (offset > size || size - offset < 8)
+					continue;
+
+				const SectionType type = *(const SectionType*)(data + offset);
+				const u32 sectionSize = *(const u32*)(data + offset + 4);
+
+				if (sectionSize < 8 || sectionSize > size - offset)
+					continue;
+
+				(setSection<Sections>(data + offset, type, sectionSize), ...);
+			}
+
+			header = head;
+			return std::get<0>(sections);
+		}
+
+		template<typename Section>
+		inline const Section *get() const { return std::get<const Section*>(sections); }
+
+	private:
+
+		template<typename Section>
+		inline void setSection(const u8 *ptr, SectionType type, u32 sectionSize) {
+			if (type == Section::getSectionType() && sectionSize >= sizeof(Section))
+				std::get<const Section*>(sections) = (const Section*) ptr;
+		}
+	};
+
 }
\ No newline at end of file
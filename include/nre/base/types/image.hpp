@@ -10,7 +10,7 @@ namespace nre {
 		u32 bitDepth;						//3 = 4 bits, 4 = 8 bits
 		u32 padding;						//0x00000000
 		u32 dataSize;						//size of palette data in bytes; if(size > 0x200) size = 0x200 - size;
-		u32 colors;							//0x00000010
+		u32 colors;							//0x00000010; offset of the palette data from the end of the size field
 	};
 
 	using PaletteId = u16;
@@ -24,8 +24,8 @@ namespace nre {
 	//Palette ("Color") resource
 	typedef GenericResource<RESOURCE_NCLR, TTLP, PMCP> NCLR;
 
-	//The contents of RAHC can be "encrypted";
-	//This means that the image needs to be XORed with a magic texture
+	//The contents of RAHC can be "encrypted" by some titles, which the file itself doesn't say;
+	//This means that the image needs to be XORed with a magic texture (CompressionHelper::decryptRAHC)
 	//u32 seed = texture[end()];
 	//for(i32 i = end(); i >= begin(); --i) { magic[i] = seed; seed = CompressionHelper::generateRandom(seed); }
 	struct RAHC : GenericSection<SECTION_RAHC, r4_8> {
@@ -35,7 +35,7 @@ namespace nre {
 		u16 unknown0;						//0x0A or 0x00
 		u16 unknown1;						//0x10 or 0x00 might be a size hint
 		u16 unknown2;						//0x10 or 0x00 might be a size hint
-		u8 isEncrypted;						//Only saw this affect encryption and linear image
+		u8 isLinear;						//Pixels are stored row by row instead of as 8x8 tiles (encrypted images always are)
 		u8 specialTiling;					//Seems to be set when images uses different tiling
 		u16 padding;						//0x0000
 		u32 tileDataSize;					//tileDataSize / 1024 = tileCount; tileDataSize * (2 - (tileDepth - 3)) = pixels
@@ -48,15 +48,19 @@ namespace nre {
 		u16 tileHeight;						//= RAHC tileCount
 	};
 
-	typedef GenericResource<RESOURCE_NCGR, false, RAHC, SOPC> NCGR;				//Graphics resource
+	typedef GenericResource<RESOURCE_NCGR, RAHC, SOPC> NCGR;					//Graphics resource
 
-	struct NRCS : GenericSection {												//Screen resource
+	//Tile of a screen:
+	//tile index (0-9), flip x (10), flip y (11), palette (12-15; only for 4 bit graphics)
+	using ScreenEntry = u16;
+
+	struct NRCS : GenericSection<SECTION_NRCS, ScreenEntry> {						//Screen resource
 		u16 screenWidth;					//Width of screen (pixels)
 		u16 screenHeight;					//Height of screen (pixels)
 		u32 c_padding;						//unknown
 		u32 screenDataSize;					//Size of screen data buffer
 	};
 
-	typedef GenericResource<0x4E534352, false, NRCS> NSCR;	
+	typedef GenericResource<RESOURCE_NCSR, NRCS> NSCR;
 
 }
\ No newline at end of file
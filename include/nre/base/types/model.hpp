@@ -0,0 +1,102 @@
+#pragma once
+#include "generic_resource.hpp"
+#include "helper/color.hpp"
+
+namespace nre {
+
+	//Lookup of named items in 3D resources; all offsets in it are relative to the dictionary
+	//Followed by the nodes of the tree, then the data at treeSize and count names of 16 characters
+	struct Dictionary {
+		u8 padding;							//0x00
+		u8 count;
+		u16 size;
+		u16 treeHeaderSize;					//0x0008
+		u16 treeSize;						//0x000C + count * 4; where the tree ends, so the offset of the DictionaryData
+		u32 constant;						//0x0000017F
+	};
+
+	//Follows the tree of a dictionary
+	struct DictionaryData {
+		u16 unitSize;						//Size of the data of every item
+		u16 size;							//Size of the data, including this header; the names follow it
+	};
+
+	//Formats of textures; same as the GPU uses
+	enum TextureFormat : u8 {
+		TEXTURE_NONE,
+		TEXTURE_A3I5,						//5 bit palette index, 3 bit alpha
+		TEXTURE_4_COLORS,
+		TEXTURE_16_COLORS,
+		TEXTURE_256_COLORS,
+		TEXTURE_4X4,						//4x4 blocks of 2 bit indices into 4 colors that are picked per block
+		TEXTURE_A5I3,						//3 bit palette index, 5 bit alpha
+		TEXTURE_DIRECT						//bgr5 with 1 bit alpha
+	};
+
+	//Texture parameters (TEXIMAGE_PARAM of the GPU); the data of every item in the texture dictionary:
+	//offset >> 3 (0-15), repeat s (16), repeat t (17), flip s (18), flip t (19),
+	//width = 8 << n (20-22), height = 8 << n (23-25), format (26-28), color 0 is transparent (29)
+	using TextureParams = u32;
+
+	//Texture data; every offset is relative to the section
+	struct TEX0 : GenericSection<SECTION_TEX0, u8> {
+		u32 padding0;
+		u16 textureDataSize;				//>> 3
+		u16 textureDictOffset;
+		u32 padding1;
+		u32 textureDataOffset;
+		u32 padding2;
+		u16 compressedDataSize;				//>> 3; texels of 4x4 textures
+		u16 compressedDictOffset;			//= textureDictOffset
+		u32 padding3;
+		u32 compressedDataOffset;
+		u32 compressedInfoOffset;			//Palette of every 4x4 block; half the size of the texels
+		u32 padding4;
+		u32 paletteDataSize;				//>> 3
+		u32 paletteDictOffset;				//The data of every item is the offset of the palette >> 3
+		u32 paletteDataOffset;
+	};
+
+	//Models; followed by a dictionary with the offset (u32, relative to the section) of every model
+	struct MDL0 : GenericSection<SECTION_MDL0, u8> {};
+
+	//Header of a model; the offsets are relative to the model
+	struct ModelHeader {
+
+		u32 size;
+		u32 commandsOffset;					//Render commands that walk the nodes
+		u32 materialsOffset;
+		u32 shapesOffset;					//Display lists with the geometry
+		u32 envelopesOffset;				//Inverse bind matrices
+
+		u8 commandType;
+		u8 scalingRule;
+		u8 textureMatrixMode;
+		u8 nodes;
+		u8 materials;
+		u8 shapes;
+		u8 firstUnusedMatrix;
+		u8 padding;
+
+		i32 positionScale;					//fx32 (1.19.12)
+		i32 inversePositionScale;
+
+		u16 vertices;
+		u16 polygons;
+		u16 triangles;
+		u16 quads;
+
+		i16 boxX, boxY, boxZ;				//fx16 (1.3.12), scaled by boxPositionScale
+		i16 boxW, boxH, boxD;
+
+		i32 boxPositionScale;
+		i32 boxInversePositionScale;
+	};
+
+	//Model resource; the TEX0 is optional, since models can use the textures of a BTX0
+	typedef GenericOffsetResource<RESOURCE_BMD0, MDL0, TEX0> BMD0;
+
+	//Texture resource
+	typedef GenericOffsetResource<RESOURCE_BTX0, TEX0> BTX0;
+
+}
@@ -96,8 +96,47 @@ namespace nre {
 		u32 beg;
 		u32 size;
 
-		u16 files, folders;
+		u32 files, folders;		//A folder can have all 65536 files
 		u16 parent; u8 nameLen; bool isFolder;
+
+		u16 id;			//Folder id or file id (index into the FAT)
+	};
+
+	//Entry of an overlay table, located at arm9OverlayOffset or arm7OverlayOffset
+	//Overlays are code that is loaded on demand; their files are in the FAT, but not in the FNT
+	struct OVTEntry {
+
+		u32 id;
+		u32 ramAddress;
+		u32 ramSize;
+		u32 bssSize;
+		u32 staticInitStart;	//RAM addresses of the table of static initializers
+		u32 staticInitEnd;
+		u32 fileId;
+		u32 flags;				//Compressed size (0-23), BLZ compressed (24), signed (25)
+
+		inline u32 getCompressedSize() const { return flags & 0xFFFFFF; }
+		inline bool isCompressed() const { return flags & (1 << 24); }
+	};
+
+	//Parameters the SDK puts in arm9.bin; the footer after arm9.bin in the ROM points to them
+	struct ModuleParams {
+
+		static constexpr u32 nitroCode = 0xDEC00621, nitroCodeSwapped = 0x2106C0DE;
+
+		u32 autoloadListStart;
+		u32 autoloadListEnd;
+		u32 autoloadStart;
+		u32 staticBssStart;
+		u32 staticBssEnd;
+		u32 compressedStaticEnd;	//RAM address where the BLZ compressed part of arm9.bin ends; 0 if it isn't compressed
+		u32 sdkVersion;
+		u32 nitroCodeBE;			//nitroCode
+		u32 nitroCodeLE;			//nitroCodeSwapped
+
+		//Offset of the params in arm9.bin, or usz_MAX if there are none
+		//The footer is the 12 bytes after arm9.bin in the ROM (nitroCode, offset of the params, 0); otherwise arm9.bin is searched
+		static usz find(const u8 *arm9, usz size, const u8 *footer = nullptr);
 	};
 
 	//A banner located at NDS::bannerOffset
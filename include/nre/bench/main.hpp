@@ -0,0 +1,36 @@
+#pragma once
+#include "helper/rom_generator.hpp"
+#include <iosfwd>
+
+//The stages run on a ROM from ROMGenerator, so no real dumps are needed
+
+struct BenchConfig {
+	nre::ROMShape shape;
+	usz minTime = 250;			//Milliseconds every stage runs for; stages always run at least once
+};
+
+//Measurement of a stage; every run processes ops items of bytes in total
+//Compression stages also have the ratio of output to input bytes, other stages leave it 0
+//Allocations are counted by replacing the global operator new, so they include those of the standard library
+
+struct BenchResult {
+
+	String name;
+
+	u64 runs, ops, bytes;
+	u64 ns;
+
+	u64 allocations, allocatedBytes;
+
+	f64 ratio;
+
+	inline f64 nsPerOp() const { return f64(ns) / f64(runs * ops); }
+	inline f64 mbPerSecond() const { return bytes ? f64(bytes * runs) * 1e3 / f64(ns) : 0; }
+	inline f64 allocationsPerOp() const { return f64(allocations) / f64(runs * ops); }
+	inline f64 allocatedBytesPerOp() const { return f64(allocatedBytes) / f64(runs * ops); }
+};
+
+//Output
+
+void printResults(const BenchConfig &config, const List<BenchResult> &results, std::ostream &out);
+void printJson(const BenchConfig &config, const List<BenchResult> &results, std::ostream &out);
@@ -1,5 +1,6 @@
 #pragma once
 #include "format/nds.hpp"
+#include <iosfwd>
 
 namespace oic { class FileSystem; }
 
@@ -22,12 +23,49 @@ struct EFlag {
 		exportCode			= exportArm9 | exportArm7,
 		exportFiles			= 1 << 10,
 		infoFiles			= 1 << 11,
-		infoFolders			= 1 << 12;
+		infoFolders			= 1 << 12,
+		importFiles			= 1 << 13,
+		exportGraphics		= 1 << 14,
+		exportFilesDecompressed	= 1 << 15,
+		walkArchives		= 1 << 16,
+		indexFiles			= 1 << 17,
+		diffFiles			= 1 << 18,
+		createPatch			= 1 << 19,
+		applyPatch			= 1 << 20,
+		verifyChecksums		= 1 << 21,
+		fixChecksums		= 1 << 22,
+		iconAtlas			= 1 << 23,
+		importGraphics		= 1 << 24,
+		exportTextures		= 1 << 25,
+		infoModels			= 1 << 26,
+		exportArm9Decompressed	= 1 << 27,
+		infoOverlays		= 1 << 28,
+		importArm9			= 1 << 29,
+		decryptGraphics		= 1 << 30;
+
+	//Flags that need the file system to be parsed; other flags only touch the header and banner
+	//-export-arm9-overlay and -export-arm7-overlay parse it themselves, since the table can be exported without it;
+	//-info-folders only reads the FNT, unless it has to go into archives
+
+	static constexpr u64
+		fileSystem			= exportFiles | infoFiles | importFiles | exportGraphics | exportFilesDecompressed | indexFiles |
+							  importGraphics | exportTextures | infoModels | exportArm9Decompressed | infoOverlays | importArm9;
+
+	//Flags that work on all ROMs at once, rather than on every ROM separately
+
+	static constexpr u64
+		collection			= diffFiles | iconAtlas;
+
+	//Flags that repack the ROM into ./rom_repacked.nds; only one of them can be used at a time, since they'd overwrite each other
+
+	static constexpr u64
+		repack				= importFiles | importGraphics | importArm9;
 
 };
 
 //A routine that is called if the flag is set
-using FlagRoutine = int (*)(const String&, nre::NDS*, oic::FileSystem*);
+//All output has to go to the stream, since ROMs can be processed in parallel
+using FlagRoutine = int (*)(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
 
 //The data of a cli flag
 struct Flag {
@@ -38,19 +76,38 @@ struct Flag {
 
 //All functions for flags
 
-int infoBasics(const String&, nre::NDS*, oic::FileSystem*);
-int infoLocations(const String&, nre::NDS*, oic::FileSystem*);
-int exportIcon(const String&, nre::NDS*, oic::FileSystem*);
-int exportIconPalette(const String&, nre::NDS*, oic::FileSystem*);
-int exportIconTilemap(const String&, nre::NDS*, oic::FileSystem*);
-int exportArm9Bin(const String&, nre::NDS*, oic::FileSystem*);
-int exportArm7Bin(const String&, nre::NDS*, oic::FileSystem*);
-int exportArm9Overlay(const String&, nre::NDS*, oic::FileSystem*);
-int exportArm7Overlay(const String&, nre::NDS*, oic::FileSystem*);
-int exportDebug(const String&, nre::NDS*, oic::FileSystem*);
-int exportFiles(const String&, nre::NDS*, oic::FileSystem*);
-int infoFiles(const String&, nre::NDS*, oic::FileSystem*);
-int infoFolders(const String&, nre::NDS*, oic::FileSystem*);
+int infoBasics(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int infoLocations(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int exportIcon(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int exportIconPalette(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int exportIconTilemap(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int exportArm9Bin(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int exportArm7Bin(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int exportArm9Overlay(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int exportArm7Overlay(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int exportArm9Decompressed(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int infoOverlays(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int importArm9(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int exportDebug(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int exportFiles(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int exportFilesDecompressed(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int infoFiles(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int infoFolders(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int importFiles(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int exportGraphics(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int importGraphics(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int exportTextures(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int infoModels(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int indexFiles(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int createPatch(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int applyPatch(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int verifyChecksums(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+int fixChecksums(const String&, nre::NDS*, oic::FileSystem*, std::ostream&);
+
+//Flags that work on all ROMs at once; these have a nullptr routine in flags
+
+int diffFiles(const List<String>&, usz jobs, std::ostream&);
+int iconAtlas(const List<String>&, usz jobs, std::ostream&);
 
 //All flags
 const std::initializer_list<Flag> flags {
@@ -114,17 +171,38 @@ const std::initializer_list<Flag> flags {
 	Flag{
 		EFlag::exportArm9Overlay,
 		"export-arm9-overlay",
-		"Exports the arm9 overlay from the rom (./rom.nds -> ./rom/arm9_overlay.bin)",
+		"Exports the arm9 overlay table and every arm9 overlay, decompressed (./rom.nds -> ./rom/arm9_overlay.bin, ./rom.overlay9/)",
 		exportArm9Overlay
 	},
 
 	Flag{
 		EFlag::exportArm7Overlay,
 		"export-arm7-overlay",
-		"Exports the arm7 overlay from the rom (./rom.nds -> ./rom/arm7_overlay.bin)",
+		"Exports the arm7 overlay table and every arm7 overlay, decompressed (./rom.nds -> ./rom/arm7_overlay.bin, ./rom.overlay7/)",
 		exportArm7Overlay
 	},
 
+	Flag{
+		EFlag::exportArm9Decompressed,
+		"export-arm9-decompressed",
+		"Exports the arm9 binary with its BLZ compression undone (./rom.nds -> ./rom/arm9_decompressed.bin)",
+		exportArm9Decompressed
+	},
+
+	Flag{
+		EFlag::infoOverlays,
+		"info-overlays",
+		"Prints the overlay tables; id, file, RAM address and size, BSS size, static initializers and compression",
+		infoOverlays
+	},
+
+	Flag{
+		EFlag::importArm9,
+		"import-arm9",
+		"Compresses ./rom/arm9_decompressed.bin and the changed overlays in ./rom.overlay9 and ./rom.overlay7 again and splices them into the rom; without it, arm9.bin is imported as is (-> ./rom_repacked.nds)",
+		importArm9
+	},
+
 	Flag{
 		EFlag::exportDebug,
 		"export-debug",
@@ -160,6 +238,13 @@ const std::initializer_list<Flag> flags {
 		exportFiles
 	},
 
+	Flag{
+		EFlag::exportFilesDecompressed,
+		"export-files-decompressed",
+		"Same as -export-files, but files compressed with LZ10, LZ11, Huffman or RLE are decompressed",
+		exportFilesDecompressed
+	},
+
 	Flag{
 		EFlag::infoFiles,
 		"info-files",
@@ -172,6 +257,104 @@ const std::initializer_list<Flag> flags {
 		"info-folders",
 		"Shows a list of all folders from the rom",
 		infoFolders
+	},
+
+	Flag{
+		EFlag::importFiles,
+		"import-files",
+		"Repacks the rom with the changed files from inputRomPath/romName and new files in its folders; files can grow (./rom.nds -> ./rom_repacked.nds)",
+		importFiles
+	},
+
+	Flag{
+		EFlag::exportGraphics,
+		"export-graphics",
+		"Exports every NCGR in the rom as a png, with the NCLR and NSCR next to it (./rom.nds -> ./rom.graphics)",
+		exportGraphics
+	},
+
+	Flag{
+		EFlag::importGraphics,
+		"import-graphics",
+		"Quantizes and retiles the changed pngs of -export-graphics back into the rom (./rom.graphics -> ./rom_repacked.nds)",
+		importGraphics
+	},
+
+	Flag{
+		EFlag::exportTextures,
+		"export-textures",
+		"Exports every texture of the BMD0 and BTX0 files as a png (./rom.nds -> ./rom.textures/file/texture.png); uses -walk-narc",
+		exportTextures
+	},
+
+	Flag{
+		EFlag::infoModels,
+		"info-models",
+		"Prints the vertex, polygon and material counts of every model and the texture sizes of every BMD0 and BTX0; uses -walk-narc",
+		infoModels
+	},
+
+	Flag{
+		EFlag::walkArchives,
+		"walk-narc",
+		"Makes -info-files, -info-folders and -export-files also go into NARC archives (./rom/a.narc -> ./rom/a.narc.d/)",
+		nullptr
+	},
+
+	Flag{
+		EFlag::decryptGraphics,
+		"decrypt-graphics",
+		"Makes -export-graphics decrypt the NCGRs first, for titles that encrypt them (Pokemon Platinum/HGSS); -import-graphics skips them then",
+		nullptr
+	},
+
+	Flag{
+		EFlag::indexFiles,
+		"index-files",
+		"Hashes all files and saves the paths, locations and hashes (./rom.nds -> ./rom.index); uses -walk-narc",
+		indexFiles
+	},
+
+	Flag{
+		EFlag::diffFiles,
+		"diff",
+		"Lists the files that are shared, changed or unique between the roms; indices that are up to date are reused",
+		nullptr
+	},
+
+	Flag{
+		EFlag::createPatch,
+		"create-patch",
+		"Creates a patch from the rom to its repacked version (./rom.nds, ./rom_repacked.nds -> ./rom.patch)",
+		createPatch
+	},
+
+	Flag{
+		EFlag::applyPatch,
+		"apply-patch",
+		"Applies a patch to the rom (./rom.nds, ./rom.patch -> ./rom_patched.nds)",
+		applyPatch
+	},
+
+	Flag{
+		EFlag::verifyChecksums,
+		"verify-checksums",
+		"Checks the header, logo, secure area and banner checksums; only reads those parts of the rom",
+		verifyChecksums
+	},
+
+	Flag{
+		EFlag::fixChecksums,
+		"fix-checksums",
+		"Recomputes the checksums that are wrong and writes them into the rom itself",
+		fixChecksums
+	},
+
+	Flag{
+		EFlag::iconAtlas,
+		"icon-atlas",
+		"Packs the icons of all roms into atlases with an index by game code (./icon_atlas/atlas_0.png, ./icon_atlas/index.json); uses -jobs",
+		nullptr
 	}
 
 };
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "types/nds.hpp"
+#include <cstring>
+#include <cstddef>
 using namespace nre;
 using namespace oic;
 
@@ -22,8 +24,40 @@ NDS *NDS::get(u8 *romPtr, usz romSize) {
 
 	NDS* const nds = (NDS*) romPtr;
 
-	if(nds->invalid())
+	//The header is checked against its own ROM size, so that has to fit in the data we've got;
+	//otherwise reading a mapped ROM could go past the end of the mapping
+
+	if(nds->invalid() || nds->romSize > romSize)
 		return nullptr;
 
 	return nds;
+}
+
+usz ModuleParams::find(const u8 *arm9, usz size, const u8 *footer) {
+
+	auto isParams = [arm9, size](usz offset) {
+
+		if (offset > size || size - offset < sizeof(ModuleParams))
+			return false;
+
+		u32 codes[2];
+		std::memcpy(codes, arm9 + offset + offsetof(ModuleParams, nitroCodeBE), sizeof(codes));
+		return codes[0] == nitroCode && codes[1] == nitroCodeSwapped;
+	};
+
+	if (footer) {
+
+		u32 code, offset;
+		std::memcpy(&code, footer, sizeof(code));
+		std::memcpy(&offset, footer + 4, sizeof(offset));
+
+		if (code == nitroCode && isParams(offset))
+			return offset;
+	}
+
+	for (usz i = 0; i + sizeof(ModuleParams) <= size; i += 4)
+		if (isParams(i))
+			return i;
+
+	return usz_MAX;
 }
\ No newline at end of file
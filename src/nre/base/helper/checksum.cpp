@@ -0,0 +1,185 @@
+#include "helper/checksum.hpp"
+#include "types/nds.hpp"
+#include <cstring>
+#include <cstddef>
+
+namespace nre {
+
+	//Slicing-by-8 tables; table[0] is the regular byte table and table[i] advances i more bytes of zeros
+
+	struct CRC16Table {
+
+		u16 table[8][256];
+
+		constexpr CRC16Table(): table{} {
+
+			for (u32 i = 0; i < 256; ++i) {
+
+				u32 crc = i;
+
+				for (u32 j = 0; j < 8; ++j)
+					crc = crc & 1 ? (crc >> 1) ^ 0xA001 : crc >> 1;
+
+				table[0][i] = u16(crc);
+			}
+
+			for (u32 i = 0; i < 256; ++i)
+				for (u32 j = 1; j < 8; ++j)
+					table[j][i] = u16((table[j - 1][i] >> 8) ^ table[0][table[j - 1][i] & 0xFF]);
+		}
+	};
+
+	static constexpr CRC16Table crcTable{};
+
+	u16 ChecksumHelper::crc16(const void *data, usz size, u16 crc) {
+
+		const u8 *ptr = (const u8*) data;
+		const auto &t = crcTable.table;
+
+		//The CRC is XORed into the first 2 bytes, then every byte is looked up by how far it is from the end
+
+		for (; size >= 8; size -= 8, ptr += 8) {
+
+			u64 v;
+			std::memcpy(&v, ptr, 8);
+			v ^= crc;
+
+			crc = u16(
+				t[7][v & 0xFF] ^ t[6][(v >> 8) & 0xFF] ^ t[5][(v >> 16) & 0xFF] ^ t[4][(v >> 24) & 0xFF] ^
+				t[3][(v >> 32) & 0xFF] ^ t[2][(v >> 40) & 0xFF] ^ t[1][(v >> 48) & 0xFF] ^ t[0][v >> 56]
+			);
+		}
+
+		for (; size; --size, ++ptr)
+			crc = u16((crc >> 8) ^ t[0][(crc ^ *ptr) & 0xFF]);
+
+		return crc;
+	}
+
+	bool ChecksumHelper::getChecksum(const u8 *rom, usz size, ChecksumType type, Checksum &checksum) {
+
+		if (size < sizeof(NDS))
+			return false;
+
+		const NDS *nds = (const NDS*) rom;
+
+		u32 offset, beg, end;
+
+		switch (type) {
+
+			case CHECKSUM_HEADER:
+				offset = u32(offsetof(NDS, nHC));
+				beg = 0;
+				end = offset;
+				break;
+
+			case CHECKSUM_LOGO:
+				offset = u32(offsetof(NDS, nLC));
+				beg = u32(offsetof(NDS, nLogo));
+				end = beg + sizeof(nds->nLogo);
+				break;
+
+			case CHECKSUM_SECURE_AREA: {
+
+				//Dumps usually have a decrypted secure area, which starts with "encryObj" or 0xE7FFDEFF;
+				//the checksum is of the encrypted data, so it can't be verified then
+
+				if (nds->arm9Offset >= 0x8000 || nds->arm9Offset + nds->arm9Size <= 0x4000 || size < 0x8000)
+					return false;
+
+				u64 id;
+				std::memcpy(&id, rom + 0x4000, 8);
+
+				if (!std::memcmp(rom + 0x4000, "encryObj", 8) || id == 0xE7FFDEFFE7FFDEFF)
+					return false;
+
+				offset = u32(offsetof(NDS, sAC));
+				beg = 0x4000;
+				end = 0x8000;
+				break;
+			}
+
+			default: {
+
+				if (!nds->bannerOffset || usz(nds->bannerOffset) + 0x840 > size)
+					return false;
+
+				//The banner version decides which of the checksums it has
+
+				const u16 version = *(const u16*)(rom + nds->bannerOffset);
+
+				static constexpr u32 ranges[4][3] = {
+					{ 0x02, 0x0020, 0x0840 },
+					{ 0x04, 0x0020, 0x0940 },
+					{ 0x06, 0x0020, 0x0A40 },
+					{ 0x08, 0x1240, 0x23C0 }
+				};
+
+				const usz i = usz(type - CHECKSUM_BANNER);
+
+				if (
+					(type == CHECKSUM_BANNER_CHINESE && version < 2) ||
+					(type == CHECKSUM_BANNER_KOREAN && version < 3) ||
+					(type == CHECKSUM_BANNER_ANIMATED && version != 0x103)
+				)
+					return false;
+
+				offset = nds->bannerOffset + ranges[i][0];
+				beg = nds->bannerOffset + ranges[i][1];
+				end = nds->bannerOffset + ranges[i][2];
+
+				if (end > size)
+					return false;
+			}
+		}
+
+		checksum = Checksum{ type, offset, *(const u16*)(rom + offset), crc16(rom + beg, end - beg) };
+		return true;
+	}
+
+	List<Checksum> ChecksumHelper::getChecksums(const u8 *rom, usz size) {
+
+		List<Checksum> checksums;
+		checksums.reserve(CHECKSUM_COUNT);
+
+		Checksum checksum;
+
+		for (u8 i = 0; i < CHECKSUM_COUNT; ++i)
+			if (getChecksum(rom, size, ChecksumType(i), checksum))
+				checksums.push_back(checksum);
+
+		return checksums;
+	}
+
+	List<Checksum> ChecksumHelper::fixChecksums(u8 *rom, usz size) {
+
+		List<Checksum> fixed;
+		Checksum checksum;
+
+		//In order, since the header checksum has to include the fixed secure area and logo checksums
+
+		for (u8 i = 0; i < CHECKSUM_COUNT; ++i)
+			if (getChecksum(rom, size, ChecksumType(i), checksum) && !checksum.isValid()) {
+				std::memcpy(rom + checksum.offset, &checksum.computed, sizeof(u16));
+				fixed.push_back(checksum);
+			}
+
+		return fixed;
+	}
+
+	const c8 *ChecksumHelper::getName(ChecksumType type) {
+
+		static constexpr const c8 *names[] = {
+			"secure area",
+			"logo",
+			"banner",
+			"banner (chinese)",
+			"banner (korean)",
+			"banner (animated icon)",
+			"header"
+		};
+
+		return type < CHECKSUM_COUNT ? names[type] : "unknown";
+	}
+
+}
@@ -0,0 +1,896 @@
+#include "helper/color.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+	#define NRE_X64
+	#include <immintrin.h>
+
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define NRE_TARGET(x)
+	#else
+		#define NRE_TARGET(x) __attribute__((target(x)))
+	#endif
+
+#elif defined(__aarch64__) || defined(_M_ARM64)
+
+	#define NRE_NEON
+	#include <arm_neon.h>
+
+#endif
+
+namespace nre {
+
+	//Helpers shared by all kernels
+
+	//Palette as RGBA8; same as calling BGR5::toRGBA8 per pixel, so the output is identical
+	inline void toRGBA8Palette(const bgr5 *palette, rgba8 *out, usz count) {
+		for (usz i = 0; i < count; ++i)
+			BGR5::toRGBA8(palette[i], out + i);
+	}
+
+	//Pointer to the top left of a tile in the linear image
+	template<typename T>
+	inline T *tileOrigin(T *out, usz tile, usz w) {
+		const usz tilesX = w >> 3;
+		return out + (tile / tilesX) * (w << 3) + ((tile % tilesX) << 3);
+	}
+
+	//Scalar kernels (reference)
+
+	template<bool is4Bit>
+	inline void decodeTile(const u8 *tile, u8 *idx) {
+
+		if constexpr (is4Bit)
+			for (usz i = 0; i < 32; ++i) {
+				idx[i << 1] = tile[i] & 0xF;
+				idx[(i << 1) | 1] = tile[i] >> 4;
+			}
+
+		else std::memcpy(idx, tile, 64);
+	}
+
+	template<bool is4Bit>
+	void tilesToR8Scalar(const u8 *tiles, r8 *out, u16 w, u16 h) {
+
+		constexpr usz tileSize = is4Bit ? 32 : 64;
+		const usz count = usz(w >> 3) * (h >> 3);
+
+		u8 idx[64];
+
+		for (usz j = 0; j < count; ++j) {
+
+			decodeTile<is4Bit>(tiles + j * tileSize, idx);
+			r8 *dst = tileOrigin(out, j, w);
+
+			for (usz y = 0; y < 8; ++y)
+				std::memcpy(dst + y * w, idx + (y << 3), 8);
+		}
+	}
+
+	template<bool is4Bit>
+	void tilesToBGR5Scalar(const u8 *tiles, bgr5 *out, u16 w, u16 h, const bgr5 *palette) {
+
+		constexpr usz tileSize = is4Bit ? 32 : 64;
+		const usz count = usz(w >> 3) * (h >> 3);
+
+		u8 idx[64];
+
+		for (usz j = 0; j < count; ++j) {
+
+			decodeTile<is4Bit>(tiles + j * tileSize, idx);
+			bgr5 *dst = tileOrigin(out, j, w);
+
+			for (usz y = 0; y < 8; ++y)
+				for (usz x = 0; x < 8; ++x)
+					dst[y * w + x] = palette[idx[(y << 3) | x]];
+		}
+	}
+
+	template<bool is4Bit>
+	void tilesToRGBA8Scalar(const u8 *tiles, rgba8 *out, u16 w, u16 h, const bgr5 *palette) {
+
+		constexpr usz tileSize = is4Bit ? 32 : 64;
+		const usz count = usz(w >> 3) * (h >> 3);
+
+		rgba8 lut[is4Bit ? 16 : 256];
+		toRGBA8Palette(palette, lut, is4Bit ? 16 : 256);
+
+		u8 idx[64];
+
+		for (usz j = 0; j < count; ++j) {
+
+			decodeTile<is4Bit>(tiles + j * tileSize, idx);
+			rgba8 *dst = tileOrigin(out, j, w);
+
+			for (usz y = 0; y < 8; ++y)
+				for (usz x = 0; x < 8; ++x)
+					if (const u8 pid = idx[(y << 3) | x])
+						dst[y * w + x] = lut[pid];
+		}
+	}
+
+	void bgr5ToRGBA8Scalar(const bgr5 *in, rgba8 *out, usz len) {
+		for (usz i = 0; i < len; ++i)
+			BGR5::toRGBA8(in[i], out + i);
+	}
+
+	void rgba8ToBGR5Scalar(const rgba8 *in, bgr5 *out, usz len) {
+		for (usz i = 0; i < len; ++i)
+			out[i] = BGR5::fromRGBA8(in + i);
+	}
+
+	void nearestColorsScalar(const bgr5 *in, u8 *out, usz len, const bgr5 *palette, usz colors) {
+
+		for (usz i = 0; i < len; ++i) {
+
+			u32 best = u32_MAX;
+			usz pick = 0;
+
+			for (usz j = 0; j < colors; ++j)
+				if (const u32 d = BGR5::distance(in[i], palette[j]); d < best) {
+					best = d;
+					pick = j;
+				}
+
+			out[i] = u8(pick);
+		}
+	}
+
+	//Palette split into its 5 bit components, padded to a multiple of 8 colors for the SIMD kernels
+	//The padding gets a bias that is bigger than any real distance (3 * 31^2), so it can never be picked
+
+	struct PaletteComponents {
+
+		alignas(16) i16 r[256], g[256], b[256], bias[256];
+		usz groups;
+
+		PaletteComponents(const bgr5 *palette, usz colors): groups((colors + 7) >> 3) {
+			for (usz i = 0; i < groups << 3; ++i) {
+				const bgr5 c = i < colors ? palette[i] : 0;
+				r[i] = i16(c & 0x1F);
+				g[i] = i16((c >> 5) & 0x1F);
+				b[i] = i16((c >> 10) & 0x1F);
+				bias[i] = i < colors ? 0 : 0x4000;
+			}
+		}
+	};
+
+	//Lowest distance of the 8 lanes; ties go to the lowest index, just like the scalar kernel
+	inline u8 pickNearest(const i16 dist[8], const i16 idx[8]) {
+
+		usz pick = 0;
+
+		for (usz k = 1; k < 8; ++k)
+			if (dist[k] < dist[pick] || (dist[k] == dist[pick] && idx[k] < idx[pick]))
+				pick = k;
+
+		return u8(idx[pick]);
+	}
+
+	//The SIMD kernels replace the divisions of BGR5::to8Bit and from8Bit with a multiply and shift.
+	//These give the exact same result for every input (x * 255 / 31 for 0-31 and (x * 31 + 127) / 255 for 0-255).
+
+	static constexpr u16 to8BitMul = 1053, to8BitShift = 7;
+	static constexpr u16 from8BitMul = 249, from8BitAdd = 1014, from8BitShift = 11;
+
+	//Lookup table
+
+	void ColorKernels::bgr5ToRGBA8Table(const bgr5 *in, rgba8 *out, usz len) {
+
+		static const List<rgba8> table = [] {
+
+			List<rgba8> res(0x8000);
+
+			for (usz i = 0; i < res.size(); ++i)
+				BGR5::toRGBA8(bgr5(i), res.data() + i);
+
+			return res;
+		}();
+
+		const rgba8 *lut = table.data();
+
+		for (usz i = 0; i < len; ++i)
+			out[i] = lut[in[i] & 0x7FFF];
+	}
+
+	#ifdef NRE_X64
+
+		//SSE2; part of x64, so this doesn't need a check
+		//The nibbles are split and interleaved for a whole tile at once; 16 indices = 2 rows
+
+		inline void decodeTileSSE2(const u8 *tile, __m128i idx[4]) {
+
+			const __m128i mask = _mm_set1_epi8(0xF);
+
+			for (usz i = 0; i < 2; ++i) {
+
+				const __m128i v = _mm_loadu_si128((const __m128i*)(tile + (i << 4)));
+				const __m128i lo = _mm_and_si128(v, mask);
+				const __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+
+				idx[i << 1] = _mm_unpacklo_epi8(lo, hi);
+				idx[(i << 1) | 1] = _mm_unpackhi_epi8(lo, hi);
+			}
+		}
+
+		inline void storeRowsSSE2(u8 *dst, usz w, __m128i rows) {
+			_mm_storel_epi64((__m128i*) dst, rows);
+			_mm_storel_epi64((__m128i*)(dst + w), _mm_srli_si128(rows, 8));
+		}
+
+		void tilesToR8SSE2_4(const u8 *tiles, r8 *out, u16 w, u16 h) {
+
+			const usz count = usz(w >> 3) * (h >> 3);
+			__m128i idx[4];
+
+			for (usz j = 0; j < count; ++j) {
+
+				decodeTileSSE2(tiles + (j << 5), idx);
+				r8 *dst = tileOrigin(out, j, w);
+
+				for (usz i = 0; i < 4; ++i)
+					storeRowsSSE2(dst + i * 2 * w, w, idx[i]);
+			}
+		}
+
+		void tilesToR8SSE2_8(const u8 *tiles, r8 *out, u16 w, u16 h) {
+
+			const usz count = usz(w >> 3) * (h >> 3);
+
+			for (usz j = 0; j < count; ++j) {
+
+				const u8 *tile = tiles + (j << 6);
+				r8 *dst = tileOrigin(out, j, w);
+
+				for (usz i = 0; i < 4; ++i)
+					storeRowsSSE2(dst + i * 2 * w, w, _mm_loadu_si128((const __m128i*)(tile + (i << 4))));
+			}
+		}
+
+		//Without pshufb, the palette lookup stays scalar, but the tiles are split with SSE2
+
+		void tilesToRGBA8SSE2_4(const u8 *tiles, rgba8 *out, u16 w, u16 h, const bgr5 *palette) {
+
+			const usz count = usz(w >> 3) * (h >> 3);
+
+			rgba8 lut[16];
+			toRGBA8Palette(palette, lut, 16);
+
+			alignas(16) u8 idx[64];
+			__m128i v[4];
+
+			for (usz j = 0; j < count; ++j) {
+
+				decodeTileSSE2(tiles + (j << 5), v);
+
+				for (usz i = 0; i < 4; ++i)
+					_mm_store_si128((__m128i*)(idx + (i << 4)), v[i]);
+
+				rgba8 *dst = tileOrigin(out, j, w);
+
+				for (usz y = 0; y < 8; ++y)
+					for (usz x = 0; x < 8; ++x)
+						if (const u8 pid = idx[(y << 3) | x])
+							dst[y * w + x] = lut[pid];
+			}
+		}
+
+		void tilesToBGR5SSE2_4(const u8 *tiles, bgr5 *out, u16 w, u16 h, const bgr5 *palette) {
+
+			const usz count = usz(w >> 3) * (h >> 3);
+
+			alignas(16) u8 idx[64];
+			__m128i v[4];
+
+			for (usz j = 0; j < count; ++j) {
+
+				decodeTileSSE2(tiles + (j << 5), v);
+
+				for (usz i = 0; i < 4; ++i)
+					_mm_store_si128((__m128i*)(idx + (i << 4)), v[i]);
+
+				bgr5 *dst = tileOrigin(out, j, w);
+
+				for (usz y = 0; y < 8; ++y)
+					for (usz x = 0; x < 8; ++x)
+						dst[y * w + x] = palette[idx[(y << 3) | x]];
+			}
+		}
+
+		//8 bgr5 to 8 rgba8; the 5 bit channels are expanded with a multiply and shift per u16 lane
+
+		inline void bgr5ToRGBA8SSE2(const bgr5 *in, rgba8 *out) {
+
+			const __m128i v = _mm_loadu_si128((const __m128i*) in);
+			const __m128i mask = _mm_set1_epi16(0x1F), mul = _mm_set1_epi16(to8BitMul);
+
+			const __m128i r = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(v, mask), mul), to8BitShift);
+			const __m128i g = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(v, 5), mask), mul), to8BitShift);
+			const __m128i b = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(v, 10), mask), mul), to8BitShift);
+
+			const __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+			const __m128i ba = _mm_or_si128(b, _mm_set1_epi16(i16(0xFF00)));
+
+			_mm_storeu_si128((__m128i*) out, _mm_unpacklo_epi16(rg, ba));
+			_mm_storeu_si128((__m128i*)(out + 4), _mm_unpackhi_epi16(rg, ba));
+		}
+
+		void bgr5ToRGBA8SSE2(const bgr5 *in, rgba8 *out, usz len) {
+
+			usz i = 0;
+
+			for (; i + 8 <= len; i += 8)
+				bgr5ToRGBA8SSE2(in + i, out + i);
+
+			bgr5ToRGBA8Scalar(in + i, out + i, len - i);
+		}
+
+		//4 rgba8 to 4 bgr5 in u32 lanes; the upper u16 of the multiplier is 0, so mullo_epi16 stays in the lane
+
+		inline __m128i rgba8ToBGR5SSE2(const rgba8 *in) {
+
+			const __m128i v = _mm_loadu_si128((const __m128i*) in);
+			const __m128i mask = _mm_set1_epi32(0xFF), mul = _mm_set1_epi32(from8BitMul), add = _mm_set1_epi32(from8BitAdd);
+
+			const __m128i r = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi16(_mm_and_si128(v, mask), mul), add), from8BitShift);
+			const __m128i g = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi32(v, 8), mask), mul), add), from8BitShift);
+			const __m128i b = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi32(v, 16), mask), mul), add), from8BitShift);
+
+			return _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 5)), _mm_slli_epi32(b, 10));
+		}
+
+		void rgba8ToBGR5SSE2(const rgba8 *in, bgr5 *out, usz len) {
+
+			usz i = 0;
+
+			for (; i + 8 <= len; i += 8)
+				_mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(rgba8ToBGR5SSE2(in + i), rgba8ToBGR5SSE2(in + i + 4)));
+
+			rgba8ToBGR5Scalar(in + i, out + i, len - i);
+		}
+
+		//8 palette colors per step; every lane keeps its own best, which is only replaced by a strictly lower distance.
+		//Distances are at most 3 * 31^2, so they fit in i16 lanes.
+
+		void nearestColorsSSE2(const bgr5 *in, u8 *out, usz len, const bgr5 *palette, usz colors) {
+
+			const PaletteComponents p(palette, colors);
+			const __m128i step = _mm_set1_epi16(8), first = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+
+			alignas(16) i16 dist[8], idx[8];
+
+			for (usz i = 0; i < len; ++i) {
+
+				const __m128i r = _mm_set1_epi16(i16(in[i] & 0x1F));
+				const __m128i g = _mm_set1_epi16(i16((in[i] >> 5) & 0x1F));
+				const __m128i b = _mm_set1_epi16(i16((in[i] >> 10) & 0x1F));
+
+				__m128i best = _mm_set1_epi16(0x7FFF), bestIdx = _mm_setzero_si128(), cur = first;
+
+				for (usz j = 0; j < p.groups; ++j) {
+
+					const __m128i dr = _mm_sub_epi16(r, _mm_load_si128((const __m128i*)(p.r + (j << 3))));
+					const __m128i dg = _mm_sub_epi16(g, _mm_load_si128((const __m128i*)(p.g + (j << 3))));
+					const __m128i db = _mm_sub_epi16(b, _mm_load_si128((const __m128i*)(p.b + (j << 3))));
+
+					const __m128i d = _mm_add_epi16(
+						_mm_add_epi16(_mm_mullo_epi16(dr, dr), _mm_mullo_epi16(dg, dg)),
+						_mm_add_epi16(_mm_mullo_epi16(db, db), _mm_load_si128((const __m128i*)(p.bias + (j << 3))))
+					);
+
+					const __m128i less = _mm_cmplt_epi16(d, best);
+
+					best = _mm_min_epi16(d, best);
+					bestIdx = _mm_or_si128(_mm_and_si128(less, cur), _mm_andnot_si128(less, bestIdx));
+					cur = _mm_add_epi16(cur, step);
+				}
+
+				_mm_store_si128((__m128i*) dist, best);
+				_mm_store_si128((__m128i*) idx, bestIdx);
+				out[i] = pickNearest(dist, idx);
+			}
+		}
+
+		//SSSE3; 16 color palettes fit in a register per channel, so pshufb is the palette lookup
+
+		NRE_TARGET("ssse3")
+		void tilesToRGBA8SSSE3_4(const u8 *tiles, rgba8 *out, u16 w, u16 h, const bgr5 *palette) {
+
+			const usz count = usz(w >> 3) * (h >> 3);
+
+			alignas(16) rgba8 lut[16];
+			toRGBA8Palette(palette, lut, 16);
+
+			alignas(16) u8 planes[4][16];
+
+			for (usz i = 0; i < 16; ++i)
+				for (usz k = 0; k < 4; ++k)
+					planes[k][i] = lut[i].data[k];
+
+			const __m128i r = _mm_load_si128((const __m128i*) planes[0]);
+			const __m128i g = _mm_load_si128((const __m128i*) planes[1]);
+			const __m128i b = _mm_load_si128((const __m128i*) planes[2]);
+			const __m128i a = _mm_load_si128((const __m128i*) planes[3]);
+			const __m128i zero = _mm_setzero_si128();
+
+			__m128i idx[4];
+
+			for (usz j = 0; j < count; ++j) {
+
+				decodeTileSSE2(tiles + (j << 5), idx);
+				rgba8 *dst = tileOrigin(out, j, w);
+
+				for (usz i = 0; i < 4; ++i) {
+
+					const __m128i ri = _mm_shuffle_epi8(r, idx[i]);
+					const __m128i gi = _mm_shuffle_epi8(g, idx[i]);
+					const __m128i bi = _mm_shuffle_epi8(b, idx[i]);
+					const __m128i ai = _mm_shuffle_epi8(a, idx[i]);
+
+					const __m128i rg0 = _mm_unpacklo_epi8(ri, gi), rg1 = _mm_unpackhi_epi8(ri, gi);
+					const __m128i ba0 = _mm_unpacklo_epi8(bi, ai), ba1 = _mm_unpackhi_epi8(bi, ai);
+
+					const __m128i px[4] = {
+						_mm_unpacklo_epi16(rg0, ba0), _mm_unpackhi_epi16(rg0, ba0),
+						_mm_unpacklo_epi16(rg1, ba1), _mm_unpackhi_epi16(rg1, ba1)
+					};
+
+					//Index 0 is transparent and keeps whatever was in the image
+
+					const __m128i z = _mm_cmpeq_epi8(idx[i], zero);
+					const __m128i z0 = _mm_unpacklo_epi8(z, z), z1 = _mm_unpackhi_epi8(z, z);
+
+					const __m128i mask[4] = {
+						_mm_unpacklo_epi16(z0, z0), _mm_unpackhi_epi16(z0, z0),
+						_mm_unpacklo_epi16(z1, z1), _mm_unpackhi_epi16(z1, z1)
+					};
+
+					for (usz k = 0; k < 4; ++k) {
+
+						__m128i *row = (__m128i*)(dst + (i * 2 + (k >> 1)) * w + ((k & 1) << 2));
+						const __m128i old = _mm_loadu_si128(row);
+
+						_mm_storeu_si128(row, _mm_or_si128(_mm_and_si128(mask[k], old), _mm_andnot_si128(mask[k], px[k])));
+					}
+				}
+			}
+		}
+
+		NRE_TARGET("ssse3")
+		void tilesToBGR5SSSE3_4(const u8 *tiles, bgr5 *out, u16 w, u16 h, const bgr5 *palette) {
+
+			const usz count = usz(w >> 3) * (h >> 3);
+
+			alignas(16) u8 planes[2][16];
+
+			for (usz i = 0; i < 16; ++i) {
+				planes[0][i] = u8(palette[i]);
+				planes[1][i] = u8(palette[i] >> 8);
+			}
+
+			const __m128i lo = _mm_load_si128((const __m128i*) planes[0]);
+			const __m128i hi = _mm_load_si128((const __m128i*) planes[1]);
+
+			__m128i idx[4];
+
+			for (usz j = 0; j < count; ++j) {
+
+				decodeTileSSE2(tiles + (j << 5), idx);
+				bgr5 *dst = tileOrigin(out, j, w);
+
+				for (usz i = 0; i < 4; ++i) {
+
+					const __m128i l = _mm_shuffle_epi8(lo, idx[i]);
+					const __m128i h = _mm_shuffle_epi8(hi, idx[i]);
+
+					_mm_storeu_si128((__m128i*)(dst + i * 2 * w), _mm_unpacklo_epi8(l, h));
+					_mm_storeu_si128((__m128i*)(dst + (i * 2 + 1) * w), _mm_unpackhi_epi8(l, h));
+				}
+			}
+		}
+
+		//AVX2; a row of 8 pixels is one gather from the RGBA8 palette, which also works for 256 colors
+
+		NRE_TARGET("avx2")
+		inline void storeRowAVX2(rgba8 *dst, const rgba8 *lut, __m128i row) {
+
+			const __m256i idx = _mm256_cvtepu8_epi32(row);
+			const __m256i px = _mm256_i32gather_epi32((const int*) lut, idx, 4);
+			const __m256i mask = _mm256_cmpeq_epi32(idx, _mm256_setzero_si256());
+			const __m256i old = _mm256_loadu_si256((const __m256i*) dst);
+
+			_mm256_storeu_si256((__m256i*) dst, _mm256_blendv_epi8(px, old, mask));
+		}
+
+		NRE_TARGET("avx2")
+		void tilesToRGBA8AVX2_4(const u8 *tiles, rgba8 *out, u16 w, u16 h, const bgr5 *palette) {
+
+			const usz count = usz(w >> 3) * (h >> 3);
+
+			rgba8 lut[16];
+			toRGBA8Palette(palette, lut, 16);
+
+			__m128i idx[4];
+
+			for (usz j = 0; j < count; ++j) {
+
+				decodeTileSSE2(tiles + (j << 5), idx);
+				rgba8 *dst = tileOrigin(out, j, w);
+
+				for (usz i = 0; i < 4; ++i) {
+					storeRowAVX2(dst + i * 2 * w, lut, idx[i]);
+					storeRowAVX2(dst + (i * 2 + 1) * w, lut, _mm_srli_si128(idx[i], 8));
+				}
+			}
+		}
+
+		NRE_TARGET("avx2")
+		void tilesToRGBA8AVX2_8(const u8 *tiles, rgba8 *out, u16 w, u16 h, const bgr5 *palette) {
+
+			const usz count = usz(w >> 3) * (h >> 3);
+
+			rgba8 lut[256];
+			toRGBA8Palette(palette, lut, 256);
+
+			for (usz j = 0; j < count; ++j) {
+
+				const u8 *tile = tiles + (j << 6);
+				rgba8 *dst = tileOrigin(out, j, w);
+
+				for (usz y = 0; y < 8; ++y)
+					storeRowAVX2(dst + y * w, lut, _mm_loadl_epi64((const __m128i*)(tile + (y << 3))));
+			}
+		}
+
+		//16 bgr5 to 16 rgba8; unpack works per 128 bit lane, so the halves are swapped back in order
+
+		NRE_TARGET("avx2")
+		void bgr5ToRGBA8AVX2(const bgr5 *in, rgba8 *out, usz len) {
+
+			const __m256i mask = _mm256_set1_epi16(0x1F), mul = _mm256_set1_epi16(to8BitMul);
+			const __m256i alpha = _mm256_set1_epi16(i16(0xFF00));
+
+			usz i = 0;
+
+			for (; i + 16 <= len; i += 16) {
+
+				const __m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+
+				const __m256i r = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(v, mask), mul), to8BitShift);
+				const __m256i g = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi16(v, 5), mask), mul), to8BitShift);
+				const __m256i b = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi16(v, 10), mask), mul), to8BitShift);
+
+				const __m256i rg = _mm256_or_si256(r, _mm256_slli_epi16(g, 8));
+				const __m256i ba = _mm256_or_si256(b, alpha);
+
+				const __m256i lo = _mm256_unpacklo_epi16(rg, ba), hi = _mm256_unpackhi_epi16(rg, ba);
+
+				_mm256_storeu_si256((__m256i*)(out + i), _mm256_permute2x128_si256(lo, hi, 0x20));
+				_mm256_storeu_si256((__m256i*)(out + i + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+			}
+
+			bgr5ToRGBA8SSE2(in + i, out + i, len - i);
+		}
+
+		NRE_TARGET("avx2")
+		inline __m256i rgba8ToBGR5AVX2(const rgba8 *in) {
+
+			const __m256i v = _mm256_loadu_si256((const __m256i*) in);
+			const __m256i mask = _mm256_set1_epi32(0xFF), mul = _mm256_set1_epi32(from8BitMul), add = _mm256_set1_epi32(from8BitAdd);
+
+			const __m256i r = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi16(_mm256_and_si256(v, mask), mul), add), from8BitShift);
+			const __m256i g = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(v, 8), mask), mul), add), from8BitShift);
+			const __m256i b = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(v, 16), mask), mul), add), from8BitShift);
+
+			return _mm256_or_si256(_mm256_or_si256(r, _mm256_slli_epi32(g, 5)), _mm256_slli_epi32(b, 10));
+		}
+
+		NRE_TARGET("avx2")
+		void rgba8ToBGR5AVX2(const rgba8 *in, bgr5 *out, usz len) {
+
+			usz i = 0;
+
+			for (; i + 16 <= len; i += 16) {
+				const __m256i packed = _mm256_packs_epi32(rgba8ToBGR5AVX2(in + i), rgba8ToBGR5AVX2(in + i + 8));
+				_mm256_storeu_si256((__m256i*)(out + i), _mm256_permute4x64_epi64(packed, 0xD8));
+			}
+
+			rgba8ToBGR5SSE2(in + i, out + i, len - i);
+		}
+
+		//CPU feature detection
+
+		inline bool hasSSSE3() {
+		#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 1);
+			return info[2] & (1 << 9);
+		#else
+			return __builtin_cpu_supports("ssse3");
+		#endif
+		}
+
+		inline bool hasAVX2() {
+		#ifdef _MSC_VER
+
+			int info[4];
+			__cpuid(info, 0);
+
+			if (info[0] < 7)
+				return false;
+
+			//AVX needs OS support for the ymm registers (OSXSAVE and XCR0)
+
+			__cpuid(info, 1);
+
+			if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6)
+				return false;
+
+			__cpuidex(info, 7, 0);
+			return info[1] & (1 << 5);
+
+		#else
+			return __builtin_cpu_supports("avx2");
+		#endif
+		}
+
+	#endif
+
+	#ifdef NRE_NEON
+
+		//NEON; tbl does the palette lookup for 16 colors and vst4/vst2 interleave the channels
+
+		inline uint8x16x2_t decodeTileNEON(const u8 *tile, usz half) {
+			const uint8x16_t v = vld1q_u8(tile + (half << 4));
+			return vzipq_u8(vandq_u8(v, vdupq_n_u8(0xF)), vshrq_n_u8(v, 4));
+		}
+
+		void tilesToR8NEON_4(const u8 *tiles, r8 *out, u16 w, u16 h) {
+
+			const usz count = usz(w >> 3) * (h >> 3);
+
+			for (usz j = 0; j < count; ++j) {
+
+				r8 *dst = tileOrigin(out, j, w);
+
+				for (usz half = 0; half < 2; ++half) {
+
+					const uint8x16x2_t idx = decodeTileNEON(tiles + (j << 5), half);
+
+					for (usz i = 0; i < 2; ++i) {
+						vst1_u8(dst + (half * 4 + i * 2) * w, vget_low_u8(idx.val[i]));
+						vst1_u8(dst + (half * 4 + i * 2 + 1) * w, vget_high_u8(idx.val[i]));
+					}
+				}
+			}
+		}
+
+		void tilesToRGBA8NEON_4(const u8 *tiles, rgba8 *out, u16 w, u16 h, const bgr5 *palette) {
+
+			const usz count = usz(w >> 3) * (h >> 3);
+
+			rgba8 lut[16];
+			toRGBA8Palette(palette, lut, 16);
+
+			u8 planes[4][16];
+
+			for (usz i = 0; i < 16; ++i)
+				for (usz k = 0; k < 4; ++k)
+					planes[k][i] = lut[i].data[k];
+
+			const uint8x16_t tbl[4] = { vld1q_u8(planes[0]), vld1q_u8(planes[1]), vld1q_u8(planes[2]), vld1q_u8(planes[3]) };
+
+			for (usz j = 0; j < count; ++j) {
+
+				rgba8 *dst = tileOrigin(out, j, w);
+
+				for (usz half = 0; half < 2; ++half) {
+
+					const uint8x16x2_t idx = decodeTileNEON(tiles + (j << 5), half);
+
+					for (usz r = 0; r < 4; ++r) {
+
+						const uint8x8_t row = r & 1 ? vget_high_u8(idx.val[r >> 1]) : vget_low_u8(idx.val[r >> 1]);
+						const uint8x8_t mask = vceq_u8(row, vdup_n_u8(0));
+
+						u8 *ptr = (u8*)(dst + (half * 4 + r) * w);
+						const uint8x8x4_t old = vld4_u8(ptr);
+
+						uint8x8x4_t px;
+
+						for (usz k = 0; k < 4; ++k)
+							px.val[k] = vbsl_u8(mask, old.val[k], vqtbl1_u8(tbl[k], row));
+
+						vst4_u8(ptr, px);
+					}
+				}
+			}
+		}
+
+		void tilesToBGR5NEON_4(const u8 *tiles, bgr5 *out, u16 w, u16 h, const bgr5 *palette) {
+
+			const usz count = usz(w >> 3) * (h >> 3);
+
+			u8 planes[2][16];
+
+			for (usz i = 0; i < 16; ++i) {
+				planes[0][i] = u8(palette[i]);
+				planes[1][i] = u8(palette[i] >> 8);
+			}
+
+			const uint8x16_t lo = vld1q_u8(planes[0]), hi = vld1q_u8(planes[1]);
+
+			for (usz j = 0; j < count; ++j) {
+
+				bgr5 *dst = tileOrigin(out, j, w);
+
+				for (usz half = 0; half < 2; ++half) {
+
+					const uint8x16x2_t idx = decodeTileNEON(tiles + (j << 5), half);
+
+					for (usz r = 0; r < 4; ++r) {
+						const uint8x8_t row = r & 1 ? vget_high_u8(idx.val[r >> 1]) : vget_low_u8(idx.val[r >> 1]);
+						const uint8x8x2_t px = { { vqtbl1_u8(lo, row), vqtbl1_u8(hi, row) } };
+						vst2_u8((u8*)(dst + (half * 4 + r) * w), px);
+					}
+				}
+			}
+		}
+
+		void bgr5ToRGBA8NEON(const bgr5 *in, rgba8 *out, usz len) {
+
+			const uint16x8_t mask = vdupq_n_u16(0x1F);
+
+			usz i = 0;
+
+			for (; i + 8 <= len; i += 8) {
+
+				const uint16x8_t v = vld1q_u16(in + i);
+
+				uint8x8x4_t px;
+				px.val[0] = vmovn_u16(vshrq_n_u16(vmulq_n_u16(vandq_u16(v, mask), to8BitMul), to8BitShift));
+				px.val[1] = vmovn_u16(vshrq_n_u16(vmulq_n_u16(vandq_u16(vshrq_n_u16(v, 5), mask), to8BitMul), to8BitShift));
+				px.val[2] = vmovn_u16(vshrq_n_u16(vmulq_n_u16(vandq_u16(vshrq_n_u16(v, 10), mask), to8BitMul), to8BitShift));
+				px.val[3] = vdup_n_u8(0xFF);
+
+				vst4_u8((u8*)(out + i), px);
+			}
+
+			bgr5ToRGBA8Scalar(in + i, out + i, len - i);
+		}
+
+		void rgba8ToBGR5NEON(const rgba8 *in, bgr5 *out, usz len) {
+
+			const uint8x8_t mul = vdup_n_u8(from8BitMul);
+			const uint16x8_t add = vdupq_n_u16(from8BitAdd);
+
+			usz i = 0;
+
+			for (; i + 8 <= len; i += 8) {
+
+				const uint8x8x4_t px = vld4_u8((const u8*)(in + i));
+
+				const uint16x8_t r = vshrq_n_u16(vaddq_u16(vmull_u8(px.val[0], mul), add), from8BitShift);
+				const uint16x8_t g = vshrq_n_u16(vaddq_u16(vmull_u8(px.val[1], mul), add), from8BitShift);
+				const uint16x8_t b = vshrq_n_u16(vaddq_u16(vmull_u8(px.val[2], mul), add), from8BitShift);
+
+				vst1q_u16(out + i, vorrq_u16(vorrq_u16(r, vshlq_n_u16(g, 5)), vshlq_n_u16(b, 10)));
+			}
+
+			rgba8ToBGR5Scalar(in + i, out + i, len - i);
+		}
+
+		void nearestColorsNEON(const bgr5 *in, u8 *out, usz len, const bgr5 *palette, usz colors) {
+
+			const PaletteComponents p(palette, colors);
+
+			static constexpr i16 firstIdx[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+			const int16x8_t step = vdupq_n_s16(8), first = vld1q_s16(firstIdx);
+
+			i16 dist[8], idx[8];
+
+			for (usz i = 0; i < len; ++i) {
+
+				const int16x8_t r = vdupq_n_s16(i16(in[i] & 0x1F));
+				const int16x8_t g = vdupq_n_s16(i16((in[i] >> 5) & 0x1F));
+				const int16x8_t b = vdupq_n_s16(i16((in[i] >> 10) & 0x1F));
+
+				int16x8_t best = vdupq_n_s16(0x7FFF), bestIdx = vdupq_n_s16(0), cur = first;
+
+				for (usz j = 0; j < p.groups; ++j) {
+
+					const int16x8_t dr = vsubq_s16(r, vld1q_s16(p.r + (j << 3)));
+					const int16x8_t dg = vsubq_s16(g, vld1q_s16(p.g + (j << 3)));
+					const int16x8_t db = vsubq_s16(b, vld1q_s16(p.b + (j << 3)));
+
+					const int16x8_t d = vmlaq_s16(vmlaq_s16(vmlaq_s16(vld1q_s16(p.bias + (j << 3)), dr, dr), dg, dg), db, db);
+					const uint16x8_t less = vcltq_s16(d, best);
+
+					best = vminq_s16(d, best);
+					bestIdx = vbslq_s16(less, cur, bestIdx);
+					cur = vaddq_s16(cur, step);
+				}
+
+				vst1q_s16(dist, best);
+				vst1q_s16(idx, bestIdx);
+				out[i] = pickNearest(dist, idx);
+			}
+		}
+
+	#endif
+
+	//Dispatch
+
+	const ColorKernels &ColorKernels::scalar() {
+
+		static const ColorKernels kernels{
+			{ tilesToR8Scalar<false>, tilesToR8Scalar<true> },
+			{ tilesToBGR5Scalar<false>, tilesToBGR5Scalar<true> },
+			{ tilesToRGBA8Scalar<false>, tilesToRGBA8Scalar<true> },
+			bgr5ToRGBA8Scalar,
+			rgba8ToBGR5Scalar,
+			nearestColorsScalar,
+			"Scalar"
+		};
+
+		return kernels;
+	}
+
+	inline ColorKernels selectKernels() {
+
+		ColorKernels kernels = ColorKernels::scalar();
+
+		#ifdef NRE_X64
+
+			kernels.tilesToR8[0] = tilesToR8SSE2_8;
+			kernels.tilesToR8[1] = tilesToR8SSE2_4;
+			kernels.tilesToBGR5[1] = tilesToBGR5SSE2_4;
+			kernels.tilesToRGBA8[1] = tilesToRGBA8SSE2_4;
+			kernels.bgr5ToRGBA8 = bgr5ToRGBA8SSE2;
+			kernels.rgba8ToBGR5 = rgba8ToBGR5SSE2;
+			kernels.nearestColors = nearestColorsSSE2;
+			kernels.name = "SSE2";
+
+			if (hasSSSE3()) {
+				kernels.tilesToBGR5[1] = tilesToBGR5SSSE3_4;
+				kernels.tilesToRGBA8[1] = tilesToRGBA8SSSE3_4;
+				kernels.name = "SSSE3";
+			}
+
+			if (hasAVX2()) {
+				kernels.tilesToRGBA8[0] = tilesToRGBA8AVX2_8;
+				kernels.tilesToRGBA8[1] = tilesToRGBA8AVX2_4;
+				kernels.bgr5ToRGBA8 = bgr5ToRGBA8AVX2;
+				kernels.rgba8ToBGR5 = rgba8ToBGR5AVX2;
+				kernels.name = "AVX2";
+			}
+
+		#elif defined(NRE_NEON)
+
+			kernels.tilesToR8[1] = tilesToR8NEON_4;
+			kernels.tilesToBGR5[1] = tilesToBGR5NEON_4;
+			kernels.tilesToRGBA8[1] = tilesToRGBA8NEON_4;
+			kernels.bgr5ToRGBA8 = bgr5ToRGBA8NEON;
+			kernels.rgba8ToBGR5 = rgba8ToBGR5NEON;
+			kernels.nearestColors = nearestColorsNEON;
+			kernels.name = "NEON";
+
+		#else
+
+			//Without SIMD, the table is still faster than the per channel divisions
+			kernels.bgr5ToRGBA8 = bgr5ToRGBA8Table;
+			kernels.name = "Table";
+
+		#endif
+
+		return kernels;
+	}
+
+	const ColorKernels &ColorKernels::get() {
+		static const ColorKernels kernels = selectKernels();
+		return kernels;
+	}
+
+}
@@ -0,0 +1,513 @@
+#include "helper/compression.hpp"
+#include <cstring>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+	#define NRE_X64
+	#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	#define NRE_NEON
+	#include <arm_neon.h>
+#endif
+
+namespace nre {
+
+	//Low 16 bits of the state after n steps; s(n) = mul(n) * s + add(n)
+
+	static constexpr u16 jumpMul(usz n) {
+
+		u32 mul = 1;
+
+		for (usz i = 0; i < n; ++i)
+			mul *= 0x41C64E6D;
+
+		return u16(mul);
+	}
+
+	static constexpr u16 jumpAdd(usz n) {
+
+		u32 add = 0;
+
+		for (usz i = 0; i < n; ++i)
+			add = CompressionHelper::generateRandom(add);
+
+		return u16(add);
+	}
+
+	static constexpr u16 jump8Mul = jumpMul(8), jump8Add = jumpAdd(8);
+
+	void CompressionHelper::RandomStream::xorBackward(const u16 *in, u16 *out, usz count) {
+
+		#if defined(NRE_X64) || defined(NRE_NEON)
+
+			if (count >= 8) {
+
+				//Lane i is the key for the u16 at end - 8 + i, so the first key goes in the last lane
+
+				alignas(16) u16 keys[8];
+
+				for (usz i = 0; i < 8; ++i) {
+					keys[7 - i] = u16(seed);
+					seed = generateRandom(seed);
+				}
+
+				#ifdef NRE_X64
+
+					__m128i state = _mm_load_si128((const __m128i*) keys);
+					const __m128i mul = _mm_set1_epi16(i16(jump8Mul)), add = _mm_set1_epi16(i16(jump8Add));
+
+					for (; count >= 8; count -= 8) {
+
+						const __m128i v = _mm_loadu_si128((const __m128i*)(in + count - 8));
+						_mm_storeu_si128((__m128i*)(out + count - 8), _mm_xor_si128(v, state));
+
+						state = _mm_add_epi16(_mm_mullo_epi16(state, mul), add);
+					}
+
+					_mm_store_si128((__m128i*) keys, state);
+
+				#else
+
+					uint16x8_t state = vld1q_u16(keys);
+					const uint16x8_t add = vdupq_n_u16(jump8Add);
+
+					for (; count >= 8; count -= 8) {
+						vst1q_u16(out + count - 8, veorq_u16(vld1q_u16(in + count - 8), state));
+						state = vmlaq_n_u16(add, state, jump8Mul);
+					}
+
+					vst1q_u16(keys, state);
+
+				#endif
+
+				//The last lane has the key for the next u16; the high bits of the seed don't affect the keys
+
+				seed = keys[7];
+			}
+
+		#endif
+
+		for (; count; --count) {
+			out[count - 1] = in[count - 1] ^ u16(seed);
+			seed = generateRandom(seed);
+		}
+	}
+
+	//Decoders
+	//These are templated on whether they write, so probe can do the same checks without any output.
+	//They return how many bytes were read (including the header) or 0 if the data is invalid.
+	//Matches that go past the decompressed size are cut off, like the BIOS does.
+
+	//Copy from earlier output; 8 bytes at a time if the source doesn't overlap the chunk and the output has room for it
+
+	static inline void copyMatch(u8 *out, usz o, usz disp, usz len, usz outSize) {
+
+		u8 *dst = out + o;
+		const u8 *src = dst - disp;
+
+		if (disp >= 8 && outSize - o >= ((len + 7) & ~usz(7)))
+			for (usz i = 0; i < len; i += 8)
+				std::memcpy(dst + i, src + i, 8);
+
+		else if (disp == 1)
+			std::memset(dst, *src, len);
+
+		else for (usz i = 0; i < len; ++i)
+			dst[i] = src[i];
+	}
+
+	template<bool write, bool isLZ11>
+	static usz decodeLZ(const u8 *in, usz inSize, usz pos, u8 *out, usz outSize) {
+
+		usz o = 0;
+
+		while (o < outSize) {
+
+			if (pos >= inSize)
+				return 0;
+
+			u8 flags = in[pos++];
+
+			//8 literals in a row is common for data that doesn't compress well
+
+			if (!flags && inSize - pos >= 8 && outSize - o >= 8) {
+
+				if constexpr (write)
+					std::memcpy(out + o, in + pos, 8);
+
+				pos += 8;
+				o += 8;
+				continue;
+			}
+
+			for (usz i = 0; i < 8 && o < outSize; ++i, flags <<= 1) {
+
+				if (!(flags & 0x80)) {
+
+					if (pos >= inSize)
+						return 0;
+
+					if constexpr (write)
+						out[o] = in[pos];
+
+					++o;
+					++pos;
+					continue;
+				}
+
+				usz len, disp;
+
+				if constexpr (!isLZ11) {
+
+					if (inSize - pos < 2)
+						return 0;
+
+					len = (in[pos] >> 4) + 3;
+					disp = (usz(in[pos] & 0xF) << 8 | in[pos + 1]) + 1;
+					pos += 2;
+
+				} else {
+
+					//Lengths of 1-16, 17-272 or 273-65808; the top nibble decides which
+
+					const u8 b0 = in[pos];
+
+					if (b0 >> 4 == 0) {
+
+						if (inSize - pos < 3)
+							return 0;
+
+						len = (usz(b0 & 0xF) << 4 | in[pos + 1] >> 4) + 0x11;
+						disp = (usz(in[pos + 1] & 0xF) << 8 | in[pos + 2]) + 1;
+						pos += 3;
+
+					} else if (b0 >> 4 == 1) {
+
+						if (inSize - pos < 4)
+							return 0;
+
+						len = (usz(b0 & 0xF) << 12 | usz(in[pos + 1]) << 4 | in[pos + 2] >> 4) + 0x111;
+						disp = (usz(in[pos + 2] & 0xF) << 8 | in[pos + 3]) + 1;
+						pos += 4;
+
+					} else {
+
+						if (inSize - pos < 2)
+							return 0;
+
+						len = (b0 >> 4) + 1;
+						disp = (usz(b0 & 0xF) << 8 | in[pos + 1]) + 1;
+						pos += 2;
+					}
+				}
+
+				if (disp > o)
+					return 0;
+
+				len = std::min(len, outSize - o);
+
+				if constexpr (write)
+					copyMatch(out, o, disp, len, outSize);
+
+				o += len;
+			}
+		}
+
+		return pos;
+	}
+
+	template<bool write>
+	static usz decodeRLE(const u8 *in, usz inSize, usz pos, u8 *out, usz outSize) {
+
+		usz o = 0;
+
+		while (o < outSize) {
+
+			if (pos >= inSize)
+				return 0;
+
+			const u8 flag = in[pos++];
+
+			if (flag & 0x80) {
+
+				if (pos >= inSize)
+					return 0;
+
+				const usz len = std::min(usz(flag & 0x7F) + 3, outSize - o);
+
+				if constexpr (write)
+					std::memset(out + o, in[pos], len);
+
+				++pos;
+				o += len;
+
+			} else {
+
+				const usz len = std::min(usz(flag & 0x7F) + 1, outSize - o);
+
+				if (inSize - pos < len)
+					return 0;
+
+				if constexpr (write)
+					std::memcpy(out + o, in + pos, len);
+
+				pos += len;
+				o += len;
+			}
+		}
+
+		return pos;
+	}
+
+	//Huffman trees are stored as nodes of a byte: child offset (0-5), child 1 is data (6), child 0 is data (7)
+	//The children are at (node & ~1) + offset * 2 + 2 relative to the start of the tree.
+	//The first 8 bits are decoded with a table, only longer codes walk the tree bit by bit.
+
+	struct HuffmanEntry {
+		u16 value;						//Data or the node to continue from
+		u8 length;
+		u8 isData;
+	};
+
+	static constexpr usz huffmanTableBits = 8;
+
+	static bool fillHuffmanTable(const u8 *tree, usz treeSize, usz node, usz depth, usz prefix, HuffmanEntry *table) {
+
+		const u8 n = tree[node];
+		const usz child = (node & ~usz(1)) + (usz(n & 0x3F) << 1) + 2;
+
+		if (child + 1 >= treeSize)
+			return false;
+
+		for (usz b = 0; b < 2; ++b) {
+
+			const usz code = prefix << 1 | b, length = depth + 1;
+
+			if (n & (0x80 >> b)) {
+
+				const usz shift = huffmanTableBits - length;
+
+				for (usz i = code << shift, end = (code + 1) << shift; i < end; ++i)
+					table[i] = HuffmanEntry{ tree[child + b], u8(length), true };
+
+			} else if (length == huffmanTableBits)
+				table[code] = HuffmanEntry{ u16(child + b), u8(length), false };
+
+			else if (!fillHuffmanTable(tree, treeSize, child + b, length, code, table))
+				return false;
+		}
+
+		return true;
+	}
+
+	template<bool write>
+	static usz decodeHuffman(const u8 *in, usz inSize, usz pos, u8 *out, usz outSize, usz bits) {
+
+		if (pos >= inSize)
+			return 0;
+
+		const u8 *tree = in + pos;
+		const usz treeSize = (usz(tree[0]) + 1) << 1;
+
+		if (inSize - pos < treeSize)
+			return 0;
+
+		HuffmanEntry table[1 << huffmanTableBits];
+
+		if (!fillHuffmanTable(tree, treeSize, 1, 0, 0, table))
+			return 0;
+
+		//The data is read as u32s, from the most significant bit; past the end it reads 0s,
+		//which is only an error if those bits are actually used
+
+		const usz dataStart = pos + treeSize;
+		usz next = dataStart;
+
+		u64 buffer = 0;
+		usz buffered = 0, used = 0;
+
+		auto refill = [&]() {
+
+			if (buffered > 32)
+				return;
+
+			u32 word = 0;
+
+			if (next < inSize)
+				std::memcpy(&word, in + next, std::min(usz(4), inSize - next));
+
+			buffer |= u64(word) << (32 - buffered);
+			buffered += 32;
+			next += 4;
+		};
+
+		auto consume = [&](usz count) {
+			buffer <<= count;
+			buffered -= count;
+			used += count;
+		};
+
+		const u8 mask = u8((1 << bits) - 1);
+		const usz symbols = outSize * 8 / bits;
+
+		u8 pending = 0;
+
+		for (usz i = 0; i < symbols; ++i) {
+
+			refill();
+
+			const HuffmanEntry e = table[buffer >> (64 - huffmanTableBits)];
+			consume(e.length);
+
+			u8 value = u8(e.value);
+
+			if (!e.isData)
+				for (usz node = e.value;;) {
+
+					refill();
+
+					const u8 n = tree[node];
+					const usz b = usz(buffer >> 63);
+					consume(1);
+
+					const usz child = (node & ~usz(1)) + (usz(n & 0x3F) << 1) + 2 + b;
+
+					if (child >= treeSize)
+						return 0;
+
+					if (n & (0x80 >> b)) {
+						value = tree[child];
+						break;
+					}
+
+					node = child;
+				}
+
+			value &= mask;
+
+			if constexpr (write) {
+
+				if (bits == 8)
+					out[i] = value;
+
+				else if (i & 1)
+					out[i >> 1] = u8(pending | value << 4);
+
+				else pending = value;
+			}
+		}
+
+		const usz end = dataStart + (((used + 31) >> 5) << 2);
+		return end <= inSize ? end : 0;
+	}
+
+	template<bool write>
+	static usz decode(const u8 *data, usz size, const CompressionInfo &info, u8 *out) {
+
+		switch (info.type) {
+
+			case COMPRESSION_LZ10:
+				return decodeLZ<write, false>(data, size, info.headerSize, out, info.decompressedSize);
+
+			case COMPRESSION_LZ11:
+				return decodeLZ<write, true>(data, size, info.headerSize, out, info.decompressedSize);
+
+			case COMPRESSION_HUFFMAN4:
+				return decodeHuffman<write>(data, size, info.headerSize, out, info.decompressedSize, 4);
+
+			case COMPRESSION_HUFFMAN8:
+				return decodeHuffman<write>(data, size, info.headerSize, out, info.decompressedSize, 8);
+
+			case COMPRESSION_RLE:
+				return decodeRLE<write>(data, size, info.headerSize, out, info.decompressedSize);
+
+			default:
+				return 0;
+		}
+	}
+
+	bool CompressionHelper::getHeader(const u8 *data, usz size, CompressionInfo &info) {
+
+		if (size < 4)
+			return false;
+
+		switch (data[0]) {
+
+			case COMPRESSION_LZ10:
+			case COMPRESSION_LZ11:
+			case COMPRESSION_HUFFMAN4:
+			case COMPRESSION_HUFFMAN8:
+			case COMPRESSION_RLE:
+				break;
+
+			default:
+				return false;
+		}
+
+		info.type = CompressionType(data[0]);
+		info.headerSize = 4;
+		info.compressedSize = 0;
+		info.decompressedSize = u32(data[1]) | u32(data[2]) << 8 | u32(data[3]) << 16;
+
+		//Sizes that don't fit in 24 bits are stored in the next u32
+
+		if (!info.decompressedSize) {
+
+			if (size < 8)
+				return false;
+
+			std::memcpy(&info.decompressedSize, data + 4, 4);
+			info.headerSize = 8;
+		}
+
+		return info.decompressedSize && info.decompressedSize <= maxDecompressedSize;
+	}
+
+	bool CompressionHelper::probe(const u8 *data, usz size, CompressionInfo &info) {
+
+		if (!getHeader(data, size, info))
+			return false;
+
+		const usz read = decode<false>(data, size, info, nullptr);
+
+		if (!read || size - read > maxPadding)
+			return false;
+
+		info.compressedSize = u32(read);
+		return true;
+	}
+
+	bool CompressionHelper::decompress(const u8 *data, usz size, u8 *out, usz outSize) {
+
+		CompressionInfo info;
+
+		if (!getHeader(data, size, info) || outSize < info.decompressedSize)
+			return false;
+
+		return decode<true>(data, size, info, out);
+	}
+
+	bool CompressionHelper::decompress(const u8 *data, usz size, Buffer &out) {
+
+		CompressionInfo info;
+
+		if (!getHeader(data, size, info))
+			return false;
+
+		out.resize(info.decompressedSize);
+		return decode<true>(data, size, info, out.data());
+	}
+
+	const c8 *CompressionHelper::getName(CompressionType type) {
+
+		switch (type) {
+			case COMPRESSION_LZ10:		return "LZ10";
+			case COMPRESSION_LZ11:		return "LZ11";
+			case COMPRESSION_HUFFMAN4:	return "Huffman (4 bit)";
+			case COMPRESSION_HUFFMAN8:	return "Huffman (8 bit)";
+			case COMPRESSION_RLE:		return "RLE";
+			default:					return "None";
+		}
+	}
+
+}
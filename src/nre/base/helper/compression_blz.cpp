@@ -0,0 +1,97 @@
+#include "helper/compression.hpp"
+#include <cstring>
+#include <algorithm>
+
+namespace nre {
+
+	//Footer: compressed size (0-23) and footer size (24-31), then how much bigger the data gets when it's decompressed
+	//The compressed size includes the footer and the footer can be padded (up to 0xB bytes)
+
+	bool CompressionHelper::getBLZFooter(const u8 *data, usz size, u32 &compressedSize, u32 &footerSize, u32 &extraSize) {
+
+		if (size < 8)
+			return false;
+
+		u32 footer[2];
+		std::memcpy(footer, data + size - 8, sizeof(footer));
+
+		compressedSize = footer[0] & 0xFFFFFF;
+		footerSize = footer[0] >> 24;
+		extraSize = footer[1];
+
+		return
+			footerSize >= 8 && footerSize <= compressedSize && compressedSize <= size &&
+			extraSize <= maxDecompressedSize && size + extraSize <= maxDecompressedSize;
+	}
+
+	bool CompressionHelper::decompressBLZ(const u8 *data, usz size, Buffer &out) {
+
+		u32 compressedSize, footerSize, extraSize;
+
+		if (size < 8)
+			return false;
+
+		//Data that wasn't worth compressing only has a footer with an extra size of 0
+
+		std::memcpy(&extraSize, data + size - 4, sizeof(extraSize));
+
+		if (!extraSize) {
+			out.assign(data, data + size);
+			return true;
+		}
+
+		if (!getBLZFooter(data, size, compressedSize, footerSize, extraSize))
+			return false;
+
+		const usz begin = size - compressedSize;		//Everything before this isn't compressed
+		out.resize(size + extraSize);
+
+		std::memcpy(out.data(), data, begin);
+
+		//Tokens are read from the end of the data and written from the end of the output;
+		//flags are a byte, from the top bit, and a match is 2 bytes: length - 3 (12-15) and distance - 3 (0-11)
+
+		usz src = size - footerSize, dst = out.size();
+		u8 *o = out.data();
+
+		while (dst > begin) {
+
+			if (src <= begin)
+				return false;
+
+			u8 flags = data[--src];
+
+			for (usz i = 0; i < 8 && dst > begin; ++i, flags <<= 1) {
+
+				if (!(flags & 0x80)) {
+
+					if (src <= begin)
+						return false;
+
+					o[--dst] = data[--src];
+					continue;
+				}
+
+				if (src < begin + 2)
+					return false;
+
+				const u16 token = u16(data[src - 1] << 8 | data[src - 2]);
+				src -= 2;
+
+				const usz distance = (token & 0xFFF) + 3;
+				usz len = (token >> 12) + 3;
+
+				if (dst + distance > out.size())
+					return false;
+
+				len = std::min(len, dst - begin);
+
+				for (; len; --len, --dst)
+					o[dst - 1] = o[dst - 1 + distance];
+			}
+		}
+
+		return true;
+	}
+
+}
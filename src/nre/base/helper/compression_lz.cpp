@@ -0,0 +1,557 @@
+#include "helper/compression.hpp"
+#include "helper/parallel.hpp"
+#include <cstring>
+#include <algorithm>
+
+namespace nre {
+
+	//LZ10/LZ11 share the window and flags; only the lengths (and how they're stored) differ
+	//BLZ is LZ10 on the reversed data, with distances that start at 3 instead of 1
+
+	static constexpr usz minMatch = 3;
+	static constexpr usz hashBits = 15;
+
+	//Parts smaller than this aren't worth a thread
+	static constexpr usz minPartSize = 64 << 10;
+
+	struct LZFormat {
+
+		usz window, minDistance;
+		bool isLZ11;
+
+		inline usz maxMatch() const { return isLZ11 ? 0x10110 : 0x12; }
+
+		//Bits a match of this length takes (including its flag bit); a literal takes 9
+		inline usz matchCost(usz len) const {
+			return !isLZ11 || len <= 0x10 ? 17 : (len <= 0x110 ? 25 : 33);
+		}
+	};
+
+	//Distance 1 is never used, since the BIOS' VRAM decompression writes u16s and can't copy those
+	static constexpr LZFormat lz10{ 0x1000, 2, false }, lz11{ 0x1000, 2, true }, blz{ 0x1002, 3, false };
+
+	//A token is a literal (0) or a match: (length << 13) | (distance - 1)
+	using Token = u32;
+	static constexpr usz tokenDistanceBits = 13;
+
+	static inline usz matchLength(const u8 *a, const u8 *b, usz max) {
+
+		usz len = 0;
+
+		for (; len + 8 <= max; len += 8) {
+
+			u64 x, y;
+			std::memcpy(&x, a + len, 8);
+			std::memcpy(&y, b + len, 8);
+
+			if (const u64 diff = x ^ y) {
+
+				#ifdef _MSC_VER
+					unsigned long bit;
+					_BitScanForward64(&bit, diff);
+					return len + (bit >> 3);
+				#else
+					return len + (usz(__builtin_ctzll(diff)) >> 3);
+				#endif
+			}
+		}
+
+		while (len < max && a[len] == b[len])
+			++len;
+
+		return len;
+	}
+
+	//Hash chains over 3 bytes; positions from base (the start of the window of the part) onwards can be inserted
+
+	class MatchFinder {
+
+	public:
+
+		MatchFinder(const u8 *data, usz size, usz base, usz end, const LZFormat &format):
+			data(data), size(size), base(base), window(format.window), minDistance(format.minDistance),
+			head(usz(1) << hashBits, -1), prev(end - base, -1) {}
+
+		inline void insert(usz pos) {
+
+			if (size - pos < minMatch)
+				return;
+
+			const u32 h = hash(pos);
+			prev[pos - base] = head[h];
+			head[h] = i64(pos);
+		}
+
+		//Longest match at pos (0 if there's none); chain is how many earlier positions are tried at most
+		inline usz find(usz pos, usz max, usz chain, usz &distance) const {
+
+			max = std::min(max, size - pos);
+
+			if (max < minMatch)
+				return 0;
+
+			usz best = 0;
+
+			for (i64 cand = head[hash(pos)]; cand >= 0 && chain; cand = prev[usz(cand) - base], --chain) {
+
+				const usz dist = pos - usz(cand);
+
+				if (dist > window)
+					break;
+
+				if (dist < minDistance || data[usz(cand) + best] != data[pos + best])
+					continue;
+
+				const usz len = matchLength(data + usz(cand), data + pos, max);
+
+				if (len > best) {
+
+					best = len;
+					distance = dist;
+
+					if (len == max)
+						break;
+				}
+			}
+
+			return best >= minMatch ? best : 0;
+		}
+
+		//Longest match at pos, given the longest one at pos - 1 (over minMatch, but under the maximum length).
+		//A candidate that matched the byte before pos as well was already tried there, so it's one shorter now and can't be longer;
+		//only the others are compared. Like find over the whole window this is exact, but inside a run it doesn't compare
+		//every earlier position of the run up to its end.
+		inline usz findNext(usz pos, usz max, usz prevLength, usz prevDistance, usz &distance) const {
+
+			max = std::min(max, size - pos);
+
+			usz best = prevLength - 1;
+			distance = prevDistance;
+
+			if (best >= max)
+				return max;
+
+			for (i64 cand = head[hash(pos)]; cand >= 0; cand = prev[usz(cand) - base]) {
+
+				const usz dist = pos - usz(cand);
+
+				if (dist > window)
+					break;
+
+				if (
+					dist < minDistance || data[usz(cand) + best] != data[pos + best] ||
+					(usz(cand) > base && data[usz(cand) - 1] == data[pos - 1])
+				)
+					continue;
+
+				const usz len = matchLength(data + usz(cand), data + pos, max);
+
+				if (len > best) {
+
+					best = len;
+					distance = dist;
+
+					if (len == max)
+						break;
+				}
+			}
+
+			return best;
+		}
+
+	private:
+
+		inline u32 hash(usz pos) const {
+			const u32 v = u32(data[pos]) << 16 | u32(data[pos + 1]) << 8 | data[pos + 2];
+			return (v * 2654435761u) >> (32 - hashBits);
+		}
+
+		const u8 *data;
+		usz size, base, window, minDistance;
+
+		List<i64> head, prev;
+	};
+
+	//Parses [beg, end>; matches can start before beg, since the decoder has all earlier output as well
+
+	static void parseFast(const u8 *data, usz size, usz beg, usz end, const LZFormat &format, List<Token> &tokens) {
+
+		const usz base = beg > format.window ? beg - format.window : 0;
+		MatchFinder finder(data, size, base, end, format);
+
+		for (usz i = base; i < beg; ++i)
+			finder.insert(i);
+
+		const usz max = format.maxMatch(), chain = 16;
+
+		for (usz i = beg; i < end; ) {
+
+			usz dist{}, len = finder.find(i, std::min(max, end - i), chain, dist);
+			finder.insert(i);
+
+			//Lazy matching; a literal is better if the next position has a longer match
+
+			if (len && len < max && i + 1 < end) {
+
+				usz nextDist{};
+				const usz next = finder.find(i + 1, std::min(max, end - i - 1), chain, nextDist);
+
+				if (next > len + 1)
+					len = 0;
+			}
+
+			if (!len) {
+				tokens.push_back(0);
+				++i;
+				continue;
+			}
+
+			tokens.push_back(Token(len << tokenDistanceBits | (dist - 1)));
+
+			for (usz j = i + 1; j < i + len; ++j)
+				finder.insert(j);
+
+			i += len;
+		}
+	}
+
+	//Cheapest position (by cost to the end) in the window [i + first, i + last], while i goes down one at a time
+	//Ties go to the lowest position, which is the shortest match
+
+	class CheapestInWindow {
+
+	public:
+
+		CheapestInWindow(const List<u64> &cost, usz first, usz last): first(first), last(last), cost(cost) {}
+
+		//Moves the window to i; positions past end don't exist
+		inline void move(usz i, usz end) {
+
+			const usz enter = i + first;
+
+			if (enter <= end) {
+
+				while (size && cost[ring[head]] >= cost[enter])
+					head = (head + 1) & mask, --size;
+
+				head = (head - 1) & mask;
+				ring[head] = u32(enter);
+				++size;
+			}
+
+			while (size && ring[(head + size - 1) & mask] > i + last)
+				--size;
+		}
+
+		inline u32 get() const {
+			return size ? ring[(head + size - 1) & mask] : u32_MAX;
+		}
+
+		const usz first, last;
+
+	private:
+
+		static constexpr usz mask = 0x1FF;
+
+		const List<u64> &cost;
+		u32 ring[mask + 1];
+		usz head{}, size{};
+	};
+
+	//Finds the longest match at every position, then picks the cheapest way to get to the end of the part
+	//Any prefix of a match is a match as well and the cost only depends on the length, so the longest match is enough
+
+	static void parseSmallest(const u8 *data, usz size, usz beg, usz end, const LZFormat &format, List<Token> &tokens) {
+
+		const usz base = beg > format.window ? beg - format.window : 0;
+		MatchFinder finder(data, size, base, end, format);
+
+		for (usz i = base; i < beg; ++i)
+			finder.insert(i);
+
+		const usz count = end - beg, max = format.maxMatch();
+
+		List<u32> length(count), distance(count);
+
+		for (usz i = beg; i < end; ++i) {
+
+			//Inside a very long match (runs of the same bytes), only the candidates that didn't match at the previous position
+			//are compared; otherwise every position would compare up to 64 KiB
+
+			const usz j = i - beg;
+			usz dist{};
+
+			if (j && length[j - 1] > 0x111 && length[j - 1] < max)
+				length[j] = u32(finder.findNext(i, std::min(max, end - i), length[j - 1], distance[j - 1], dist));
+			else
+				length[j] = u32(finder.find(i, std::min(max, end - i), format.window, dist));
+
+			distance[j] = u32(dist);
+			finder.insert(i);
+		}
+
+		//Cheapest cost from every position to the end and the length to use there (0 = literal)
+
+		List<u64> cost(count + 1);
+		List<u32> choice(count);
+
+		//Lengths that take the same bits are a class, so only the cheapest position a class can end at matters.
+		//If a match covers a whole class, that's kept up to date as the window moves back, instead of trying every length.
+		//LZ11 matches over 0x110 usually end at the same position as the one after them, with one more length
+		//every step back; the cheapest end is kept while that holds, so every step only compares the one new end.
+
+		CheapestInWindow short0(cost, minMatch, format.isLZ11 ? 0x10 : 0x12), short1(cost, 0x11, 0x110);
+		usz runBeg{}, runEnd = usz_MAX, runBest{};
+
+		for (usz i = count; i--; ) {
+
+			u64 best = 9 + cost[i + 1];
+			u32 pick = 0;
+
+			const usz len = length[i];
+
+			auto tryLength = [&](usz l) {
+
+				const u64 c = format.matchCost(l) + cost[i + l];
+
+				if (c < best) {
+					best = c;
+					pick = u32(l);
+				}
+			};
+
+			auto tryClass = [&](CheapestInWindow &window) {
+
+				window.move(i, count);
+
+				if (len >= window.last) {
+					if (const u32 pos = window.get(); pos != u32_MAX)
+						tryLength(pos - i);
+				}
+
+				else for (usz l = window.first; l <= len; ++l)
+					tryLength(l);
+			};
+
+			tryClass(short0);
+
+			if (format.isLZ11)
+				tryClass(short1);
+
+			if (len > 0x110) {
+
+				const usz beg = i + 0x111, end = i + len;
+
+				if (end != runEnd || runBeg < beg)
+					runBeg = runEnd = runBest = end;
+
+				while (runBeg > beg)
+					if (cost[--runBeg] <= cost[runBest])
+						runBest = runBeg;
+
+				tryLength(runBest - i);
+			}
+
+			cost[i] = best;
+			choice[i] = pick;
+		}
+
+		for (usz i = 0; i < count; ) {
+
+			if (!choice[i]) {
+				tokens.push_back(0);
+				++i;
+				continue;
+			}
+
+			tokens.push_back(Token(usz(choice[i]) << tokenDistanceBits | (distance[i] - 1)));
+			i += choice[i];
+		}
+	}
+
+	//Parse the parts in parallel
+
+	static List<List<Token>> parse(
+		const u8 *data, usz size, const LZFormat &format, CompressionLevel level, usz threads
+	) {
+
+		const usz parts = std::max(usz(1), std::min(threads, size / minPartSize));
+		const usz partSize = (size + parts - 1) / parts;
+
+		List<List<Token>> tokens(parts);
+
+		Parallel::forEach(parts, threads, [&](usz i) {
+
+			const usz beg = i * partSize, end = std::min(size, beg + partSize);
+
+			if (level == COMPRESSION_SMALLEST)
+				parseSmallest(data, size, beg, end, format, tokens[i]);
+			else
+				parseFast(data, size, beg, end, format, tokens[i]);
+		});
+
+		return tokens;
+	}
+
+	bool CompressionHelper::compress(
+		const u8 *data, usz size, CompressionType type, Buffer &out,
+		CompressionLevel level, usz threads
+	) {
+
+		if ((type != COMPRESSION_LZ10 && type != COMPRESSION_LZ11) || size > u32_MAX)
+			return false;
+
+		const bool isLZ11 = type == COMPRESSION_LZ11;
+		const List<List<Token>> tokens = parse(data, size, isLZ11 ? lz11 : lz10, level, threads);
+
+		//The flag bytes group 8 tokens, even across parts, so writing is done in order
+
+		out.clear();
+		out.reserve(size / 2 + 16);
+
+		if (size < (1 << 24)) {
+			const u32 header = u32(type) | u32(size) << 8;
+			out.insert(out.end(), (const u8*) &header, (const u8*) &header + 4);
+		}
+
+		else {
+			const u32 header[2] = { u32(type), u32(size) };
+			out.insert(out.end(), (const u8*) header, (const u8*) header + 8);
+		}
+
+		usz flagPos{}, group = 8, pos = 0;
+
+		for (const List<Token> &part : tokens)
+			for (const Token t : part) {
+
+				if (group == 8) {
+					flagPos = out.size();
+					out.push_back(0);
+					group = 0;
+				}
+
+				if (!t) {
+					out.push_back(data[pos++]);
+					++group;
+					continue;
+				}
+
+				out[flagPos] |= u8(0x80 >> group);
+				++group;
+
+				const usz len = t >> tokenDistanceBits, dist = t & ((1 << tokenDistanceBits) - 1);
+				pos += len;
+
+				if (!isLZ11)
+					out.insert(out.end(), { u8((len - 3) << 4 | dist >> 8), u8(dist) });
+
+				else if (len <= 0x10)
+					out.insert(out.end(), { u8((len - 1) << 4 | dist >> 8), u8(dist) });
+
+				else if (len <= 0x110) {
+					const usz l = len - 0x11;
+					out.insert(out.end(), { u8(l >> 4), u8((l & 0xF) << 4 | dist >> 8), u8(dist) });
+				}
+
+				else {
+					const usz l = len - 0x111;
+					out.insert(out.end(), { u8(0x10 | l >> 12), u8(l >> 4), u8((l & 0xF) << 4 | dist >> 8), u8(dist) });
+				}
+			}
+
+		out.resize((out.size() + 3) & ~usz(3));
+		return true;
+	}
+
+	bool CompressionHelper::compressBLZ(
+		const u8 *data, usz size, Buffer &out, usz uncompressed,
+		CompressionLevel level, usz threads
+	) {
+
+		out.clear();
+
+		if (uncompressed >= size || size > maxDecompressedSize)
+			return false;
+
+		//The data is compressed front to back after reversing it, which is back to front for the decoder
+
+		const usz count = size - uncompressed;
+		Buffer reversed(data + uncompressed, data + size);
+		std::reverse(reversed.begin(), reversed.end());
+
+		const List<List<Token>> tokens = parse(reversed.data(), count, blz, level, threads);
+
+		//Encode the tokens in the order they're decoded (reversed) and find where to stop compressing.
+		//The decoder works in place, so it can't write over compressed data it hasn't read yet;
+		//that can't happen as long as no later part of the stream is bigger compressed than it is raw.
+		//Stopping where stream + the data left raw is smallest gives exactly that, and the smallest output.
+
+		Buffer stream;
+		stream.reserve(count / 2 + 16);
+
+		usz flagPos{}, group = 8, pos{};
+		usz bestStream{}, bestPos{};
+
+		for (const List<Token> &part : tokens)
+			for (const Token t : part) {
+
+				if (group == 8) {
+					flagPos = stream.size();
+					stream.push_back(0);
+					group = 0;
+				}
+
+				if (!t) {
+					stream.push_back(reversed[pos++]);
+					++group;
+				}
+
+				else {
+
+					stream[flagPos] |= u8(0x80 >> group);
+					++group;
+
+					const usz len = t >> tokenDistanceBits, dist = (t & ((1 << tokenDistanceBits) - 1)) + 1;
+					const usz v = (len - 3) << 12 | (dist - 3);
+
+					stream.push_back(u8(v >> 8));
+					stream.push_back(u8(v));
+					pos += len;
+				}
+
+				if (stream.size() + count - pos < bestStream + count - bestPos) {
+					bestStream = stream.size();
+					bestPos = pos;
+				}
+			}
+
+		//Raw part, then the stream back to front, padding to 4 bytes and the footer
+
+		const usz raw = size - bestPos;
+
+		out.reserve(raw + bestStream + 12);
+		out.assign(data, data + raw);
+		out.insert(out.end(), stream.rend() - bestStream, stream.rend());
+
+		usz footerSize = 8;
+
+		while (out.size() & 3) {
+			out.push_back(0xFF);
+			++footerSize;
+		}
+
+		const u32 footer[2] = {
+			u32(bestStream + footerSize) | u32(footerSize) << 24,
+			u32(size - (out.size() + 8))
+		};
+
+		if (!bestStream || out.size() + 8 >= size) {
+			out.clear();
+			return false;
+		}
+
+		out.insert(out.end(), (const u8*) footer, (const u8*) footer + sizeof(footer));
+		return true;
+	}
+
+}
\ No newline at end of file
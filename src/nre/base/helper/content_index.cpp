@@ -0,0 +1,153 @@
+#include "helper/content_index.hpp"
+#include "helper/narc_file_system.hpp"
+#include "helper/hash.hpp"
+#include "helper/parallel.hpp"
+#include <memory>
+#include <cstring>
+#include <cstdio>
+
+using namespace oic;
+
+namespace nre {
+
+	//Collects the files, and the files of archives in them; the archives have to be kept alive until the files are hashed
+
+	static void collect(
+		const FileSystem &fs, const String &prefix, bool walkArchives,
+		List<const FileInfo*> &files, List<String> &paths, List<std::unique_ptr<NARCFileSystem>> &archives
+	) {
+
+		for (auto &f : fs.getVirtualFiles()) {
+
+			if (f.isFolder())
+				continue;
+
+			const String path = prefix + f.path.substr(1);
+
+			files.push_back(&f);
+			paths.push_back(path);
+
+			if (!walkArchives || !NARCFileSystem::isArchive(f.dataExt, usz(f.fileSize)))
+				continue;
+
+			//Broken archives are only hashed as a whole
+
+			try {
+				archives.push_back(std::make_unique<NARCFileSystem>((u8*) f.dataExt, usz(f.fileSize)));
+			} catch (std::runtime_error&) {
+				continue;
+			}
+
+			collect(*archives.back(), path + ".d", walkArchives, files, paths, archives);
+		}
+	}
+
+	ContentIndex::ContentIndex(const NDSFileSystem &fs, bool walkArchives, usz threads): walkArchives(walkArchives) {
+
+		List<const FileInfo*> files;
+		List<String> paths;
+		List<std::unique_ptr<NARCFileSystem>> archives;
+
+		collect(fs, "~", walkArchives, files, paths, archives);
+
+		const u8 *rom = (const u8*) fs.getNDS();
+		entries.resize(files.size());
+
+		Parallel::forEach(files.size(), threads, [&](usz i) {
+
+			const FileInfo &f = *files[i];
+
+			entries[i] = ContentEntry{
+				std::move(paths[i]),
+				u32((const u8*) f.dataExt - rom), u32(f.fileSize),
+				HashHelper::xxh64(f.dataExt, usz(f.fileSize))
+			};
+		});
+	}
+
+	String ContentIndex::getPath(const String &rom) {
+		return rom.substr(0, rom.find_last_of('.')) + ".index";
+	}
+
+	//Entries are stored as offset, size, hash, path length and the path
+
+	bool ContentIndex::save(const String &file, u64 romSize, i64 romTime) const {
+
+		std::FILE *f = std::fopen(file.c_str(), "wb");
+
+		if (!f)
+			return false;
+
+		const Header header{
+			{ 'N', 'R', 'I', 'X' }, version,
+			romSize, romTime,
+			u32(entries.size()), walkArchives ? 1u : 0u
+		};
+
+		bool success = std::fwrite(&header, sizeof(header), 1, f) == 1;
+
+		for (usz i = 0; i < entries.size() && success; ++i) {
+
+			const ContentEntry &e = entries[i];
+			const u32 meta[3] = { e.offset, e.size, u32(e.path.size()) };
+
+			success =
+				std::fwrite(meta, sizeof(meta), 1, f) == 1 &&
+				std::fwrite(&e.hash, sizeof(e.hash), 1, f) == 1 &&
+				std::fwrite(e.path.data(), 1, e.path.size(), f) == e.path.size();
+		}
+
+		return !std::fclose(f) && success;
+	}
+
+	bool ContentIndex::load(const String &file, u64 romSize, i64 romTime, bool walk) {
+
+		entries.clear();
+
+		std::FILE *f = std::fopen(file.c_str(), "rb");
+
+		if (!f)
+			return false;
+
+		Header header;
+
+		bool success =
+			std::fread(&header, sizeof(header), 1, f) == 1 &&
+			!std::memcmp(header.magic, "NRIX", 4) && header.version == version &&
+			header.romSize == romSize && header.romTime == romTime &&
+			bool(header.flags & 1) == walk &&
+			header.entries <= romSize;			//Every file is at least one byte of FNT
+
+		if (success)
+			entries.resize(header.entries);
+
+		for (usz i = 0; i < entries.size() && success; ++i) {
+
+			ContentEntry &e = entries[i];
+			u32 meta[3];
+
+			success =
+				std::fread(meta, sizeof(meta), 1, f) == 1 &&
+				std::fread(&e.hash, sizeof(e.hash), 1, f) == 1 &&
+				meta[2] <= 0xFFFF;
+
+			if (!success)
+				break;
+
+			e.offset = meta[0];
+			e.size = meta[1];
+			e.path.resize(meta[2]);
+
+			success = std::fread(e.path.data(), 1, e.path.size(), f) == e.path.size();
+		}
+
+		std::fclose(f);
+
+		if (!success)
+			entries.clear();
+
+		walkArchives = walk;
+		return success;
+	}
+
+}
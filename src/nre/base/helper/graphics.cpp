@@ -0,0 +1,543 @@
+#include "helper/graphics.hpp"
+#include "helper/compression.hpp"
+#include "helper/quantize.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+namespace nre {
+
+	//Character data of an NCGR
+
+	struct Characters {
+		const r4_8 *data;
+		usz size, tileCount;
+		bool is4Bit, isLinear, isEncrypted;
+	};
+
+	inline bool getCharacters(const NCGR &ncgr, Characters &chars, bool isEncrypted = false) {
+
+		const RAHC *rahc = ncgr.get<RAHC>();
+
+		if (!rahc || (rahc->tileDepth != 3 && rahc->tileDepth != 4))
+			return false;
+
+		chars.is4Bit = rahc->tileDepth == 3;
+		chars.isLinear = rahc->isLinear || isEncrypted;		//Encrypted graphics are always linear
+		chars.isEncrypted = isEncrypted;
+		chars.data = getSectionData(rahc);
+
+		chars.size = std::min(usz(rahc->tileDataSize), usz(rahc->size - sizeof(RAHC)));
+		chars.tileCount = chars.size / (chars.is4Bit ? 32 : 64);
+		return true;
+	}
+
+	//Encrypted graphics are decrypted in small chunks right before they're decoded,
+	//so the data is only read once and never copied as a whole (or modified in the ROM)
+
+	template<bool is4Bit, typename T>
+	inline void decrypt(const Characters &chars, T *out, usz pixels, const bgr5 *palette, usz colors) {
+
+		constexpr usz chunk = 512;
+		constexpr usz pixelsPerU16 = is4Bit ? 4 : 2;
+
+		const u16 *data = (const u16*) chars.data;
+		usz end = chars.size >> 1;
+
+		if (!end)
+			return;
+
+		//The key stream starts at the last u16, so the chunks are done back to front
+
+		CompressionHelper::RandomStream stream{ data[end - 1] };
+		u16 buffer[chunk];
+
+		while (end) {
+
+			const usz beg = end > chunk ? end - chunk : 0;
+			stream.xorBackward(data + beg, buffer, end - beg);
+
+			const usz first = beg * pixelsPerU16;
+
+			if (first < pixels) {
+				const usz count = std::min((end - beg) * pixelsPerU16, pixels - first);
+
+				if constexpr (std::is_same_v<T, rgba8>)
+					R4_8::toRGBA8Image<is4Bit, false>((const u8*) buffer, out + first, u16(count), 1, palette, colors);
+				else
+					R4_8::toR8Image<is4Bit, false>((const u8*) buffer, out + first, u16(count), 1);
+			}
+
+			end = beg;
+		}
+	}
+
+	//Palette of an NCLR; palettes can be shorter than the indices can address, so it's padded with 0 to 256 colors
+	//colors is how many the NCLR really has
+
+	inline bool getPalette(const NCLR &nclr, List<bgr5> &palette, usz &colors) {
+
+		const TTLP *ttlp = nclr.get<TTLP>();
+
+		if (!ttlp)
+			return false;
+
+		colors = std::min(usz(ttlp->dataSize / sizeof(bgr5)), getSectionDataCount(ttlp));
+
+		palette.assign(std::max(colors, usz(256)), 0);
+		std::copy(getSectionData(ttlp), getSectionData(ttlp) + colors, palette.begin());
+		return true;
+	}
+
+	//Calls f(i, tilesX, paletteOffset, idx) for every screen entry; idx are the 64 (already flipped) indices of its tile
+
+	template<typename Func>
+	inline bool forEachScreenTile(const Characters &chars, const NSCR &nscr, u16 w, u16 h, Func f) {
+
+		//Screens point to tiles, which only works if the graphics are stored as tiles
+
+		if (chars.isLinear)
+			return false;
+
+		const NRCS *nrcs = nscr.get<NRCS>();
+		const ScreenEntry *screen = getSectionData(nrcs);
+
+		const usz tilesX = w >> 3;
+		const usz entries = std::min(usz(nrcs->screenDataSize / sizeof(ScreenEntry)), getSectionDataCount(nrcs));
+		const usz count = std::min(entries, tilesX * (h >> 3));
+
+		u8 idx[64], flipped[64];
+
+		for (usz i = 0; i < count; ++i) {
+
+			const ScreenEntry entry = screen[i];
+			const usz tile = entry & 0x3FF;
+
+			if (tile >= chars.tileCount)
+				continue;
+
+			if (chars.is4Bit)
+				for (usz j = 0; j < 64; ++j)
+					idx[j] = R4_8::sample4Bit(chars.data + (tile << 5), j);
+			else
+				std::memcpy(idx, chars.data + (tile << 6), 64);
+
+			const usz flipX = entry & (1 << 10) ? 7 : 0;
+			const usz flipY = entry & (1 << 11) ? 7 : 0;
+
+			for (usz j = 0; j < 64; ++j)
+				flipped[j] = idx[j ^ (flipY << 3) ^ flipX];
+
+			const usz paletteOffset = chars.is4Bit ? usz(entry >> 12) << 4 : 0;
+			f(i, tilesX, paletteOffset, (const u8*) flipped);
+		}
+
+		return true;
+	}
+
+	bool GraphicsHelper::getSize(const NCGR &ncgr, const NSCR *nscr, u16 &w, u16 &h) {
+
+		if (nscr) {
+
+			const NRCS *nrcs = nscr->get<NRCS>();
+
+			if (!nrcs || !nrcs->screenWidth || !nrcs->screenHeight || nrcs->screenWidth % 8 || nrcs->screenHeight % 8)
+				return false;
+
+			w = nrcs->screenWidth;
+			h = nrcs->screenHeight;
+			return true;
+		}
+
+		Characters chars;
+
+		if (!getCharacters(ncgr, chars) || !chars.tileCount)
+			return false;
+
+		const RAHC *rahc = ncgr.get<RAHC>();
+
+		usz tilesX = rahc->tileWidth, tilesY = rahc->tileHeight;
+
+		//0xFFFF (or a size that doesn't fit the data) means the size is decided by whatever uses the graphics
+
+		if (tilesX == 0xFFFF || tilesY == 0xFFFF || !tilesX || !tilesY || tilesX * tilesY > chars.tileCount) {
+
+			tilesX = 32;
+
+			while (chars.tileCount % tilesX)
+				tilesX >>= 1;
+
+			tilesY = chars.tileCount / tilesX;
+		}
+
+		if ((tilesX << 3) > 0xFFFF || (tilesY << 3) > 0xFFFF)
+			return false;
+
+		w = u16(tilesX << 3);
+		h = u16(tilesY << 3);
+		return true;
+	}
+
+	bool GraphicsHelper::toRGBA8Image(
+		const NCGR &ncgr, const NCLR &nclr, const NSCR *nscr, List<rgba8> &out, u16 &w, u16 &h, bool isEncrypted
+	) {
+
+		Characters chars;
+
+		if (!getCharacters(ncgr, chars, isEncrypted) || !getSize(ncgr, nscr, w, h))
+			return false;
+
+		List<bgr5> palette;
+		usz colors;
+
+		if (!getPalette(nclr, palette, colors))
+			return false;
+
+		out.assign(usz(w) * h, rgba8{});
+
+		if (!nscr) {
+
+			if (chars.isEncrypted) {
+
+				if (chars.is4Bit)
+					decrypt<true>(chars, out.data(), out.size(), palette.data(), palette.size());
+				else
+					decrypt<false>(chars, out.data(), out.size(), palette.data(), palette.size());
+
+				return true;
+			}
+
+			if (chars.isLinear) {
+
+				if (chars.is4Bit)
+					return R4_8::toRGBA8Image<true, false>(chars.data, out.data(), w, h, palette.data(), palette.size());
+
+				return R4_8::toRGBA8Image<false, false>(chars.data, out.data(), w, h, palette.data(), palette.size());
+			}
+
+			if (chars.is4Bit)
+				return R4_8::toRGBA8Image<true, true>(chars.data, out.data(), w, h, palette.data(), palette.size());
+
+			return R4_8::toRGBA8Image<false, true>(chars.data, out.data(), w, h, palette.data(), palette.size());
+		}
+
+		List<rgba8> lut(palette.size());
+		BGR5::toRGBA8Image(palette.data(), lut.data(), lut.size());
+
+		return forEachScreenTile(chars, *nscr, w, h, [&](usz i, usz tilesX, usz paletteOffset, const u8 *idx) {
+
+			rgba8 *dst = out.data() + (i / tilesX) * (usz(w) << 3) + ((i % tilesX) << 3);
+
+			for (usz y = 0; y < 8; ++y)
+				for (usz x = 0; x < 8; ++x)
+					if (const u8 pid = idx[(y << 3) | x])
+						dst[y * w + x] = lut[paletteOffset + pid];
+		});
+	}
+
+	bool GraphicsHelper::toIndexedImage(
+		const NCGR &ncgr, const NCLR &nclr, const NSCR *nscr,
+		List<r8> &out, List<bgr5> &palette, u16 &w, u16 &h, bool isEncrypted
+	) {
+
+		Characters chars;
+		usz colors;
+
+		if (!getCharacters(ncgr, chars, isEncrypted) || !getSize(ncgr, nscr, w, h) || !getPalette(nclr, palette, colors))
+			return false;
+
+		out.assign(usz(w) * h, 0);
+
+		if (!nscr) {
+
+			if (chars.isEncrypted) {
+
+				if (chars.is4Bit)
+					decrypt<true>(chars, out.data(), out.size(), palette.data(), palette.size());
+				else
+					decrypt<false>(chars, out.data(), out.size(), palette.data(), palette.size());
+			}
+
+			else if (chars.isLinear ?
+				(chars.is4Bit ?
+					!R4_8::toR8Image<true, false>(chars.data, out.data(), w, h) :
+					!R4_8::toR8Image<false, false>(chars.data, out.data(), w, h)
+				) :
+				(chars.is4Bit ?
+					!R4_8::toR8Image<true, true>(chars.data, out.data(), w, h) :
+					!R4_8::toR8Image<false, true>(chars.data, out.data(), w, h)
+				)
+			)
+				return false;
+
+			palette.resize(chars.is4Bit ? 16 : 256);
+			return true;
+		}
+
+		//Index 0 stays transparent for every palette, so it isn't offset
+
+		const bool success = forEachScreenTile(chars, *nscr, w, h, [&](usz i, usz tilesX, usz paletteOffset, const u8 *idx) {
+
+			r8 *dst = out.data() + (i / tilesX) * (usz(w) << 3) + ((i % tilesX) << 3);
+
+			for (usz y = 0; y < 8; ++y)
+				for (usz x = 0; x < 8; ++x)
+					if (const u8 pid = idx[(y << 3) | x])
+						dst[y * w + x] = u8(paletteOffset + pid);
+		});
+
+		if (!success)
+			return false;
+
+		//Only keep the palettes that can be reached, but never cut off colors of the NCLR that come before
+
+		const usz used = usz(*std::max_element(out.begin(), out.end())) + 1;
+		palette.resize(std::min(std::max(used, colors), usz(256)));
+		return true;
+	}
+
+	//A resource with a single section, followed by its data
+
+	template<typename Section>
+	inline void writeResource(Buffer &out, ResourceType type, Section section, const void *data, usz size) {
+
+		section.type = Section::getSectionType();
+		section.size = u32(sizeof(Section) + size);
+
+		const GenericHeader header{ type, 0x0100FEFF, u32(sizeof(GenericHeader) + section.size), u16(sizeof(GenericHeader)), 1 };
+
+		out.resize(header.size);
+		std::memcpy(out.data(), &header, sizeof(header));
+		std::memcpy(out.data() + sizeof(header), &section, sizeof(section));
+
+		if (size)
+			std::memcpy(out.data() + sizeof(header) + sizeof(section), data, size);
+	}
+
+	//4-bit indices of every tile (linear within the tile) and which of the 16 color palettes it uses
+
+	static void toTilesWithPalettes(
+		const bgr5 *colors, u16 w, u16 h, const List<bgr5> &palette,
+		List<u8> &tiles, List<u8> &banks
+	) {
+
+		const usz tilesX = w >> 3, count = tilesX * (h >> 3);
+
+		tiles.assign(count << 6, 0);
+		banks.assign(count, 0);
+
+		const usz bankCount = std::min((palette.size() + 15) >> 4, usz(16));
+
+		bgr5 opaque[64];
+		u8 nearest[64], bestNearest[64];
+		usz opaquePos[64];
+
+		for (usz t = 0; t < count; ++t) {
+
+			const bgr5 *src = colors + (t / tilesX) * (usz(w) << 3) + ((t % tilesX) << 3);
+			usz n = 0;
+
+			for (usz y = 0; y < 8; ++y)
+				for (usz x = 0; x < 8; ++x) {
+
+					const bgr5 c = src[y * w + x];
+
+					if (c != QuantizeHelper::transparent) {
+						opaquePos[n] = (y << 3) | x;
+						opaque[n++] = c;
+					}
+				}
+
+			if (!n)
+				continue;
+
+			//Pick the palette with the lowest error; every palette has a transparent color 0 of its own
+
+			u64 bestError = u64(-1);
+			usz best = 0;
+
+			for (usz b = 0; b < bankCount; ++b) {
+
+				const usz first = b << 4;
+				const usz colorCount = std::min(palette.size() - first, usz(16));
+
+				if (colorCount < 2)
+					continue;
+
+				BGR5::toNearest(opaque, nearest, n, palette.data() + first + 1, colorCount - 1);
+
+				u64 error = 0;
+
+				for (usz i = 0; i < n; ++i)
+					error += BGR5::distance(opaque[i], palette[first + 1 + nearest[i]]);
+
+				if (error < bestError) {
+					bestError = error;
+					best = b;
+					std::memcpy(bestNearest, nearest, n);
+				}
+			}
+
+			u8 *dst = tiles.data() + (t << 6);
+
+			for (usz i = 0; i < n; ++i)
+				dst[opaquePos[i]] = u8(bestNearest[i] + 1);
+
+			banks[t] = u8(best);
+		}
+	}
+
+	bool GraphicsHelper::fromRGBA8Image(const rgba8 *pixels, u16 w, u16 h, const GraphicsEncoding &encoding, EncodedGraphics &out) {
+
+		if (!w || !h || w % 8 || h % 8 || (encoding.isLinear && encoding.hasScreen))
+			return false;
+
+		const usz count = usz(w) * h;
+
+		if (!encoding.palette.empty())
+			out.palette.assign(encoding.palette.begin(), encoding.palette.begin() + std::min(encoding.palette.size(), usz(256)));
+
+		else QuantizeHelper::createPalette(pixels, count, encoding.is4Bit ? 16 : 256, out.palette, encoding.iterations);
+
+		List<bgr5> colors(count);
+		QuantizeHelper::toBGR5(pixels, count, colors.data());
+
+		//For big images with one palette, the colors are matched once per unique color instead of per tile
+
+		List<u8> tiles, banks;
+		List<r8> indices;
+		const bool hasBanks = encoding.is4Bit && encoding.hasScreen && out.palette.size() > 16;
+
+		if (hasBanks)
+			toTilesWithPalettes(colors.data(), w, h, out.palette, tiles, banks);
+
+		else {
+
+			indices.resize(count);
+			QuantizeHelper::remap(pixels, count, out.palette.data(), std::min(out.palette.size(), usz(encoding.is4Bit ? 16 : 256)), indices.data());
+
+			const usz tilesX = w >> 3, tileCount = tilesX * (h >> 3);
+
+			tiles.resize(tileCount << 6);
+			banks.assign(tileCount, 0);
+
+			for (usz t = 0; t < tileCount; ++t) {
+
+				const r8 *src = indices.data() + (t / tilesX) * (usz(w) << 3) + ((t % tilesX) << 3);
+
+				for (usz y = 0; y < 8; ++y)
+					std::memcpy(tiles.data() + (t << 6) + (y << 3), src + y * w, 8);
+			}
+		}
+
+		//Error of the final colors
+
+		out.error = 0;
+
+		for (usz t = 0, tilesX = w >> 3; t < banks.size(); ++t) {
+
+			const bgr5 *src = colors.data() + (t / tilesX) * (usz(w) << 3) + ((t % tilesX) << 3);
+			const u8 *idx = tiles.data() + (t << 6);
+
+			for (usz y = 0; y < 8; ++y)
+				for (usz x = 0; x < 8; ++x)
+					if (const u8 pid = idx[(y << 3) | x])
+						out.error += BGR5::distance(src[y * w + x], out.palette[(usz(banks[t]) << 4) + pid]);
+		}
+
+		//Identical tiles are only stored once; a tile can also be a flipped version of one that is already stored
+
+		List<u8> stored;
+		List<ScreenEntry> screen;
+
+		if (!encoding.hasScreen) {
+			stored = encoding.isLinear ? std::move(indices) : std::move(tiles);
+			out.tiles = banks.size();
+		}
+
+		else {
+
+			std::unordered_map<String, u16> known;
+			screen.resize(banks.size());
+
+			u8 flipped[4][64];
+
+			for (usz t = 0; t < banks.size(); ++t) {
+
+				const u8 *idx = tiles.data() + (t << 6);
+
+				for (usz f = 0; f < 4; ++f)
+					for (usz j = 0; j < 64; ++j)
+						flipped[f][j] = idx[j ^ (f & 2 ? 0x38 : 0) ^ (f & 1 ? 7 : 0)];
+
+				//Flip 1 is x, 2 is y and 3 is both, the same as the bits of the screen entry
+
+				usz flip = 0;
+				auto it = known.find(String((const c8*) flipped[0], 64));
+
+				while (it == known.end() && ++flip < 4)
+					it = known.find(String((const c8*) flipped[flip], 64));
+
+				if (it == known.end()) {
+
+					if (known.size() > 0x3FF)
+						return false;
+
+					it = known.emplace(String((const c8*) idx, 64), u16(known.size())).first;
+					stored.insert(stored.end(), idx, idx + 64);
+					flip = 0;
+				}
+
+				screen[t] = ScreenEntry(it->second | flip << 10 | usz(banks[t]) << 12);
+			}
+
+			out.tiles = known.size();
+		}
+
+		//Pack the tiles; the first pixel of a 4-bit pair is in the low nibble
+
+		if (encoding.is4Bit) {
+
+			for (usz i = 0; i < stored.size() >> 1; ++i)
+				stored[i] = u8(stored[i << 1] | stored[(i << 1) | 1] << 4);
+
+			stored.resize(stored.size() >> 1);
+		}
+
+		RAHC rahc{};
+		rahc.tileWidth = encoding.hasScreen ? 0xFFFF : u16(w >> 3);
+		rahc.tileHeight = encoding.hasScreen ? 0xFFFF : u16(h >> 3);
+		rahc.tileDepth = encoding.is4Bit ? 3 : 4;
+		rahc.isLinear = encoding.isLinear;
+		rahc.tileDataSize = u32(stored.size());
+		rahc.unknown3 = 0x18;
+
+		writeResource(out.ncgr, RESOURCE_NCGR, rahc, stored.data(), stored.size());
+
+		//Palettes are stored in full (16 colors per palette for 4-bit, 256 for 8-bit)
+
+		List<bgr5> palette = out.palette;
+		palette.resize(encoding.is4Bit ? (palette.size() + 15) & ~usz(15) : 256);
+
+		TTLP ttlp{};
+		ttlp.bitDepth = encoding.is4Bit ? 3 : 4;
+		ttlp.dataSize = u32(palette.size() * sizeof(bgr5));
+		ttlp.colors = 0x10;
+
+		writeResource(out.nclr, RESOURCE_NCLR, ttlp, palette.data(), ttlp.dataSize);
+
+		out.nscr.clear();
+
+		if (encoding.hasScreen) {
+
+			NRCS nrcs{};
+			nrcs.screenWidth = w;
+			nrcs.screenHeight = h;
+			nrcs.screenDataSize = u32(screen.size() * sizeof(ScreenEntry));
+
+			writeResource(out.nscr, RESOURCE_NCSR, nrcs, screen.data(), nrcs.screenDataSize);
+		}
+
+		return true;
+	}
+
+}
@@ -0,0 +1,91 @@
+#include "helper/hash.hpp"
+#include <cstring>
+
+namespace nre {
+
+	static constexpr u64
+		prime0 = 0x9E3779B185EBCA87,
+		prime1 = 0xC2B2AE3D27D4EB4F,
+		prime2 = 0x165667B19E3779F9,
+		prime3 = 0x85EBCA77C2B2AE63,
+		prime4 = 0x27D4EB2F165667C5;
+
+	static inline u64 rotl(u64 x, u32 r) {
+		return (x << r) | (x >> (64 - r));
+	}
+
+	//Unaligned little endian reads; files in a ROM don't have to be aligned to 8 bytes
+
+	static inline u64 read64(const u8 *ptr) {
+		u64 v;
+		std::memcpy(&v, ptr, 8);
+		return v;
+	}
+
+	static inline u32 read32(const u8 *ptr) {
+		u32 v;
+		std::memcpy(&v, ptr, 4);
+		return v;
+	}
+
+	static inline u64 round(u64 acc, u64 v) {
+		return rotl(acc + v * prime1, 31) * prime0;
+	}
+
+	static inline u64 merge(u64 acc, u64 v) {
+		return (acc ^ round(0, v)) * prime0 + prime3;
+	}
+
+	u64 HashHelper::xxh64(const void *data, usz size, u64 seed) {
+
+		const u8 *ptr = (const u8*) data, *end = ptr + size;
+		u64 h;
+
+		//4 independent lanes over 32 byte stripes
+
+		if (size >= 32) {
+
+			u64 v0 = seed + prime0 + prime1, v1 = seed + prime1, v2 = seed, v3 = seed - prime0;
+
+			for (const u8 *last = end - 32; ptr <= last; ptr += 32) {
+				v0 = round(v0, read64(ptr));
+				v1 = round(v1, read64(ptr + 8));
+				v2 = round(v2, read64(ptr + 16));
+				v3 = round(v3, read64(ptr + 24));
+			}
+
+			h = rotl(v0, 1) + rotl(v1, 7) + rotl(v2, 12) + rotl(v3, 18);
+			h = merge(h, v0);
+			h = merge(h, v1);
+			h = merge(h, v2);
+			h = merge(h, v3);
+		}
+
+		else h = seed + prime4;
+
+		h += u64(size);
+
+		//The remaining bytes
+
+		for (; ptr + 8 <= end; ptr += 8)
+			h = rotl(h ^ round(0, read64(ptr)), 27) * prime0 + prime3;
+
+		if (ptr + 4 <= end) {
+			h = rotl(h ^ (u64(read32(ptr)) * prime0), 23) * prime1 + prime2;
+			ptr += 4;
+		}
+
+		for (; ptr < end; ++ptr)
+			h = rotl(h ^ (*ptr * prime4), 11) * prime0;
+
+		//Avalanche
+
+		h ^= h >> 33;
+		h *= prime1;
+		h ^= h >> 29;
+		h *= prime2;
+		h ^= h >> 32;
+		return h;
+	}
+
+}
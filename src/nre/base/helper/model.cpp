@@ -0,0 +1,414 @@
+#include "helper/model.hpp"
+#include "helper/parallel.hpp"
+#include <cstring>
+#include <algorithm>
+
+namespace nre {
+
+	//Items of a dictionary, in order; data points to unitSize bytes
+
+	struct DictionaryItem {
+		String name;
+		const u8 *data;
+	};
+
+	static bool readDictionary(const u8 *section, usz size, usz offset, usz unitSize, List<DictionaryItem> &out) {
+
+		out.clear();
+
+		if (offset > size || size - offset < sizeof(Dictionary))
+			return false;
+
+		const Dictionary *dict = (const Dictionary*)(section + offset);
+		const usz dataOffset = offset + dict->treeSize;
+
+		if (dataOffset > size || size - dataOffset < sizeof(DictionaryData))
+			return false;
+
+		const DictionaryData *data = (const DictionaryData*)(section + dataOffset);
+		const usz items = dataOffset + sizeof(DictionaryData), names = dataOffset + data->size;
+
+		if (
+			data->unitSize < unitSize || data->size < sizeof(DictionaryData) + usz(data->unitSize) * dict->count ||
+			names > size || size - names < usz(dict->count) * 16
+		)
+			return false;
+
+		out.resize(dict->count);
+
+		for (usz i = 0; i < out.size(); ++i) {
+
+			const c8 *name = (const c8*)(section + names + i * 16);
+
+			out[i].name = String(name, strnlen(name, 16));
+			out[i].data = section + items + i * data->unitSize;
+		}
+
+		return true;
+	}
+
+	template<typename T>
+	static inline T read(const u8 *data) {
+		T t;
+		std::memcpy(&t, data, sizeof(t));
+		return t;
+	}
+
+	//Colors the palette of a format needs (0 = no palette)
+
+	static inline usz getPaletteColors(TextureFormat format) {
+		switch (format) {
+			case TEXTURE_A3I5:			return 32;
+			case TEXTURE_4_COLORS:		return 4;
+			case TEXTURE_16_COLORS:		return 16;
+			case TEXTURE_256_COLORS:	return 256;
+			case TEXTURE_4X4:			return 2;		//Every block uses 2 or 4 colors from its own offset
+			case TEXTURE_A5I3:			return 8;
+			default:					return 0;
+		}
+	}
+
+	bool ModelHelper::getTextures(const TEX0 *tex0, List<TextureEntry> &out) {
+
+		out.clear();
+
+		if (!tex0)
+			return false;
+
+		const u8 *section = (const u8*) tex0;
+		const usz size = tex0->size;
+
+		List<DictionaryItem> textures, palettes;
+
+		if (!readDictionary(section, size, tex0->textureDictOffset, sizeof(TextureParams), textures))
+			return false;
+
+		//Textures without a palette don't need a palette dictionary
+
+		if (tex0->paletteDictOffset && !readDictionary(section, size, tex0->paletteDictOffset, sizeof(u16), palettes))
+			palettes.clear();
+
+		out.resize(textures.size());
+
+		for (usz i = 0; i < textures.size(); ++i) {
+
+			const TextureParams params = read<TextureParams>(textures[i].data);
+			TextureEntry &tex = out[i];
+
+			tex.name = textures[i].name;
+			tex.format = TextureFormat((params >> 26) & 7);
+			tex.w = u16(8 << ((params >> 20) & 7));
+			tex.h = u16(8 << ((params >> 23) & 7));
+			tex.isColor0Transparent = (params >> 29) & 1;
+
+			const usz offset = usz(params & 0xFFFF) << 3;
+
+			if (tex.format == TEXTURE_4X4) {
+				tex.data = tex0->compressedDataOffset + offset;
+				tex.blockPalettes = tex0->compressedInfoOffset + offset / 2;
+			}
+
+			else {
+				tex.data = tex0->textureDataOffset + offset;
+				tex.blockPalettes = usz_MAX;
+			}
+
+			tex.paletteData = usz_MAX;
+
+			if (!getPaletteColors(tex.format) || palettes.empty())
+				continue;
+
+			const String suffixed = (tex.name + "_pl").substr(0, 16);
+			usz pick = usz_MAX;
+
+			for (usz j = 0; j < palettes.size() && pick == usz_MAX; ++j)
+				if (palettes[j].name == suffixed)
+					pick = j;
+
+			for (usz j = 0; j < palettes.size() && pick == usz_MAX; ++j)
+				if (palettes[j].name == tex.name)
+					pick = j;
+
+			if (pick == usz_MAX)
+				pick = palettes.size() == 1 ? 0 : (i < palettes.size() ? i : usz_MAX);
+
+			if (pick == usz_MAX)
+				continue;
+
+			tex.palette = palettes[pick].name;
+			tex.paletteData = tex0->paletteDataOffset + (usz(read<u16>(palettes[pick].data)) << 3);
+		}
+
+		return true;
+	}
+
+	bool ModelHelper::getModels(const MDL0 *mdl0, List<ModelSummary> &out) {
+
+		out.clear();
+
+		if (!mdl0)
+			return false;
+
+		const u8 *section = (const u8*) mdl0;
+		const usz size = mdl0->size;
+
+		List<DictionaryItem> models;
+
+		if (!readDictionary(section, size, sizeof(MDL0), sizeof(u32), models))
+			return false;
+
+		out.reserve(models.size());
+
+		for (const DictionaryItem &model : models) {
+
+			const usz offset = read<u32>(model.data);
+
+			if (offset > size || size - offset < sizeof(ModelHeader))
+				continue;
+
+			const ModelHeader head = read<ModelHeader>(section + offset);
+
+			out.push_back(ModelSummary{
+				model.name,
+				head.vertices, head.polygons, head.triangles, head.quads,
+				head.nodes, head.materials, head.shapes
+			});
+		}
+
+		return true;
+	}
+
+	usz ModelHelper::getTextureSize(const TextureEntry &texture) {
+
+		const usz pixels = usz(texture.w) * texture.h;
+
+		switch (texture.format) {
+			case TEXTURE_4_COLORS:		return pixels / 4;
+			case TEXTURE_16_COLORS:		return pixels / 2;
+			case TEXTURE_4X4:			return pixels / 4 + pixels / 8;
+			case TEXTURE_DIRECT:		return pixels * 2;
+			case TEXTURE_NONE:			return 0;
+			default:					return pixels;
+		}
+	}
+
+	const c8 *ModelHelper::getFormatName(TextureFormat format) {
+
+		static constexpr const c8 *names[] = {
+			"None", "A3I5", "4 colors", "16 colors", "256 colors", "4x4", "A5I3", "Direct"
+		};
+
+		return names[format & 7];
+	}
+
+	//The components of a bgr5 spread over a u32 with 5 bits of room between them (0-4, 10-14, 20-24),
+	//so the colors of a 4x4 block are mixed for all components at once
+
+	static inline u32 spread(bgr5 c) {
+		return (c & 0x1F) | (u32(c & 0x3E0) << 5) | (u32(c & 0x7C00) << 10);
+	}
+
+	static inline bgr5 pack(u32 v) {
+		return bgr5((v & 0x1F) | ((v >> 5) & 0x3E0) | ((v >> 10) & 0x7C00));
+	}
+
+	//(a * wa + b * wb) / 8, rounded down per component
+	static inline bgr5 mix(bgr5 a, bgr5 b, u32 wa, u32 wb) {
+		return pack(((spread(a) * wa + spread(b) * wb) >> 3) & 0x1F07C1F);
+	}
+
+	void ModelHelper::decode4x4Block(u32 texels, u16 info, const bgr5 *palette, rgba8 *out, usz stride) {
+
+		const u16 mode = info >> 14;
+
+		bgr5 colors[4]{ palette[0], palette[1] };
+
+		switch (mode) {
+
+			case 0:
+				colors[2] = palette[2];
+				break;
+
+			case 1:
+				colors[2] = mix(colors[0], colors[1], 4, 4);
+				break;
+
+			case 2:
+				colors[2] = palette[2];
+				colors[3] = palette[3];
+				break;
+
+			default:
+				colors[2] = mix(colors[0], colors[1], 5, 3);
+				colors[3] = mix(colors[0], colors[1], 3, 5);
+		}
+
+		rgba8 rgba[4];
+
+		for (usz i = 0; i < 4; ++i)
+			BGR5::toRGBA8(colors[i], rgba + i);
+
+		//Modes 0 and 1 only have 3 colors; the last one is transparent
+
+		if (mode < 2)
+			rgba[3].v = 0;
+
+		//2 bits per pixel, the first pixel of every row in the lowest bits
+
+		for (usz y = 0; y < 4; ++y, texels >>= 8, out += stride)
+			for (usz x = 0; x < 4; ++x)
+				out[x] = rgba[(texels >> (x * 2)) & 3];
+	}
+
+	//Formats of 8 bits per pixel; every byte value maps to one color (with the alpha of the index)
+
+	template<TextureFormat format>
+	static inline void decode8Bit(const u8 *data, rgba8 *out, usz pixels, const rgba8 *palette, bool isColor0Transparent) {
+
+		rgba8 table[256];
+
+		for (usz i = 0; i < 256; ++i) {
+
+			rgba8 &c = table[i];
+
+			if constexpr (format == TEXTURE_256_COLORS) {
+				c = palette[i];
+				if (!i && isColor0Transparent) c.v = 0;
+			}
+
+			else if constexpr (format == TEXTURE_A3I5) {
+				c = palette[i & 0x1F];
+				c.a = u8((i >> 5) * 0xFF / 7);
+				if (!c.a) c.v = 0;
+			}
+
+			else {
+				c = palette[i & 7];
+				c.a = BGR5::to8Bit(u8(i >> 3));
+				if (!c.a) c.v = 0;
+			}
+		}
+
+		for (usz i = 0; i < pixels; ++i)
+			out[i] = table[data[i]];
+	}
+
+	template<usz bits>
+	static inline void decodeIndexed(const u8 *data, rgba8 *out, usz pixels, rgba8 *palette, bool isColor0Transparent) {
+
+		constexpr usz perByte = 8 / bits, mask = (1 << bits) - 1;
+
+		if (isColor0Transparent)
+			palette[0].v = 0;
+
+		for (usz i = 0; i < pixels; i += perByte) {
+
+			u8 v = data[i / perByte];
+
+			for (usz j = 0; j < perByte; ++j, v >>= bits)
+				out[i + j] = palette[v & mask];
+		}
+	}
+
+	bool ModelHelper::toRGBA8Image(const TEX0 *tex0, const TextureEntry &tex, List<rgba8> &out) {
+
+		if (!tex0 || tex.format == TEXTURE_NONE)
+			return false;
+
+		const u8 *section = (const u8*) tex0;
+		const usz size = tex0->size, pixels = usz(tex.w) * tex.h;
+		const usz texels = tex.format == TEXTURE_4X4 ? pixels / 4 : getTextureSize(tex);
+
+		if (tex.data > size || size - tex.data < texels)
+			return false;
+
+		const u8 *data = section + tex.data;
+
+		//Palette in rgba8; 4x4 textures read their colors per block
+		//Palettes at the end of the data can be shorter than the format allows, the missing colors are black
+
+		const usz colors = getPaletteColors(tex.format);
+		rgba8 palette[256]{};
+
+		if (colors) {
+
+			if (tex.paletteData > size || size - tex.paletteData < 2)
+				return false;
+
+			if (tex.format != TEXTURE_4X4)
+				BGR5::toRGBA8Image(
+					(const bgr5*)(section + tex.paletteData), palette, std::min(colors, (size - tex.paletteData) / 2)
+				);
+		}
+
+		out.assign(pixels, rgba8{});
+
+		switch (tex.format) {
+
+			case TEXTURE_A3I5:			decode8Bit<TEXTURE_A3I5>(data, out.data(), pixels, palette, false);						break;
+			case TEXTURE_A5I3:			decode8Bit<TEXTURE_A5I3>(data, out.data(), pixels, palette, false);						break;
+			case TEXTURE_256_COLORS:	decode8Bit<TEXTURE_256_COLORS>(data, out.data(), pixels, palette, tex.isColor0Transparent);	break;
+			case TEXTURE_4_COLORS:		decodeIndexed<2>(data, out.data(), pixels, palette, tex.isColor0Transparent);			break;
+			case TEXTURE_16_COLORS:		decodeIndexed<4>(data, out.data(), pixels, palette, tex.isColor0Transparent);			break;
+
+			case TEXTURE_DIRECT: {
+
+				const bgr5 *direct = (const bgr5*) data;
+				BGR5::toRGBA8Image(direct, out.data(), pixels);
+
+				for (usz i = 0; i < pixels; ++i)
+					if (!(direct[i] >> 15))
+						out[i].v = 0;
+
+				break;
+			}
+
+			default: {
+
+				const usz blocks = pixels / 16;
+
+				if (tex.blockPalettes > size || (size - tex.blockPalettes) / 2 < blocks)
+					return false;
+
+				const u8 *infos = section + tex.blockPalettes;
+				const usz blocksX = tex.w / 4;
+
+				for (usz i = 0; i < blocks; ++i) {
+
+					const u16 info = read<u16>(infos + i * 2);
+					const usz offset = tex.paletteData + usz(info & 0x3FFF) * 4, mode = info >> 14;
+					const usz blockColors = mode & 1 ? 2 : (mode ? 4 : 3);
+
+					if (offset > size || (size - offset) / 2 < blockColors)
+						return false;
+
+					const usz x = (i % blocksX) * 4, y = (i / blocksX) * 4;
+
+					decode4x4Block(
+						read<u32>(data + i * 4), info, (const bgr5*)(section + offset),
+						out.data() + x + y * tex.w, tex.w
+					);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	usz ModelHelper::toRGBA8Images(const TEX0 *tex0, const List<TextureEntry> &textures, List<List<rgba8>> &out, usz threads) {
+
+		out.assign(textures.size(), {});
+
+		std::atomic<usz> decoded{};
+
+		Parallel::forEach(textures.size(), threads, [&](usz i) {
+			if (toRGBA8Image(tex0, textures[i], out[i]))
+				++decoded;
+			else
+				out[i].clear();
+		});
+
+		return decoded;
+	}
+
+}
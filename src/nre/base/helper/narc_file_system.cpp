@@ -0,0 +1,62 @@
+#include "helper/narc_file_system.hpp"
+
+namespace nre {
+
+	bool NARCFileSystem::isArchive(const void *data, usz size) {
+		return size >= sizeof(GenericHeader) && ((const GenericHeader*) data)->type == RESOURCE_NARC;
+	}
+
+	NARCFileSystem::NARCFileSystem(u8 *data, usz size) : NDSFileSystem(nullptr) {
+
+		NARC narc;
+
+		if (!narc.parse(data, size))
+			throw std::runtime_error("Data isn't a NARC");
+
+		const BTAF *btaf = narc.get<BTAF>();
+		const BTNF *btnf = narc.get<BTNF>();
+		const GMIF *gmif = narc.get<GMIF>();
+
+		if (!btnf || !gmif)
+			throw std::runtime_error("NARC doesn't have a file name table or file data");
+
+		if (btaf->fileCount > getSectionDataCount(btaf) / 2)
+			throw std::runtime_error("NARC file allocation table is bigger than its section");
+
+		u8 *fnt = (u8*) getSectionData(btnf);
+		usz fntSize = btnf->size - sizeof(BTNF);
+
+		u8 *gmifData = (u8*) getSectionData(gmif);
+		const usz gmifSize = gmif->size - sizeof(GMIF);
+
+		//Archives without names only have a root folder that doesn't have any entries
+
+		const FNTFolder *root = (const FNTFolder*) fnt;
+
+		const bool isNameless =
+			fntSize <= sizeof(FNTFolder) ||
+			(root->relation == 1 && btaf->fileCount && !fnt[sizeof(FNTFolder)]);
+
+		if (isNameless) {
+
+			names.reserve(sizeof(FNTFolder) + usz(btaf->fileCount) * 10 + 1);
+
+			const FNTFolder generated{ sizeof(FNTFolder), 0, 1 };
+			names.insert(names.end(), (const u8*) &generated, (const u8*) (&generated + 1));
+
+			for (u16 i = 0; i < btaf->fileCount; ++i) {
+				const String name = std::to_string(i) + ".bin";
+				names.push_back(u8(name.size()));
+				names.insert(names.end(), name.begin(), name.end());
+			}
+
+			names.push_back(0);
+
+			fnt = names.data();
+			fntSize = names.size();
+		}
+
+		parse(fnt, fntSize, getSectionData(btaf), btaf->fileCount, gmifData, gmifSize);
+	}
+
+}
@@ -0,0 +1,119 @@
+#include "helper/nds_file_index.hpp"
+
+using namespace oic;
+
+namespace nre {
+
+	NDSFileIndex::NDSFileIndex(const List<FileInfo> &files, List<std::string_view> _names):
+		names(std::move(_names)), parents(files.size()), children(files.size()), hashes(files.size())
+	{
+		//Keep the table at most half full, so probe sequences stay short
+
+		usz capacity = 16;
+
+		while (capacity < files.size() * 2)
+			capacity <<= 1;
+
+		table = List<FileHandle>(capacity);
+		mask = capacity - 1;
+
+		//Parents are always placed before their children, so their hash is already known
+
+		for (usz i = 0; i < files.size(); ++i) {
+
+			const FileInfo &f = files[i];
+
+			if (f.isFolder())
+				children[i] = Children{ f.folderHint, f.fileHint, f.end };
+
+			if (!i) {
+				hashes[i] = rootHash;
+				continue;
+			}
+
+			parents[i] = f.parent;
+			hashes[i] = childHash(hashes[f.parent], !f.parent, names[i]);
+
+			usz slot = usz(hashes[i]) & mask;
+
+			while (table[slot])
+				slot = (slot + 1) & mask;
+
+			table[slot] = FileHandle(i + 1);
+		}
+	}
+
+	//Walk up from the file and compare the names with the end of the path
+
+	bool NDSFileIndex::matches(FileHandle handle, std::string_view path) const {
+
+		for (; handle; handle = parents[handle]) {
+
+			const std::string_view name = names[handle];
+
+			if (path.size() < name.size() || path.substr(path.size() - name.size()) != name)
+				return false;
+
+			path.remove_suffix(name.size());
+
+			if (parents[handle]) {
+
+				if (path.empty() || path.back() != '/')
+					return false;
+
+				path.remove_suffix(1);
+			}
+		}
+
+		return path.empty();
+	}
+
+	FileHandle NDSFileIndex::find(std::string_view path) const {
+
+		if (names.empty())
+			return notFound;
+
+		if (!path.empty() && path[0] == '~')
+			path.remove_prefix(1);
+
+		if (!path.empty() && path[0] == '/')
+			path.remove_prefix(1);
+
+		if (!path.empty() && path.back() == '/')
+			path.remove_suffix(1);
+
+		if (path.empty())
+			return 0;
+
+		const u64 h = hash(rootHash, path);
+
+		for (usz slot = usz(h) & mask; table[slot]; slot = (slot + 1) & mask) {
+
+			const FileHandle handle = table[slot] - 1;
+
+			if (hashes[handle] == h && matches(handle, path))
+				return handle;
+		}
+
+		return notFound;
+	}
+
+	FileHandle NDSFileIndex::findChild(FileHandle folder, std::string_view name) const {
+
+		if (folder >= names.size())
+			return notFound;
+
+		const u64 h = childHash(hashes[folder], !folder, name);
+
+		for (usz slot = usz(h) & mask; table[slot]; slot = (slot + 1) & mask) {
+
+			const FileHandle handle = table[slot] - 1;
+
+			if (hashes[handle] == h && parents[handle] == folder && names[handle] == name)
+				return handle;
+		}
+
+		return notFound;
+	}
+
+}
@@ -1,4 +1,6 @@
 #include "helper/nds_file_system.hpp"
+#include "helper/compression.hpp"
+#include <cstdio>
 
 using namespace oic;
 
@@ -70,7 +72,7 @@ namespace nre {
 		return new NDSFile(this, f);
 	}
 
-	NDSFileSystem::NDSFileSystem(NDS *nds) : FileSystem(FileAccess::READ_WRITE) {
+	NDSFileSystem::NDSFileSystem(NDS *nds) : FileSystem(FileAccess::READ_WRITE), nds(nds) {
 
 		if (!nds)
 			return;		//We don't have files
@@ -79,15 +81,161 @@ namespace nre {
 			throw std::runtime_error("NDS file doesn't include a file system");
 
 		u8 *ptr = (u8*)nds;
-		FNTFolder *root = (FNTFolder*)(ptr + nds->fntOffset);
+		parse(ptr + nds->fntOffset, nds->fntSize, (const u32*)(ptr + nds->fatOffset), nds->fatSize / 8, ptr, nds->romSize);
 
-		//Check if it has a parent (root node doesn't)
-		if (root->relation & 0xF000)		//TODO: Do folders start at 0xF000 or do they just set the upper nibble to 0xF?
+		parseOverlays(nds->arm9OverlayOffset, nds->arm9OverlaySize, false);
+		parseOverlays(nds->arm7OverlayOffset, nds->arm7OverlaySize, true);
+
+		decompressed = std::make_unique<Decompressed[]>(overlays.size() + 1);
+	}
+
+	void NDSFileSystem::parseOverlays(u32 offset, u32 size, bool isArm7) {
+
+		//NDS::invalid already checked if the table and FAT fit in the ROM
+
+		u8 *ptr = (u8*)nds;
+		const OVTEntry *entries = (const OVTEntry*)(ptr + offset);
+		const u32 *fat = (const u32*)(ptr + nds->fatOffset);
+		const u32 fatCount = nds->fatSize / 8;
+
+		const c8 *folder = isArm7 ? "overlay7" : "overlay9";
+
+		for (usz i = 0, j = size / sizeof(OVTEntry); i < j; ++i) {
+
+			const OVTEntry &entry = entries[i];
+
+			if (entry.fileId >= fatCount)
+				throw std::runtime_error("Overlay refers to a file that isn't in the file allocation table");
+
+			const u32 *siz = fat + (usz(entry.fileId) << 1);
+
+			if (siz[1] < siz[0] || siz[1] > nds->romSize)
+				throw std::runtime_error("File allocation table points outside of the data");
+
+			c8 name[32];
+			std::snprintf(name, sizeof(name), "%s_%04u.bin", folder, entry.id);
+
+			overlays.push_back(Overlay{
+				&entry, isArm7,
+				FileInfo{
+					String("~/") + folder + "/" + name, name,
+					0,
+					ptr + siz[0],
+					siz[1] - siz[0],
+					0,
+					0, 0, 0,
+					FileFlags::VIRTUAL_FILE_WRITE
+				}
+			});
+		}
+	}
+
+	bool NDSFileSystem::getOverlayData(usz i, const u8 *&data, usz &size) const {
+
+		if (i >= overlays.size())
+			return false;
+
+		const Overlay &overlay = overlays[i];
+
+		data = (const u8*) overlay.file.dataExt;
+		size = usz(overlay.file.fileSize);
+
+		if (!overlay.entry->isCompressed())
+			return true;
+
+		//The file can be padded, so the compressed size from the table is used if there is one
+
+		Decompressed &res = decompressed[i];
+
+		std::call_once(res.once, [&]() {
+			const usz compressed = overlay.entry->getCompressedSize();
+			res.isValid = CompressionHelper::decompressBLZ(data, compressed && compressed < size ? compressed : size, res.data);
+
+			if (!res.isValid)
+				res.data.clear();
+		});
+
+		data = res.data.data();
+		size = res.data.size();
+		return res.isValid;
+	}
+
+	bool NDSFileSystem::getArm9Data(const u8 *&data, usz &size) const {
+
+		if (!nds)
+			return false;
+
+		const u8 *arm9 = (const u8*)nds + nds->arm9Offset;
+		const usz arm9Size = nds->arm9Size;
+
+		Decompressed &res = decompressed[overlays.size()];
+
+		//Only the part up to compressedStaticEnd is compressed; the params are before it, so they can be found in the original.
+		//The decompressed copy has compressedStaticEnd cleared, like it is after the boot code decompressed it.
+
+		std::call_once(res.once, [&]() {
+
+			const u8 *footer = usz(nds->arm9Offset) + arm9Size + 12 <= nds->romSize ? arm9 + arm9Size : nullptr;
+			const usz offset = ModuleParams::find(arm9, arm9Size, footer);
+
+			ModuleParams params{};
+
+			if (offset != usz_MAX)
+				std::memcpy(&params, arm9 + offset, sizeof(params));
+
+			if (!params.compressedStaticEnd) {
+				res.isValid = true;
+				return;
+			}
+
+			const usz end = usz(params.compressedStaticEnd) - nds->arm9Load;
+
+			if (params.compressedStaticEnd < nds->arm9Load || end > arm9Size || !CompressionHelper::decompressBLZ(arm9, end, res.data)) {
+				res.data.clear();
+				return;
+			}
+
+			res.data.insert(res.data.end(), arm9 + end, arm9 + arm9Size);
+
+			params.compressedStaticEnd = 0;
+			std::memcpy(res.data.data() + offset, &params, sizeof(params));
+
+			res.isValid = true;
+		});
+
+		if (res.data.empty()) {
+			data = arm9;
+			size = arm9Size;
+		}
+
+		else {
+			data = res.data.data();
+			size = res.data.size();
+		}
+
+		return res.isValid;
+	}
+
+	void NDSFileSystem::parse(u8 *fnt, usz fntSize, const u32 *fat, u32 fatCount, u8 *data, usz dataSize) {
+
+		FNTFolder *root = (FNTFolder*)fnt;
+		const u8 *fntEnd = fnt + fntSize;
+
+		if (fntSize < sizeof(FNTFolder))
+			throw std::runtime_error("File name table is too small");
+
+		//The root node stores the folder count instead of a parent; folder ids are 0xF000-0xFFFF, so there are at most 4096
+
+		const u16 folderCount = root->relation;
+
+		if (!folderCount || folderCount > 0x1000)
 			throw std::runtime_error("Root folder not found in NDS file system");
 
+		if (usz(folderCount) * sizeof(FNTFolder) > fntSize)
+			throw std::runtime_error("Folder table doesn't fit in the file name table");
+
 		//Get all files 
 
-		u16 folderCount = root->relation;
 		List<FNTFile> nfiles(folderCount);
 
 		//Init root node
@@ -97,79 +245,111 @@ namespace nre {
 			0, 0,
 			0, 0,
 			0,
-			0, true
+			0, true,
+			0
 		};
 
 		//Folders
 
-		for (u16 i = 1; i < folderCount; ++i)
-			nfiles[i] = {
-			nullptr,
-			0, 0,
-			0, 0,
-			FileHandle(root[i].relation - 0xF000),
-			0, true
-		};
+		for (u16 i = 1; i < folderCount; ++i) {
 
-		//TODO: Overlays, located at i < rootFolders; i * 8
+			if (root[i].relation < 0xF000 || u16(root[i].relation - 0xF000) >= folderCount)
+				throw std::runtime_error("Folder refers to a parent that doesn't exist");
+
+			nfiles[i] = {
+				nullptr,
+				0, 0,
+				0, 0,
+				u16(root[i].relation - 0xF000),
+				0, true,
+				i
+			};
+		}
 
 		//Get names of folders and get files
+		//Every folder has its own entries, which are found through its offset rather than assumed to follow the previous folder.
+		//The files of a folder have consecutive ids, starting at its firstFilePosition; that's a u16,
+		//so the ids can't go past 0xFFFF (an empty folder at the end can store 0x10000 as 0, but it doesn't have files to use it)
+
+		firstFileId = root->firstFilePosition;
 
-		u8 *nameDat = (u8*)(root + folderCount);
-		u32 *fat = (u32*)(ptr + nds->fatOffset);
-		u16 firstFilePos = root->firstFilePosition;
+		for (u16 j = 0; j < folderCount; ++j) {
 
-		u16 i = 1;
+			if (root[j].offset >= fntSize)
+				throw std::runtime_error("Folder points outside of the file name table");
 
-		for (u16 j = 0, l = firstFilePos; ; ++i) {
+			u8 *nameDat = fnt + root[j].offset;
+			u32 l = root[j].firstFilePosition;
 
-			u8 spec = *nameDat;
-			++nameDat;
+			while (true) {
 
-			if (!spec) {
+				if (nameDat >= fntEnd)
+					throw std::runtime_error("File names go outside of the file name table");
 
-				spec = *nameDat;
+				const u8 spec = *nameDat;
 				++nameDat;
-				++j;
 
-				if (j == folderCount)
+				if (!spec)
 					break;
-			}
 
-			const u8 nameLen = spec & 0x7F;
-			const c8 *const name = (const c8*)nameDat;
-			nameDat += nameLen;
+				const u8 nameLen = spec & 0x7F;
+				const c8 *const name = (const c8*)nameDat;
+				nameDat += nameLen;
 
-			if (spec & 0x80) {
+				if (nameDat + (spec & 0x80 ? 2 : 0) > fntEnd)
+					throw std::runtime_error("File names go outside of the file name table");
 
-				FNTFile &nf = nfiles[*(u16*)nameDat - 0xF000];
-				nf.name = name;
-				nf.nameLen = nameLen;
-				nameDat += 2;
+				if (spec & 0x80) {
 
-				++nfiles[nf.parent].folders;
+					const u16 folder = u16(*(u16*)nameDat - 0xF000);
 
-			} else {
+					if (folder >= folderCount || !folder)
+						throw std::runtime_error("Folder entry refers to a folder that doesn't exist");
 
-				u32 *siz = fat + (l++ << 1);
-				++nfiles[j].files;
+					FNTFile &nf = nfiles[folder];
+					nf.name = name;
+					nf.nameLen = nameLen;
+					nameDat += 2;
 
-				FNTFile nf {
-					name,
-					siz[0], siz[1] - siz[0],
-					0, 0,
-					j,
-					nameLen, false
-				};
+					++nfiles[nf.parent].folders;
+
+				} else {
 
-				nfiles.push_back(nf);
+					if (l > 0xFFFF || l >= fatCount)
+						throw std::runtime_error("File entry refers to a file that isn't in the file allocation table");
+
+					const u16 id = u16(l++);
+					const u32 *siz = fat + (usz(id) << 1);
+
+					if (siz[1] < siz[0] || siz[1] > dataSize)
+						throw std::runtime_error("File allocation table points outside of the data");
+
+					++nfiles[j].files;
+
+					FNTFile nf {
+						name,
+						siz[0], siz[1] - siz[0],
+						0, 0,
+						j,
+						nameLen, false,
+						id
+					};
+
+					nfiles.push_back(nf);
+				}
 			}
 		}
 
 		//Convert to independent FileSystem and change the order of files
+		//There can be more than 65536 files and folders combined, so handles aren't u16
+
+		const usz count = nfiles.size();
 
-		List<FileInfo> &fs = virtualFiles = List<FileInfo>(i);
-		List<u16> mappings(i);
+		List<FileInfo> &fs = virtualFiles = List<FileInfo>(count);
+		List<FileHandle> mappings(count);
+		ids = List<u16>(count);
+
+		List<std::string_view> names(count);
 
 		u32 nextFile{};
 
@@ -185,24 +365,32 @@ namespace nre {
 
 		mappings[0] = 0;
 
-		struct FolderFileCounter { u16 folders{}, files{}; };
+		struct FolderFileCounter { u32 folders{}, files{}; };
 		List<FolderFileCounter> folders(folderCount);
 
-		for (u16 j = 1; j < i; ++j) {
+		for (usz j = 1; j < count; ++j) {
 
 			FNTFile &nf = nfiles[j];
+
+			//Children are placed in the range of their parent, so that has to be placed first
+
+			if (nf.isFolder && nf.parent >= j)
+				throw std::runtime_error("Folder comes before its parent in the file name table");
+
 			String name = String(nf.name, nf.name + nf.nameLen);
 
-			u16 parentId = mappings[nf.parent];
+			const FileHandle parentId = mappings[nf.parent];
 			const FileInfo &parent = fs[parentId];
 
-			u16 placeId = u16(
+			const FileHandle placeId = FileHandle(
 				nf.isFolder
 				? parent.folderHint + folders[nf.parent].folders++
 				: parent.fileHint + folders[nf.parent].files++
 			);
 
 			mappings[j] = placeId;
+			ids[placeId] = nf.id;
+			names[placeId] = std::string_view(nf.name, nf.nameLen);
 
 			if (nf.isFolder)
 				fs[placeId] = FileInfo {
@@ -218,7 +406,7 @@ namespace nre {
 				fs[placeId] = FileInfo{
 					parent.path + "/" + name, name,
 					0,
-					ptr + nf.beg,
+					data + nf.beg,
 					nf.size,
 					parentId,
 					0, 0, 0,
@@ -227,6 +415,8 @@ namespace nre {
 		}
 
 		initLut();
+
+		index = NDSFileIndex(virtualFiles, std::move(names));
 	}
 
 }
\ No newline at end of file
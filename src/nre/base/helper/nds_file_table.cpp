@@ -0,0 +1,160 @@
+#include "helper/nds_file_table.hpp"
+
+namespace nre {
+
+	NDSFileTable::NDSFileTable(const NDS *nds) {
+
+		if (!nds || !nds->fntSize)
+			throw std::runtime_error("NDS file doesn't include a file system");
+
+		if (nds->fntSize < sizeof(FNTFolder))
+			throw std::runtime_error("NDS file name table is too small");
+
+		rom = (const u8*) nds;
+		folders = (const FNTFolder*)(rom + nds->fntOffset);
+		fat = (const u32*)(rom + nds->fatOffset);
+
+		fntSize = nds->fntSize;
+		romSize = nds->romSize;
+		fileCount = nds->fatSize / 8;
+
+		//Root node stores the folder count instead of a parent; folder ids are 0xF000-0xFFFF, so there are at most 4096
+
+		folderCount = folders->relation;
+
+		if (!folderCount || folderCount > 0x1000)
+			throw std::runtime_error("Root folder not found in NDS file system");
+
+		if (usz(folderCount) * sizeof(FNTFolder) > fntSize)
+			throw std::runtime_error("NDS folder table doesn't fit in the file name table");
+
+		//Parents have to come first, like NDSFileSystem expects, so paths can be built in the order of the folder ids
+
+		for (u16 i = 1; i < folderCount; ++i)
+			if (folders[i].relation < 0xF000 || u16(folders[i].relation - 0xF000) >= i)
+				throw std::runtime_error("NDS folder refers to a parent that doesn't exist or comes after it");
+
+		entries.resize(folderCount);
+		decoded.resize(folderCount);
+	}
+
+	void NDSFileTable::decode(u16 folder) const {
+
+		const FNTFolder &f = folders[folder];
+		const u8 *fnt = (const u8*) folders;
+
+		if (f.offset >= fntSize)
+			throw std::runtime_error("NDS folder points outside of the file name table");
+
+		//Count the entries first, so the folder only needs one allocation
+
+		const u8 *beg = fnt + f.offset, *end = fnt + fntSize;
+		usz count{};
+
+		for (const u8 *it = beg; it < end && *it; ++count)
+			it += 1 + (*it & 0x7F) + (*it & 0x80 ? 2 : 0);
+
+		List<Entry> &res = entries[folder];
+		res.reserve(count);
+
+		u32 fileId = f.firstFilePosition;
+
+		for (const u8 *it = beg; it < end && *it; ) {
+
+			const u8 spec = *it;
+			const u8 nameLen = spec & 0x7F;
+			const bool isFolder = spec & 0x80;
+
+			if (it + 1 + nameLen + (isFolder ? 2 : 0) > end)
+				throw std::runtime_error("NDS folder entry goes outside of the file name table");
+
+			const std::string_view name((const c8*)(it + 1), nameLen);
+			it += 1 + nameLen;
+
+			if (isFolder) {
+
+				const u16 id = u16(it[0] | (it[1] << 8));
+				it += 2;
+
+				if (id < 0xF000 || u16(id - 0xF000) >= folderCount)
+					throw std::runtime_error("NDS folder entry refers to an invalid folder");
+
+				res.push_back(Entry{ name, u16(id - 0xF000), true });
+
+			} else {
+
+				if (fileId > 0xFFFF)
+					throw std::runtime_error("NDS folder has files past the 65536 the file allocation table can have");
+
+				res.push_back(Entry{ name, u16(fileId++), false });
+			}
+		}
+
+		decoded[folder] = true;
+	}
+
+	const List<NDSFileTable::Entry> &NDSFileTable::getEntries(u16 folder) const {
+
+		if (folder >= folderCount)
+			throw std::runtime_error("Folder doesn't exist");
+
+		if (!decoded[folder])
+			decode(folder);
+
+		return entries[folder];
+	}
+
+	bool NDSFileTable::find(std::string_view path, Entry &entry) const {
+
+		if (!path.empty() && path[0] == '~')
+			path.remove_prefix(1);
+
+		entry = Entry{ {}, 0, true };
+
+		while (!path.empty()) {
+
+			if (path[0] == '/') {
+				path.remove_prefix(1);
+				continue;
+			}
+
+			if (!entry.isFolder)
+				return false;
+
+			const usz next = path.find('/');
+			const std::string_view name = path.substr(0, next);
+
+			path.remove_prefix(next == std::string_view::npos ? path.size() : next);
+
+			bool found{};
+
+			for (const Entry &e : getEntries(entry.id))
+				if (e.name == name) {
+					entry = e;
+					found = true;
+					break;
+				}
+
+			if (!found)
+				return false;
+		}
+
+		return true;
+	}
+
+	bool NDSFileTable::getFile(u16 fileId, const u8 *&data, u32 &size) const {
+
+		if (fileId >= fileCount)
+			return false;
+
+		const u32 beg = fat[fileId << 1], end = fat[(fileId << 1) + 1];
+
+		if (end < beg || end > romSize)
+			return false;
+
+		data = rom + beg;
+		size = end - beg;
+		return true;
+	}
+
+}
@@ -0,0 +1,573 @@
+#include "helper/nds_repacker.hpp"
+#include "helper/checksum.hpp"
+#include <algorithm>
+#include <numeric>
+#include <cstdio>
+#include <cstddef>
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#ifdef __linux__
+	#include <sys/sendfile.h>
+#endif
+
+using namespace oic;
+
+namespace nre {
+
+	//Writes the ROM sequentially and copies unchanged data from the source ROM
+
+	class ROMWriter {
+
+	public:
+
+		ROMWriter(const String &path, const ROMMapping &rom): rom(rom) {
+
+		#ifdef _WIN32
+			file = std::fopen(path.c_str(), "wb");
+			if (file) std::setvbuf(file, nullptr, _IONBF, 0);
+		#else
+			fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		#endif
+		}
+
+		~ROMWriter() {
+
+		#ifdef _WIN32
+			if (file) std::fclose(file);
+		#else
+			if (fd >= 0) close(fd);
+		#endif
+		}
+
+		inline bool isOpen() const {
+
+		#ifdef _WIN32
+			return file;
+		#else
+			return fd >= 0;
+		#endif
+		}
+
+		bool write(const void *data, usz size) {
+
+			offset += size;
+
+		#ifdef _WIN32
+			return !size || std::fwrite(data, 1, size, file) == size;
+		#else
+
+			const u8 *ptr = (const u8*) data;
+
+			while (size) {
+
+				const ssize_t written = ::write(fd, ptr, size);
+
+				if (written <= 0)
+					return false;
+
+				ptr += written;
+				size -= usz(written);
+			}
+
+			return true;
+		#endif
+		}
+
+		//Fill up to the offset with 0xFF (unused cartridge space)
+
+		bool pad(usz to) {
+
+			static const Buffer padding(0x200, 0xFF);
+
+			while (offset < to)
+				if (!write(padding.data(), std::min(to - offset, padding.size())))
+					return false;
+
+			return true;
+		}
+
+		//Copy data that's unchanged from the source ROM
+
+		bool copy(const u8 *data, usz size) {
+
+		#ifdef __linux__
+
+			//Let the kernel copy the data, so it doesn't have to go through user space
+
+			loff_t src = loff_t(data - rom.data());
+			const usz start = size;
+
+			while (size) {
+
+				const ssize_t copied = copy_file_range(rom.getFileDescriptor(), &src, fd, nullptr, size, 0);
+
+				if (copied <= 0)
+					break;
+
+				size -= usz(copied);
+			}
+
+			//copy_file_range isn't supported on every file system (or across them on older kernels)
+
+			while (size) {
+
+				off_t srcOff = off_t(src);
+				const ssize_t copied = sendfile(fd, rom.getFileDescriptor(), &srcOff, size);
+
+				if (copied <= 0)
+					break;
+
+				src = loff_t(srcOff);
+				size -= usz(copied);
+			}
+
+			offset += start - size;
+			data += start - size;
+
+		#endif
+
+			//Fall back to writing it from the mapping
+
+			return write(data, size);
+		}
+
+	private:
+
+		const ROMMapping &rom;
+		usz offset{};
+
+	#ifdef _WIN32
+		std::FILE *file;
+	#else
+		int fd;
+	#endif
+
+	};
+
+	NDSRepacker::NDSRepacker(const ROMMapping &rom, const NDSFileSystem &fs):
+		rom(rom), nds((const NDS*) rom.data()), firstFileId(fs.getFirstFileId())
+	{
+		if (!fs.getNDS())
+			throw std::runtime_error("Repacking requires a ROM with a file system");
+
+		const u8 *ptr = rom.data();
+		const u32 *fat = (const u32*)(ptr + nds->fatOffset);
+		const usz fileCount = nds->fatSize / 8;
+
+		if (firstFileId > fileCount)
+			throw std::runtime_error("NDS file system has less files than overlays");
+
+		files.resize(fileCount);
+
+		for (usz i = 0; i < fileCount; ++i) {
+
+			const u32 beg = fat[i << 1], end = fat[(i << 1) + 1];
+
+			if (end < beg || end > rom.size())
+				throw std::runtime_error("NDS file allocation table points out of bounds");
+
+			files[i] = FileData{ ptr + beg, end - beg, false, {} };
+		}
+
+		//The nitrocode footer follows the arm9 binary, but isn't included in its size
+
+		if (nds->arm9Offset + usz(nds->arm9Size) + 12 <= rom.size() && *(const u32*)(ptr + nds->arm9Offset + nds->arm9Size) == 0xDEC00621)
+			arm9FooterSize = 12;
+
+		arm9 = FileData{ ptr + nds->arm9Offset, nds->arm9Size + arm9FooterSize, false, {} };
+		overlayTables[0] = FileData{ ptr + nds->arm9OverlayOffset, nds->arm9OverlaySize, false, {} };
+		overlayTables[1] = FileData{ ptr + nds->arm7OverlayOffset, nds->arm7OverlaySize, false, {} };
+
+		//Convert the virtual files back to FNT folders; files go before folders, but that doesn't change their ids
+
+		const List<FileInfo> &virtualFiles = fs.getVirtualFiles();
+
+		usz folderCount{};
+
+		for (auto &f : virtualFiles)
+			folderCount += f.isFolder();
+
+		folders.resize(folderCount);
+
+		for (FileHandle i = 0; i < FileHandle(virtualFiles.size()); ++i) {
+
+			const FileInfo &f = virtualFiles[i];
+
+			if (!f.isFolder())
+				continue;
+
+			Folder &folder = folders[fs.getId(i)];
+			folder.parent = i ? fs.getId(f.parent) : 0;
+			folder.firstFile = ((const FNTFolder*)f.dataExt)->firstFilePosition;
+
+			for (FileHandle j = f.fileHint; j < f.end; ++j)
+				folder.entries.push_back(Entry{ virtualFiles[j].name, fs.getId(j), false });
+
+			for (FileHandle j = f.folderHint; j < f.fileHint; ++j)
+				folder.entries.push_back(Entry{ virtualFiles[j].name, fs.getId(j), true });
+		}
+	}
+
+	//Splitting paths
+
+	inline List<String> splitPath(const String &path) {
+
+		List<String> res;
+		usz beg = path.rfind("~/", 0) == 0 ? 2 : (path.rfind("~", 0) == 0 || path.rfind("/", 0) == 0 ? 1 : 0);
+
+		while (beg < path.size()) {
+
+			usz end = path.find('/', beg);
+
+			if (end == String::npos)
+				end = path.size();
+
+			if (end != beg)
+				res.push_back(path.substr(beg, end - beg));
+
+			beg = end + 1;
+		}
+
+		return res;
+	}
+
+	bool NDSRepacker::find(const String &path, u16 &folder, usz &entry) const {
+
+		folder = 0;
+		entry = usz_MAX;
+
+		const List<String> names = splitPath(path);
+
+		for (usz i = 0; i < names.size(); ++i) {
+
+			const List<Entry> &entries = folders[folder].entries;
+
+			auto it = std::find_if(entries.begin(), entries.end(), [&](const Entry &e) { return e.name == names[i]; });
+
+			if (it == entries.end())
+				return false;
+
+			if (i + 1 == names.size()) {
+				entry = usz(it - entries.begin());
+				return true;
+			}
+
+			if (!it->isFolder)
+				return false;
+
+			folder = it->id;
+		}
+
+		return true;
+	}
+
+	//Modifying files
+
+	bool NDSRepacker::replace(u16 fileId, Buffer data) {
+
+		if (fileId >= files.size() || data.size() > u32_MAX)
+			return false;
+
+		FileData &file = files[fileId];
+		file.size = u32(data.size());
+		file.isReplaced = true;
+		file.replacement = std::move(data);
+
+		changes = true;
+		return true;
+	}
+
+	bool NDSRepacker::replace(const String &path, Buffer data) {
+
+		u16 folder;
+		usz entry;
+
+		if (!find(path, folder, entry) || entry == usz_MAX)
+			return false;
+
+		const Entry &e = folders[folder].entries[entry];
+
+		if (e.isFolder)
+			return false;
+
+		return replace(e.id, std::move(data));
+	}
+
+	bool NDSRepacker::add(const String &path, Buffer data) {
+
+		const List<String> names = splitPath(path);
+
+		if (names.empty() || data.size() > u32_MAX || files.size() > u16_MAX)
+			return false;
+
+		for (const String &name : names)
+			if (name.size() > 0x7F)
+				return false;
+
+		//Find or create the folders that contain the file
+
+		u16 folder{};
+
+		for (usz i = 0; i + 1 < names.size(); ++i) {
+
+			List<Entry> &entries = folders[folder].entries;
+
+			auto it = std::find_if(entries.begin(), entries.end(), [&](const Entry &e) { return e.name == names[i]; });
+
+			if (it != entries.end()) {
+
+				if (!it->isFolder)
+					return false;
+
+				folder = it->id;
+				continue;
+			}
+
+			//Folder ids go from 0xF000 to 0xFFFF
+
+			if (folders.size() >= 0x1000)
+				return false;
+
+			const u16 id = u16(folders.size());
+			entries.push_back(Entry{ names[i], id, true });
+			folders.push_back(Folder{ folder, u16_MAX, {} });
+			folder = id;
+		}
+
+		List<Entry> &entries = folders[folder].entries;
+
+		for (const Entry &e : entries)
+			if (e.name == names.back())
+				return false;
+
+		entries.push_back(Entry{ names.back(), u16(files.size()), false });
+		files.push_back(FileData{ nullptr, u32(data.size()), true, std::move(data) });
+
+		changes = true;
+		return true;
+	}
+
+	bool NDSRepacker::replaceArm9(Buffer data) {
+
+		if (data.size() + arm9FooterSize > u32_MAX)
+			return false;
+
+		const u8 *footer = rom.data() + nds->arm9Offset + nds->arm9Size;
+		data.insert(data.end(), footer, footer + arm9FooterSize);
+
+		arm9.size = u32(data.size());
+		arm9.isReplaced = true;
+		arm9.replacement = std::move(data);
+
+		changes = true;
+		return true;
+	}
+
+	bool NDSRepacker::replaceOverlayTable(bool isArm7, Buffer table) {
+
+		if (table.size() % sizeof(OVTEntry) || table.size() > u32_MAX)
+			return false;
+
+		FileData &res = overlayTables[isArm7];
+		res.size = u32(table.size());
+		res.isReplaced = true;
+		res.replacement = std::move(table);
+
+		changes = true;
+		return true;
+	}
+
+	//Writing the ROM
+
+	bool NDSRepacker::write(const String &path) const {
+
+		//Number the files per folder, in the order of their original first file id.
+		//This means that the ids don't change if no files are added
+
+		List<u16> order(folders.size());
+		std::iota(order.begin(), order.end(), u16(0));
+
+		std::stable_sort(order.begin(), order.end(), [&](u16 a, u16 b) {
+			return folders[a].firstFile < folders[b].firstFile;
+		});
+
+		List<usz> sources(firstFileId);				//Source file id per new file id
+		List<u16> firstFiles(folders.size());
+
+		std::iota(sources.begin(), sources.end(), usz(0));
+
+		for (u16 i : order) {
+
+			firstFiles[i] = u16(sources.size());
+
+			for (const Entry &e : folders[i].entries)
+				if (!e.isFolder)
+					sources.push_back(e.id);
+		}
+
+		if (sources.size() > 0x10000) {
+			System::log()->fatal("ROM has too many files to repack");
+			return false;
+		}
+
+		//File name table
+
+		Buffer fnt(folders.size() * sizeof(FNTFolder));
+
+		for (usz i = 0; i < folders.size(); ++i) {
+
+			const Folder &folder = folders[i];
+
+			FNTFolder header{
+				u32(fnt.size()),
+				firstFiles[i],
+				u16(i ? 0xF000 + folder.parent : folders.size())
+			};
+
+			std::memcpy(fnt.data() + i * sizeof(FNTFolder), &header, sizeof(header));
+
+			for (const Entry &e : folder.entries) {
+
+				fnt.push_back(u8(e.name.size() | (e.isFolder ? 0x80 : 0)));
+				fnt.insert(fnt.end(), e.name.begin(), e.name.end());
+
+				if (e.isFolder) {
+					const u16 id = u16(0xF000 + e.id);
+					fnt.push_back(u8(id));
+					fnt.push_back(u8(id >> 8));
+				}
+			}
+
+			fnt.push_back(0);
+		}
+
+		//Layout; everything is aligned to 512 bytes, everything before the arm9 binary is kept as is
+
+		struct Region {
+			usz offset;
+			const u8 *data;
+			usz size;
+			bool isSource;			//Data is in the source ROM and can be copied by the kernel
+		};
+
+		const u8 *src = rom.data();
+
+		Buffer header(src, src + nds->arm9Offset);
+		Buffer fat(sources.size() * 8);
+
+		NDS &h = *(NDS*)header.data();
+
+		List<Region> regions;
+		regions.reserve(sources.size() + 16);
+
+		usz pos = 0, end = 0;
+
+		auto place = [&](const u8 *data, usz size, bool isSource) -> usz {
+			const usz offset = pos;
+			regions.push_back(Region{ offset, data, size, isSource });
+			end = offset + size;
+			pos = (end + 0x1FF) & ~usz(0x1FF);
+			return offset;
+		};
+
+		auto placeFile = [&](usz newId) {
+
+			const FileData &file = files[sources[newId]];
+
+			const u32 offset = u32(place(
+				file.isReplaced ? file.replacement.data() : file.ptr, file.size, !file.isReplaced
+			));
+
+			const u32 range[2] = { offset, offset + file.size };
+			std::memcpy(fat.data() + newId * 8, range, sizeof(range));
+		};
+
+		auto placeData = [&](const FileData &file) {
+			return u32(place(file.isReplaced ? file.replacement.data() : file.ptr, file.size, !file.isReplaced));
+		};
+
+		place(header.data(), header.size(), false);
+
+		pos = nds->arm9Offset;
+		placeData(arm9);
+		h.arm9Size = arm9.size - arm9FooterSize;
+
+		if (overlayTables[0].size)
+			h.arm9OverlayOffset = placeData(overlayTables[0]);
+
+		h.arm9OverlaySize = overlayTables[0].size;
+
+		for (usz i = 0; i < firstFileId; ++i)
+			placeFile(i);
+
+		h.arm7Offset = u32(place(src + nds->arm7Offset, nds->arm7Size, true));
+
+		if (overlayTables[1].size)
+			h.arm7OverlayOffset = placeData(overlayTables[1]);
+
+		h.arm7OverlaySize = overlayTables[1].size;
+
+		h.fntOffset = u32(place(fnt.data(), fnt.size(), false));
+		h.fntSize = u32(fnt.size());
+
+		h.fatOffset = u32(place(fat.data(), fat.size(), false));
+		h.fatSize = u32(fat.size());
+
+		//Banner size depends on the version; later versions add more titles
+
+		const u16 bannerVersion = *(const u16*)(src + nds->bannerOffset);
+
+		usz bannerSize =
+			bannerVersion == 0x103 ? 0x23C0 :
+			bannerVersion == 3 ? 0xA40 :
+			bannerVersion == 2 ? 0x940 : 0x840;
+
+		bannerSize = std::min(bannerSize, rom.size() - nds->bannerOffset);
+
+		h.bannerOffset = u32(place(src + nds->bannerOffset, bannerSize, true));
+
+		for (usz i = firstFileId; i < sources.size(); ++i)
+			placeFile(i);
+
+		if (nds->dRomSize)
+			h.dRomOff = u32(place(src + nds->dRomOff, nds->dRomSize, true));
+
+		if (end > u32_MAX) {
+			System::log()->fatal("Repacked ROM is too big");
+			return false;
+		}
+
+		h.romSize = u32(end);
+
+		//Capacity is the chip size (128 KiB << capacity)
+
+		while ((u64(0x20000) << h.capacity) < end)
+			++h.capacity;
+
+		//The offsets changed, so the header checksum has to be recomputed; the banner is copied as is
+
+		h.nHC = ChecksumHelper::crc16(header.data(), offsetof(NDS, nHC));
+
+		//Stream everything to disk
+
+		ROMWriter out(path, rom);
+
+		if (!out.isOpen()) {
+			System::log()->fatal("Couldn't open repacked ROM for writing");
+			return false;
+		}
+
+		for (const Region &r : regions)
+			if (!out.pad(r.offset) || !(r.isSource ? out.copy(r.data, r.size) : out.write(r.data, r.size))) {
+				System::log()->fatal("Couldn't write repacked ROM");
+				return false;
+			}
+
+		return true;
+	}
+
+}
@@ -0,0 +1,488 @@
+#include "helper/patch.hpp"
+#include "helper/nds_file_system.hpp"
+#include "helper/rom_mapping.hpp"
+#include "helper/hash.hpp"
+#include "helper/parallel.hpp"
+#include <unordered_map>
+#include <cstring>
+#include <cstdio>
+
+using namespace oic;
+
+namespace nre {
+
+	//Parts of a ROM that are matched between the source and target by name
+
+	struct Range {
+		usz beg, end;
+	};
+
+	using Ranges = std::unordered_map<String, Range>;
+
+	static inline void addRange(Ranges &ranges, const String &name, usz beg, usz size, usz romSize) {
+		if (size && beg < romSize && size <= romSize - beg)
+			ranges[name] = { beg, beg + size };
+	}
+
+	static Ranges getRanges(const u8 *data, usz size) {
+
+		Ranges ranges;
+		NDS *nds = NDS::get((u8*) data, size);
+
+		if (!nds)
+			return ranges;
+
+		addRange(ranges, "#header", 0, nds->romHeaderSize, size);
+		addRange(ranges, "#arm9", nds->arm9Offset, nds->arm9Size, size);
+		addRange(ranges, "#arm7", nds->arm7Offset, nds->arm7Size, size);
+		addRange(ranges, "#fnt", nds->fntOffset, nds->fntSize, size);
+		addRange(ranges, "#fat", nds->fatOffset, nds->fatSize, size);
+		addRange(ranges, "#arm9_overlay", nds->arm9OverlayOffset, nds->arm9OverlaySize, size);
+		addRange(ranges, "#arm7_overlay", nds->arm7OverlayOffset, nds->arm7OverlaySize, size);
+		addRange(ranges, "#banner", nds->bannerOffset, sizeof(NDSBanner), size);
+		addRange(ranges, "#debug", nds->dRomOff, nds->dRomSize, size);
+
+		//A ROM without a (valid) file system is still diffed by the parts above
+
+		if (!nds->fntSize)
+			return ranges;
+
+		try {
+
+			NDSFileSystem fs(nds);
+
+			for (auto &f : fs.getVirtualFiles())
+				if (!f.isFolder())
+					addRange(ranges, f.path, usz((const u8*) f.dataExt - data), usz(f.fileSize), size);
+
+			//Overlays are only in the FAT
+
+			const u32 *fat = (const u32*)(data + nds->fatOffset);
+
+			for (u32 i = 0; i < fs.getFirstFileId() && i < nds->fatSize / 8; ++i)
+				if (fat[i << 1 | 1] >= fat[i << 1])
+					addRange(ranges, "#file" + std::to_string(i), fat[i << 1], fat[i << 1 | 1] - fat[i << 1], size);
+
+		} catch (std::runtime_error&) {}
+
+		return ranges;
+	}
+
+	//A part of the target and the part of the source it's diffed against
+
+	struct Segment {
+		usz targetBeg, targetEnd;
+		usz sourceBeg, sourceEnd;
+	};
+
+	//Offset is into the source for a COPY and into the target for an INSERT
+
+	struct Op {
+		usz offset, length;
+		bool isCopy;
+	};
+
+	//Rolling hash over blocks of the source; only every blockSize'th position of the source is indexed,
+	//while every position of the target is looked up, so any match of 2 * blockSize - 1 bytes or more is found
+
+	static constexpr usz blockSize = 16, maxChain = 8;
+	static constexpr u32 multiplier = 0x01000193;
+
+	static constexpr u32 getPower() {
+
+		u32 power = 1;
+
+		for (usz i = 1; i < blockSize; ++i)
+			power *= multiplier;
+
+		return power;
+	}
+
+	static constexpr u32 power = getPower();
+
+	static inline u32 hashBlock(const u8 *ptr) {
+
+		u32 h{};
+
+		for (usz i = 0; i < blockSize; ++i)
+			h = h * multiplier + ptr[i];
+
+		return h;
+	}
+
+	static inline usz matchLength(const u8 *a, const u8 *b, usz max) {
+
+		usz len = 0;
+
+		for (; len + 8 <= max; len += 8) {
+
+			u64 x, y;
+			std::memcpy(&x, a + len, 8);
+			std::memcpy(&y, b + len, 8);
+
+			if (x != y)
+				break;
+		}
+
+		while (len < max && a[len] == b[len])
+			++len;
+
+		return len;
+	}
+
+	static void diffSegment(const u8 *source, const u8 *target, const Segment &seg, List<Op> &ops) {
+
+		const u8 *s = source + seg.sourceBeg, *t = target + seg.targetBeg;
+		const usz m = seg.sourceEnd - seg.sourceBeg, n = seg.targetEnd - seg.targetBeg;
+
+		auto insert = [&](usz beg, usz end) {
+			if (end > beg)
+				ops.push_back({ seg.targetBeg + beg, end - beg, false });
+		};
+
+		//Most files don't change
+
+		if (m == n && !std::memcmp(s, t, n)) {
+			ops.push_back({ seg.sourceBeg, n, true });
+			return;
+		}
+
+		if (m < blockSize || n < blockSize) {
+			insert(0, n);
+			return;
+		}
+
+		//Index the blocks of the source
+
+		const usz blocks = m / blockSize;
+		u32 bits = 10;
+
+		while ((usz(1) << bits) < blocks * 2 && bits < 24)
+			++bits;
+
+		constexpr u32 none = u32_MAX;
+		List<u32> head(usz(1) << bits, none), next(blocks);
+
+		for (usz b = blocks; b--; ) {
+			const u32 slot = hashBlock(s + b * blockSize) >> (32 - bits);
+			next[b] = head[slot];
+			head[slot] = u32(b);
+		}
+
+		//Find the longest match at every position of the target, extended back into the pending literals
+
+		usz i = 0, literal = 0;
+		u32 h = hashBlock(t);
+
+		while (i + blockSize <= n) {
+
+			usz bestLen = 0, bestSrc = 0, bestBack = 0, chain = maxChain;
+
+			for (u32 b = head[h >> (32 - bits)]; b != none && chain; b = next[b], --chain) {
+
+				const usz p = usz(b) * blockSize;
+
+				if (std::memcmp(s + p, t + i, blockSize))
+					continue;
+
+				const usz len = blockSize + matchLength(s + p + blockSize, t + i + blockSize, std::min(m - p, n - i) - blockSize);
+
+				usz back = 0;
+
+				while (back < i - literal && back < p && s[p - back - 1] == t[i - back - 1])
+					++back;
+
+				if (len + back > bestLen + bestBack) {
+					bestLen = len;
+					bestSrc = p;
+					bestBack = back;
+				}
+			}
+
+			if (bestLen) {
+
+				insert(literal, i - bestBack);
+				ops.push_back({ seg.sourceBeg + bestSrc - bestBack, bestLen + bestBack, true });
+
+				i += bestLen;
+				literal = i;
+
+				if (i + blockSize <= n)
+					h = hashBlock(t + i);
+
+				continue;
+			}
+
+			if (i + blockSize < n)
+				h = (h - t[i] * power) * multiplier + t[i + blockSize];
+
+			++i;
+		}
+
+		insert(literal, n);
+	}
+
+	static inline void writeNumber(Buffer &out, u64 v) {
+
+		while (v >= 0x80) {
+			out.push_back(u8(v) | 0x80);
+			v >>= 7;
+		}
+
+		out.push_back(u8(v));
+	}
+
+	bool PatchHelper::create(const u8 *source, usz sourceSize, const u8 *target, usz targetSize, Buffer &patch, usz threads) {
+
+		//Every named part of the target is diffed against the part with the same name in the source
+
+		const Ranges sourceRanges = getRanges(source, sourceSize), targetRanges = getRanges(target, targetSize);
+
+		List<Segment> named;
+		named.reserve(targetRanges.size());
+
+		for (auto &range : targetRanges) {
+
+			auto it = sourceRanges.find(range.first);
+			const Range s = it != sourceRanges.end() ? it->second : Range{};
+
+			named.push_back({ range.second.beg, range.second.end, s.beg, s.end });
+		}
+
+		std::sort(named.begin(), named.end(), [](const Segment &a, const Segment &b) {
+			return a.targetBeg < b.targetBeg || (a.targetBeg == b.targetBeg && a.targetEnd > b.targetEnd);
+		});
+
+		//The segments have to cover the target once; data that's used by multiple parts is only diffed once
+		//and everything that isn't named (padding) is diffed against the same offset in the source
+
+		List<Segment> segments;
+		segments.reserve(named.size() * 2 + 1);
+
+		usz pos = 0;
+
+		auto gap = [&](usz end) {
+			if (end > pos)
+				segments.push_back({ pos, end, std::min(pos, sourceSize), std::min(end, sourceSize) });
+		};
+
+		for (Segment seg : named) {
+
+			if (seg.targetEnd <= pos)
+				continue;
+
+			gap(seg.targetBeg);
+
+			seg.targetBeg = std::max(seg.targetBeg, pos);
+			segments.push_back(seg);
+			pos = seg.targetEnd;
+		}
+
+		gap(targetSize);
+
+		//Diff the segments in parallel; the hashes are done as two extra jobs
+
+		List<List<Op>> ops(segments.size());
+		u64 sourceHash{}, targetHash{};
+
+		Parallel::forEach(segments.size() + 2, threads, [&](usz i) {
+
+			if (i == segments.size())
+				sourceHash = HashHelper::xxh64(source, sourceSize);
+
+			else if (i == segments.size() + 1)
+				targetHash = HashHelper::xxh64(target, targetSize);
+
+			else diffSegment(source, target, segments[i], ops[i]);
+		});
+
+		//Serialize; ops that continue each other are merged, since segments tend to be next to each other in both ROMs
+
+		const Header header{
+			{ 'N', 'R', 'P', 'T' }, version,
+			sourceSize, targetSize,
+			sourceHash, targetHash
+		};
+
+		patch.assign((const u8*) &header, (const u8*) (&header + 1));
+
+		Op last{};
+		usz cursor{};
+
+		auto write = [&](const Op &op) {
+
+			if (!op.length)
+				return;
+
+			writeNumber(patch, u64(op.length - 1) << 1 | op.isCopy);
+
+			if (!op.isCopy) {
+				patch.insert(patch.end(), target + op.offset, target + op.offset + op.length);
+				return;
+			}
+
+			const i64 delta = i64(op.offset) - i64(cursor);
+			writeNumber(patch, u64(delta) << 1 ^ u64(delta >> 63));
+			cursor = op.offset + op.length;
+		};
+
+		for (const List<Op> &list : ops)
+			for (const Op &op : list) {
+
+				if (last.length && last.isCopy == op.isCopy && last.offset + last.length == op.offset) {
+					last.length += op.length;
+					continue;
+				}
+
+				write(last);
+				last = op;
+			}
+
+		write(last);
+		return true;
+	}
+
+	//Buffered reads from the patch
+
+	class PatchReader {
+
+	public:
+
+		PatchReader(std::FILE *file): file(file), buffer(64 << 10) {}
+
+		bool read(u8 *out, usz size) {
+
+			while (size) {
+
+				if (pos == end) {
+
+					pos = 0;
+					end = std::fread(buffer.data(), 1, buffer.size(), file);
+
+					if (!end)
+						return false;
+				}
+
+				const usz count = std::min(size, end - pos);
+				std::memcpy(out, buffer.data() + pos, count);
+
+				out += count;
+				size -= count;
+				pos += count;
+			}
+
+			return true;
+		}
+
+		bool readNumber(u64 &v) {
+
+			v = 0;
+
+			for (u32 shift = 0; shift < 64; shift += 7) {
+
+				u8 b;
+
+				if (!read(&b, 1))
+					return false;
+
+				v |= u64(b & 0x7F) << shift;
+
+				if (!(b & 0x80))
+					return true;
+			}
+
+			return false;
+		}
+
+	private:
+
+		std::FILE *file;
+		Buffer buffer;
+		usz pos{}, end{};
+	};
+
+	bool PatchHelper::apply(const u8 *source, usz sourceSize, const String &patch, const String &target) {
+
+		std::FILE *in = std::fopen(patch.c_str(), "rb");
+
+		if (!in)
+			return false;
+
+		PatchReader reader(in);
+		Header header;
+
+		bool success =
+			reader.read((u8*) &header, sizeof(header)) &&
+			!std::memcmp(header.magic, "NRPT", 4) && header.version == version &&
+			header.sourceSize == sourceSize && header.sourceHash == HashHelper::xxh64(source, sourceSize);
+
+		std::FILE *out = success ? std::fopen(target.c_str(), "wb") : nullptr;
+		success &= bool(out);
+
+		//COPY is written straight from the source and INSERT goes through a small buffer
+
+		Buffer chunk(64 << 10);
+		u64 written{}, cursor{};
+
+		while (success && written < header.targetSize) {
+
+			u64 op;
+
+			if (!reader.readNumber(op) || (op >> 1) >= header.targetSize - written) {
+				success = false;
+				break;
+			}
+
+			const u64 length = (op >> 1) + 1;
+
+			if (op & 1) {
+
+				u64 zigzag;
+
+				if (!reader.readNumber(zigzag)) {
+					success = false;
+					break;
+				}
+
+				const u64 offset = cursor + u64(i64(zigzag >> 1) ^ -i64(zigzag & 1));
+
+				success =
+					offset <= sourceSize && length <= sourceSize - offset &&
+					std::fwrite(source + offset, 1, usz(length), out) == length;
+
+				cursor = offset + length;
+			}
+
+			else for (u64 left = length; left && success; ) {
+
+				const usz count = usz(std::min(left, u64(chunk.size())));
+
+				success = reader.read(chunk.data(), count) && std::fwrite(chunk.data(), 1, count, out) == count;
+				left -= count;
+			}
+
+			written += length;
+		}
+
+		std::fclose(in);
+
+		if (out)
+			success &= !std::fclose(out);
+
+		//Check the result; it's in the page cache by now, so this doesn't read it from disk again
+
+		if (success && header.targetSize)
+			try {
+				ROMMapping result(target);
+				success = result.size() == header.targetSize && HashHelper::xxh64(result.data(), result.size()) == header.targetHash;
+			} catch (std::runtime_error&) {
+				success = false;
+			}
+
+		if (!success && out)
+			std::remove(target.c_str());
+
+		return success;
+	}
+
+}
@@ -0,0 +1,528 @@
+#include "helper/png.hpp"
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+namespace nre {
+
+	struct CRC32Table {
+
+		u32 table[256];
+
+		constexpr CRC32Table(): table{} {
+			for (u32 i = 0; i < 256; ++i) {
+
+				u32 crc = i;
+
+				for (u32 j = 0; j < 8; ++j)
+					crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+
+				table[i] = crc;
+			}
+		}
+	};
+
+	static constexpr CRC32Table crcTable{};
+
+	u32 PNGHelper::crc32(const void *data, usz size, u32 crc) {
+
+		const u8 *ptr = (const u8*) data;
+		crc = ~crc;
+
+		for (usz i = 0; i < size; ++i)
+			crc = crcTable.table[(crc ^ ptr[i]) & 0xFF] ^ (crc >> 8);
+
+		return ~crc;
+	}
+
+	u32 PNGHelper::adler32(const u8 *data, usz size, u32 adler) {
+
+		u32 a = adler & 0xFFFF, b = adler >> 16;
+
+		//5552 is the most bytes that can be summed before b can overflow
+
+		while (size) {
+
+			const usz count = std::min(size, usz(5552));
+
+			for (usz i = 0; i < count; ++i) {
+				a += data[i];
+				b += a;
+			}
+
+			a %= 65521;
+			b %= 65521;
+
+			data += count;
+			size -= count;
+		}
+
+		return b << 16 | a;
+	}
+
+	static inline void putU32BE(Buffer &out, u32 v) {
+		out.insert(out.end(), { u8(v >> 24), u8(v >> 16), u8(v >> 8), u8(v) });
+	}
+
+	//A chunk is its length, type, data and the CRC of the type and data
+
+	static inline usz beginChunk(Buffer &out, const c8 type[4]) {
+		putU32BE(out, 0);
+		out.insert(out.end(), type, type + 4);
+		return out.size() - 4;
+	}
+
+	static inline void endChunk(Buffer &out, usz start) {
+
+		const u32 length = u32(out.size() - start - 4);
+
+		out[start - 4] = u8(length >> 24);
+		out[start - 3] = u8(length >> 16);
+		out[start - 2] = u8(length >> 8);
+		out[start - 1] = u8(length);
+
+		putU32BE(out, PNGHelper::crc32(out.data() + start, out.size() - start));
+	}
+
+	static inline u8 paeth(u8 a, u8 b, u8 c) {
+
+		const i32 p = i32(a) + b - c;
+		const i32 pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+
+		return pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+	}
+
+	//Filters a row (prev is zeros for the first row) and returns the sum of absolute (signed) values
+
+	template<u8 type>
+	static inline u8 filterByte(u8 v, u8 a, u8 b, u8 c) {
+		if constexpr (type == 1)		return u8(v - a);
+		else if constexpr (type == 2)	return u8(v - b);
+		else if constexpr (type == 3)	return u8(v - ((a + b) >> 1));
+		else if constexpr (type == 4)	return u8(v - paeth(a, b, c));
+		else							return v;
+	}
+
+	template<u8 type>
+	static inline usz filter(const u8 *row, const u8 *prev, usz rowBytes, usz bpp, u8 *dst) {
+
+		usz cost = 0;
+
+		//The first pixel has no left neighbor; split off, so the rest of the row doesn't branch
+
+		for (usz i = 0; i < bpp && i < rowBytes; ++i) {
+			const u8 v = dst[i] = filterByte<type>(row[i], 0, prev[i], 0);
+			cost += v < 128 ? v : 256 - v;
+		}
+
+		for (usz i = bpp; i < rowBytes; ++i) {
+			const u8 v = dst[i] = filterByte<type>(row[i], row[i - bpp], prev[i], prev[i - bpp]);
+			cost += v < 128 ? v : 256 - v;
+		}
+
+		return cost;
+	}
+
+	//Keeps the filter with the lowest cost
+
+	static void filterRow(const u8 *row, const u8 *prev, usz rowBytes, usz bpp, u8 *out, u8 *scratch) {
+
+		usz bestCost = filter<0>(row, prev, rowBytes, bpp, out + 1);
+		out[0] = 0;
+
+		auto tryFilter = [&](u8 type, usz cost) {
+			if (cost < bestCost) {
+				bestCost = cost;
+				out[0] = type;
+				std::memcpy(out + 1, scratch, rowBytes);
+			}
+		};
+
+		tryFilter(1, filter<1>(row, prev, rowBytes, bpp, scratch));
+		tryFilter(2, filter<2>(row, prev, rowBytes, bpp, scratch));
+		tryFilter(3, filter<3>(row, prev, rowBytes, bpp, scratch));
+		tryFilter(4, filter<4>(row, prev, rowBytes, bpp, scratch));
+	}
+
+	bool PNGHelper::encode(
+		const void *pixels, u16 w, u16 h, PNGFormat format, Buffer &out,
+		const bgr5 *palette, u16 colors
+	) {
+
+		const bool isIndexed = format == PNG_INDEXED4 || format == PNG_INDEXED8;
+		const usz bpp = format == PNG_RGBA8 ? 4 : 1;
+		const usz pixelCount = usz(w) * h;
+		const u8 *src = (const u8*) pixels;
+
+		if (isIndexed) {
+
+			if (!palette || !colors || colors > (format == PNG_INDEXED4 ? 16 : 256))
+				return false;
+
+			for (usz i = 0; i < pixelCount; ++i)
+				if (src[i] >= colors)
+					return false;
+		}
+
+		//4-bit rows store two pixels per byte (the first one in the high nibble) and are padded to a byte
+
+		const usz rowBytes = format == PNG_INDEXED4 ? (usz(w) + 1) >> 1 : usz(w) * bpp;
+
+		//Every row starts with its filter type
+
+		Buffer raw((rowBytes + 1) * h);
+
+		if (format == PNG_INDEXED4)
+			for (usz y = 0; y < h; ++y) {
+
+				u8 *dst = raw.data() + y * (rowBytes + 1);
+				const u8 *row = src + y * w;
+
+				dst[0] = 0;
+
+				for (usz x = 0; x + 1 < w; x += 2)
+					dst[1 + (x >> 1)] = u8(row[x] << 4 | row[x + 1]);
+
+				if (w & 1)
+					dst[rowBytes] = u8(row[w - 1] << 4);
+			}
+
+		else if (bpp == 1)
+			for (usz y = 0; y < h; ++y) {
+				raw[y * (rowBytes + 1)] = 0;
+				std::memcpy(raw.data() + y * (rowBytes + 1) + 1, src + y * rowBytes, rowBytes);
+			}
+
+		else {
+
+			Buffer scratch(rowBytes), zeros(rowBytes);
+
+			for (usz y = 0; y < h; ++y)
+				filterRow(
+					src + y * rowBytes, y ? src + (y - 1) * rowBytes : zeros.data(), rowBytes, bpp,
+					raw.data() + y * (rowBytes + 1), scratch.data()
+				);
+		}
+
+		out.reserve(out.size() + raw.size() / 2 + usz(colors) * 3 + 128);
+
+		static constexpr u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		out.insert(out.end(), signature, signature + 8);
+
+		const u8 colorType = format == PNG_RGBA8 ? 6 : (isIndexed ? 3 : 0);
+
+		usz chunk = beginChunk(out, "IHDR");
+		putU32BE(out, w);
+		putU32BE(out, h);
+		out.insert(out.end(), { u8(format == PNG_INDEXED4 ? 4 : 8), colorType, 0, 0, 0 });
+		endChunk(out, chunk);
+
+		if (isIndexed) {
+
+			chunk = beginChunk(out, "PLTE");
+
+			for (u16 i = 0; i < colors; ++i) {
+				rgba8 c;
+				BGR5::toRGBA8(palette[i], &c);
+				out.insert(out.end(), { c.r, c.g, c.b });
+			}
+
+			endChunk(out, chunk);
+
+			//Only index 0 is transparent; missing entries of tRNS are opaque
+
+			chunk = beginChunk(out, "tRNS");
+			out.push_back(0);
+			endChunk(out, chunk);
+		}
+
+		//The zlib stream is written straight into the chunk
+
+		chunk = beginChunk(out, "IDAT");
+		deflate(raw.data(), raw.size(), out);
+		endChunk(out, chunk);
+
+		chunk = beginChunk(out, "IEND");
+		endChunk(out, chunk);
+		return true;
+	}
+
+	bool PNGHelper::write(
+		const String &file, const void *pixels, u16 w, u16 h, PNGFormat format,
+		const bgr5 *palette, u16 colors
+	) {
+
+		Buffer png;
+
+		if (!encode(pixels, w, h, format, png, palette, colors))
+			return false;
+
+		std::FILE *f = std::fopen(file.c_str(), "wb");
+
+		if (!f)
+			return false;
+
+		//Skip the stdio buffer; the PNG is already in memory, so it would only be an extra copy
+
+		std::setvbuf(f, nullptr, _IONBF, 0);
+
+		const bool success = std::fwrite(png.data(), 1, png.size(), f) == png.size();
+		return !std::fclose(f) && success;
+	}
+
+	static inline u32 getU32BE(const u8 *ptr) {
+		return u32(ptr[0]) << 24 | u32(ptr[1]) << 16 | u32(ptr[2]) << 8 | ptr[3];
+	}
+
+	//Undoes the filter of a row in place; prev is zeros for the first row
+
+	static bool unfilterRow(u8 type, u8 *row, const u8 *prev, usz rowBytes, usz bpp) {
+
+		switch (type) {
+
+			case 0:
+				return true;
+
+			case 1:
+				for (usz i = bpp; i < rowBytes; ++i)
+					row[i] = u8(row[i] + row[i - bpp]);
+				return true;
+
+			case 2:
+				for (usz i = 0; i < rowBytes; ++i)
+					row[i] = u8(row[i] + prev[i]);
+				return true;
+
+			case 3:
+				for (usz i = 0; i < rowBytes; ++i)
+					row[i] = u8(row[i] + ((usz(i >= bpp ? row[i - bpp] : 0) + prev[i]) >> 1));
+				return true;
+
+			case 4:
+				for (usz i = 0; i < rowBytes; ++i)
+					row[i] = u8(row[i] + (i >= bpp ? paeth(row[i - bpp], prev[i], prev[i - bpp]) : prev[i]));
+				return true;
+
+			default:
+				return false;
+		}
+	}
+
+	bool PNGHelper::decode(const u8 *data, usz size, List<rgba8> &out, u16 &w, u16 &h) {
+
+		static constexpr u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+		if (size < 8 || std::memcmp(data, signature, 8))
+			return false;
+
+		u32 width = 0, height = 0;
+		u8 depth = 0, colorType = 0;
+
+		u8 palette[256][4];
+		usz paletteSize = 0;
+
+		//Color of transparent pixels for grayscale and RGB images (tRNS)
+		bool hasKey = false;
+		u16 key[3]{};
+
+		Buffer compressed;
+
+		for (usz pos = 8; ; ) {
+
+			if (size - pos < 12)
+				return false;
+
+			const u32 length = getU32BE(data + pos);
+
+			if (length > size - pos - 12)
+				return false;
+
+			const u8 *type = data + pos + 4, *body = type + 4;
+
+			if (crc32(type, usz(length) + 4) != getU32BE(body + length))
+				return false;
+
+			pos += usz(length) + 12;
+
+			if (!std::memcmp(type, "IHDR", 4)) {
+
+				if (length < 13 || body[10] || body[11] || body[12])		//Only deflate, filter type 0 and no interlacing
+					return false;
+
+				width = getU32BE(body);
+				height = getU32BE(body + 4);
+				depth = body[8];
+				colorType = body[9];
+			}
+
+			else if (!std::memcmp(type, "PLTE", 4)) {
+
+				paletteSize = std::min(usz(length / 3), usz(256));
+
+				for (usz i = 0; i < paletteSize; ++i) {
+					std::memcpy(palette[i], body + i * 3, 3);
+					palette[i][3] = 0xFF;
+				}
+			}
+
+			else if (!std::memcmp(type, "tRNS", 4)) {
+
+				if (colorType == 3)
+					for (usz i = 0; i < std::min(usz(length), paletteSize); ++i)
+						palette[i][3] = body[i];
+
+				else if (colorType == 0 && length >= 2) {
+					hasKey = true;
+					key[0] = key[1] = key[2] = u16(body[0] << 8 | body[1]);
+				}
+
+				else if (colorType == 2 && length >= 6) {
+
+					hasKey = true;
+
+					for (usz i = 0; i < 3; ++i)
+						key[i] = u16(body[i * 2] << 8 | body[i * 2 + 1]);
+				}
+			}
+
+			else if (!std::memcmp(type, "IDAT", 4))
+				compressed.insert(compressed.end(), body, body + length);
+
+			else if (!std::memcmp(type, "IEND", 4))
+				break;
+		}
+
+		static constexpr u8 channelsPerType[7] = { 1, 0, 3, 1, 2, 0, 4 };
+
+		if (!width || !height || width > 0xFFFF || height > 0xFFFF || colorType > 6 || !channelsPerType[colorType])
+			return false;
+
+		const bool validDepth =
+			colorType == 0 ? depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16 :
+			colorType == 3 ? depth == 1 || depth == 2 || depth == 4 || depth == 8 :
+			depth == 8 || depth == 16;
+
+		if (!validDepth || (colorType == 3 && !paletteSize))
+			return false;
+
+		const usz channels = channelsPerType[colorType];
+		const usz bits = channels * depth, bpp = std::max(bits >> 3, usz(1));
+		const usz rowBytes = (usz(width) * bits + 7) >> 3;
+
+		Buffer raw;
+		raw.reserve((rowBytes + 1) * height);
+
+		if (!inflate(compressed.data(), compressed.size(), raw) || raw.size() < (rowBytes + 1) * height)
+			return false;
+
+		w = u16(width);
+		h = u16(height);
+		out.resize(usz(w) * h);
+
+		Buffer zeros(rowBytes);
+		const u8 *prev = zeros.data();
+
+		const u32 maxValue = (1u << std::min(usz(depth), usz(8))) - 1;
+
+		for (usz y = 0; y < h; ++y) {
+
+			u8 *row = raw.data() + y * (rowBytes + 1) + 1;
+
+			if (!unfilterRow(row[-1], row, prev, rowBytes, bpp))
+				return false;
+
+			prev = row;
+			rgba8 *dst = out.data() + y * w;
+
+			//Samples are big endian; sub-byte samples start at the most significant bits
+
+			auto sample = [&](usz x, usz c) -> u16 {
+
+				if (depth == 16)
+					return u16(row[(x * channels + c) * 2] << 8 | row[(x * channels + c) * 2 + 1]);
+
+				if (depth == 8)
+					return row[x * channels + c];
+
+				const usz bit = x * depth;
+				return u16((row[bit >> 3] >> (8 - depth - (bit & 7))) & maxValue);
+			};
+
+			auto to8Bit = [&](u16 v) -> u8 {
+				return depth == 16 ? u8(v >> 8) : u8(u32(v) * 0xFF / maxValue);
+			};
+
+			for (usz x = 0; x < w; ++x) {
+
+				rgba8 &px = dst[x];
+
+				switch (colorType) {
+
+					case 0: {
+						const u16 v = sample(x, 0);
+						px.r = px.g = px.b = to8Bit(v);
+						px.a = hasKey && v == key[0] ? 0 : 0xFF;
+						break;
+					}
+
+					case 2: {
+						const u16 r = sample(x, 0), g = sample(x, 1), b = sample(x, 2);
+						px.r = to8Bit(r);
+						px.g = to8Bit(g);
+						px.b = to8Bit(b);
+						px.a = hasKey && r == key[0] && g == key[1] && b == key[2] ? 0 : 0xFF;
+						break;
+					}
+
+					case 3: {
+
+						const u16 i = sample(x, 0);
+
+						if (i >= paletteSize)
+							return false;
+
+						std::memcpy(px.data, palette[i], 4);
+						break;
+					}
+
+					case 4:
+						px.r = px.g = px.b = to8Bit(sample(x, 0));
+						px.a = to8Bit(sample(x, 1));
+						break;
+
+					default:
+						px.r = to8Bit(sample(x, 0));
+						px.g = to8Bit(sample(x, 1));
+						px.b = to8Bit(sample(x, 2));
+						px.a = to8Bit(sample(x, 3));
+				}
+			}
+		}
+
+		return true;
+	}
+
+	bool PNGHelper::read(const String &file, List<rgba8> &out, u16 &w, u16 &h) {
+
+		std::FILE *f = std::fopen(file.c_str(), "rb");
+
+		if (!f)
+			return false;
+
+		Buffer data;
+
+		if (!std::fseek(f, 0, SEEK_END)) {
+
+			const long size = std::ftell(f);
+
+			if (size > 0 && !std::fseek(f, 0, SEEK_SET)) {
+				data.resize(usz(size));
+				data.resize(std::fread(data.data(), 1, data.size(), f));
+			}
+		}
+
+		std::fclose(f);
+		return decode(data.data(), data.size(), out, w, h);
+	}
+
+}
@@ -0,0 +1,486 @@
+#include "helper/png.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace nre {
+
+	//Deflate (RFC 1951) with greedy matching over short hash chains; roughly what zlib does at its fastest levels
+
+	static constexpr usz windowSize = 1 << 15, minMatch = 3, maxMatch = 258;
+	static constexpr usz hashBits = 15, maxChain = 4;
+	static constexpr usz symbolsPerBlock = 1 << 16;
+
+	static constexpr u16 lengthBase[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+	};
+
+	static constexpr u8 lengthExtra[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+	};
+
+	static constexpr u16 distanceBase[30] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+	};
+
+	static constexpr u8 distanceExtra[30] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+	};
+
+	//Order the code length code lengths are stored in
+	static constexpr u8 codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	//Symbol of every length and distance; distances over 256 are looked up by (distance - 1) >> 7
+
+	struct SymbolTables {
+
+		u8 length[maxMatch + 1];
+		u8 distance[512];
+
+		constexpr SymbolTables(): length{}, distance{} {
+
+			for (u8 code = 0; code < 29; ++code)
+				for (usz l = lengthBase[code]; l < lengthBase[code] + (usz(1) << lengthExtra[code]) && l <= maxMatch; ++l)
+					length[l] = code;
+
+			length[maxMatch] = 28;
+
+			for (u8 code = 0; code < 30; ++code)
+				for (usz d = distanceBase[code]; d < distanceBase[code] + (usz(1) << distanceExtra[code]); ++d) {
+					if (d <= 256)
+						distance[d - 1] = code;
+					else
+						distance[256 + ((d - 1) >> 7)] = code;
+				}
+		}
+	};
+
+	static constexpr SymbolTables symbolTables{};
+
+	static inline u8 distanceSymbol(usz distance) {
+		return distance <= 256 ? symbolTables.distance[distance - 1] : symbolTables.distance[256 + ((distance - 1) >> 7)];
+	}
+
+	//A literal (distance 0) or a match
+
+	struct Symbol {
+		u16 value;				//Literal or length
+		u16 distance;
+	};
+
+	class BitWriter {
+
+	public:
+
+		BitWriter(Buffer &out): out(out) {}
+
+		inline void write(u32 value, u32 count) {
+
+			bits |= u64(value) << used;
+			used += count;
+
+			while (used >= 8) {
+				out.push_back(u8(bits));
+				bits >>= 8;
+				used -= 8;
+			}
+		}
+
+		inline void align() {
+
+			if (used)
+				out.push_back(u8(bits));
+
+			bits = used = 0;
+		}
+
+		Buffer &out;
+
+	private:
+
+		u64 bits{};
+		u32 used{};
+	};
+
+	//Huffman code lengths of at most limit bits; symbols that aren't used get 0
+	//If the tree is too deep, the frequencies are flattened and it's built again
+
+	static void buildLengths(const u32 *freqs, usz count, u8 limit, u8 *lengths) {
+
+		List<u32> freq(freqs, freqs + count);
+
+		for (;;) {
+
+			std::memset(lengths, 0, count);
+
+			List<u32> leaves;
+
+			for (u32 i = 0; i < count; ++i)
+				if (freq[i])
+					leaves.push_back(i);
+
+			if (leaves.empty())
+				return;
+
+			//A code needs at least one bit
+
+			if (leaves.size() == 1) {
+				lengths[leaves[0]] = 1;
+				return;
+			}
+
+			std::sort(leaves.begin(), leaves.end(), [&](u32 a, u32 b) { return freq[a] < freq[b] || (freq[a] == freq[b] && a < b); });
+
+			//Two queues; the internal nodes are made in order of weight, so they don't have to be sorted
+
+			const usz n = leaves.size();
+
+			List<u64> weight(2 * n - 1);
+			List<u32> parent(2 * n - 1);
+
+			for (usz i = 0; i < n; ++i)
+				weight[i] = freq[leaves[i]];
+
+			usz leaf = 0, node = n;
+
+			auto next = [&](usz made) -> usz {
+				if (leaf < n && (node >= made || weight[leaf] <= weight[node]))
+					return leaf++;
+				return node++;
+			};
+
+			for (usz made = n; made < 2 * n - 1; ++made) {
+				const usz a = next(made), b = next(made);
+				weight[made] = weight[a] + weight[b];
+				parent[a] = parent[b] = u32(made);
+			}
+
+			//Depths from the root down
+
+			List<u8> depth(2 * n - 1);
+			u8 maxDepth = 0;
+
+			for (usz i = 2 * n - 1; i-- > 0; )
+				if (i != 2 * n - 2) {
+					depth[i] = u8(std::min(depth[parent[i]] + 1, 255));
+					maxDepth = std::max(maxDepth, depth[i]);
+				}
+
+			if (maxDepth <= limit) {
+
+				for (usz i = 0; i < n; ++i)
+					lengths[leaves[i]] = depth[i];
+
+				return;
+			}
+
+			for (u32 &f : freq)
+				if (f)
+					f = (f >> 1) | 1;
+		}
+	}
+
+	//Canonical codes, bit reversed since deflate writes Huffman codes from the top bit
+
+	static void buildCodes(const u8 *lengths, usz count, u16 *codes) {
+
+		u16 lengthCount[16]{}, next[16]{};
+
+		for (usz i = 0; i < count; ++i)
+			++lengthCount[lengths[i]];
+
+		lengthCount[0] = 0;
+
+		for (u32 bits = 1, code = 0; bits < 16; ++bits) {
+			code = (code + lengthCount[bits - 1]) << 1;
+			next[bits] = u16(code);
+		}
+
+		for (usz i = 0; i < count; ++i) {
+
+			const u8 len = lengths[i];
+
+			if (!len)
+				continue;
+
+			u32 code = next[len]++, reversed = 0;
+
+			for (u8 j = 0; j < len; ++j, code >>= 1)
+				reversed = reversed << 1 | (code & 1);
+
+			codes[i] = u16(reversed);
+		}
+	}
+
+	//Writes a block of symbols; stored if that's smaller, otherwise with dynamic codes
+
+	static void writeBlock(BitWriter &bw, const Symbol *symbols, usz count, const u8 *raw, usz rawSize, bool isLast) {
+
+		u32 litFreq[286]{}, distFreq[30]{};
+
+		for (usz i = 0; i < count; ++i) {
+
+			const Symbol s = symbols[i];
+
+			if (!s.distance)
+				++litFreq[s.value];
+
+			else {
+				++litFreq[257 + symbolTables.length[s.value]];
+				++distFreq[distanceSymbol(s.distance)];
+			}
+		}
+
+		++litFreq[256];
+
+		u8 litLengths[286], distLengths[30];
+		buildLengths(litFreq, 286, 15, litLengths);
+		buildLengths(distFreq, 30, 15, distLengths);
+
+		//Deflate needs at least one distance code
+
+		if (std::all_of(distLengths, distLengths + 30, [](u8 l) { return !l; }))
+			distLengths[0] = 1;
+
+		usz hlit = 286, hdist = 30;
+
+		while (hlit > 257 && !litLengths[hlit - 1])
+			--hlit;
+
+		while (hdist > 1 && !distLengths[hdist - 1])
+			--hdist;
+
+		//Run length encode the code lengths (16: repeat previous, 17/18: runs of zeros)
+
+		u8 all[286 + 30];
+		std::memcpy(all, litLengths, hlit);
+		std::memcpy(all + hlit, distLengths, hdist);
+
+		const usz total = hlit + hdist;
+
+		struct Run {
+			u8 symbol, extra;
+		};
+
+		List<Run> runs;
+		u32 clFreq[19]{};
+
+		for (usz i = 0; i < total; ) {
+
+			const u8 len = all[i];
+			usz run = 1;
+
+			while (i + run < total && all[i + run] == len)
+				++run;
+
+			if (!len && run >= 3) {
+
+				const usz n = std::min(run, usz(138));
+				runs.push_back(n >= 11 ? Run{ 18, u8(n - 11) } : Run{ 17, u8(n - 3) });
+				i += n;
+			}
+
+			else if (len && run >= 4) {
+
+				runs.push_back({ len, 0 });
+
+				const usz n = std::min(run - 1, usz(6));
+				runs.push_back({ 16, u8(n - 3) });
+				i += n + 1;
+			}
+
+			else {
+				runs.push_back({ len, 0 });
+				++i;
+			}
+
+			++clFreq[runs.back().symbol];
+
+			if (runs.back().symbol == 16)
+				++clFreq[runs[runs.size() - 2].symbol];
+		}
+
+		u8 clLengths[19];
+		buildLengths(clFreq, 19, 7, clLengths);
+
+		usz hclen = 19;
+
+		while (hclen > 4 && !clLengths[codeLengthOrder[hclen - 1]])
+			--hclen;
+
+		//Compare the size with a stored block
+
+		usz bits = 3 + 5 + 5 + 4 + hclen * 3;
+
+		for (const Run &r : runs)
+			bits += clLengths[r.symbol] + (r.symbol == 16 ? 2 : r.symbol == 17 ? 3 : r.symbol == 18 ? 7 : 0);
+
+		for (usz i = 0; i < 286; ++i)
+			bits += usz(litFreq[i]) * (litLengths[i] + (i > 256 ? lengthExtra[i - 257] : 0));
+
+		for (usz i = 0; i < 30; ++i)
+			bits += usz(distFreq[i]) * (distLengths[i] + distanceExtra[i]);
+
+		const usz storedBits = (rawSize + 4 * ((rawSize + 0xFFFE) / 0xFFFF + 1)) * 8;
+
+		if (storedBits < bits) {
+
+			for (usz i = 0; i == 0 || i < rawSize; i += 0xFFFF) {
+
+				const usz n = std::min(rawSize - i, usz(0xFFFF));
+				const bool last = isLast && i + n >= rawSize;
+
+				bw.write(last, 3);
+				bw.align();
+
+				bw.out.insert(bw.out.end(), { u8(n), u8(n >> 8), u8(~n), u8(~n >> 8) });
+				bw.out.insert(bw.out.end(), raw + i, raw + i + n);
+			}
+
+			return;
+		}
+
+		u16 litCodes[286]{}, distCodes[30]{}, clCodes[19]{};
+		buildCodes(litLengths, 286, litCodes);
+		buildCodes(distLengths, 30, distCodes);
+		buildCodes(clLengths, 19, clCodes);
+
+		bw.write(isLast ? 5 : 4, 3);					//BFINAL, BTYPE = 2
+		bw.write(u32(hlit - 257), 5);
+		bw.write(u32(hdist - 1), 5);
+		bw.write(u32(hclen - 4), 4);
+
+		for (usz i = 0; i < hclen; ++i)
+			bw.write(clLengths[codeLengthOrder[i]], 3);
+
+		for (const Run &r : runs) {
+
+			bw.write(clCodes[r.symbol], clLengths[r.symbol]);
+
+			if (r.symbol == 16)
+				bw.write(r.extra, 2);
+
+			else if (r.symbol == 17)
+				bw.write(r.extra, 3);
+
+			else if (r.symbol == 18)
+				bw.write(r.extra, 7);
+		}
+
+		for (usz i = 0; i < count; ++i) {
+
+			const Symbol s = symbols[i];
+
+			if (!s.distance) {
+				bw.write(litCodes[s.value], litLengths[s.value]);
+				continue;
+			}
+
+			const u8 l = symbolTables.length[s.value], d = distanceSymbol(s.distance);
+
+			bw.write(litCodes[257 + l], litLengths[257 + l]);
+			bw.write(s.value - lengthBase[l], lengthExtra[l]);
+
+			bw.write(distCodes[d], distLengths[d]);
+			bw.write(s.distance - distanceBase[d], distanceExtra[d]);
+		}
+
+		bw.write(litCodes[256], litLengths[256]);
+	}
+
+	static inline u32 hash3(const u8 *ptr) {
+		const u32 v = u32(ptr[0]) << 16 | u32(ptr[1]) << 8 | ptr[2];
+		return (v * 2654435761u) >> (32 - hashBits);
+	}
+
+	void PNGHelper::deflate(const u8 *data, usz size, Buffer &out) {
+
+		out.insert(out.end(), { 0x78, 0x01 });			//32 KiB window, fastest
+
+		BitWriter bw(out);
+
+		List<i32> head(usz(1) << hashBits, -1);
+		List<i32> prev(windowSize, -1);
+
+		List<Symbol> symbols;
+		symbols.reserve(std::min(size, symbolsPerBlock));
+
+		usz blockStart = 0, pos = 0;
+
+		auto insert = [&](usz p) {
+			const u32 h = hash3(data + p);
+			prev[p & (windowSize - 1)] = head[h];
+			head[h] = i32(p);
+		};
+
+		while (pos < size) {
+
+			usz bestLen = 0, bestDist = 0;
+
+			if (size - pos >= minMatch) {
+
+				const usz max = std::min(maxMatch, size - pos);
+				usz chain = maxChain;
+
+				for (i32 cand = head[hash3(data + pos)]; cand >= 0 && chain; cand = prev[usz(cand) & (windowSize - 1)], --chain) {
+
+					const usz dist = pos - usz(cand);
+
+					if (dist > windowSize - 1 || dist == 0)
+						break;
+
+					const u8 *a = data + cand, *b = data + pos;
+
+					if (a[bestLen] != b[bestLen] || a[0] != b[0])
+						continue;
+
+					usz len = 0;
+
+					while (len < max && a[len] == b[len])
+						++len;
+
+					if (len > bestLen) {
+
+						bestLen = len;
+						bestDist = dist;
+
+						if (len == max)
+							break;
+					}
+				}
+
+				insert(pos);
+			}
+
+			if (bestLen >= minMatch) {
+
+				symbols.push_back({ u16(bestLen), u16(bestDist) });
+
+				for (usz i = pos + 1, end = std::min(pos + bestLen, size - minMatch + 1); i < end; ++i)
+					insert(i);
+
+				pos += bestLen;
+			}
+
+			else symbols.push_back({ data[pos++], 0 });
+
+			if (symbols.size() == symbolsPerBlock) {
+				writeBlock(bw, symbols.data(), symbols.size(), data + blockStart, pos - blockStart, pos == size);
+				symbols.clear();
+				blockStart = pos;
+			}
+		}
+
+		if (!symbols.empty() || !size)
+			writeBlock(bw, symbols.data(), symbols.size(), data + blockStart, pos - blockStart, true);
+
+		bw.align();
+
+		const u32 adler = adler32(data, size);
+		out.insert(out.end(), { u8(adler >> 24), u8(adler >> 16), u8(adler >> 8), u8(adler) });
+	}
+
+}
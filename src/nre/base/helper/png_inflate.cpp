@@ -0,0 +1,365 @@
+#include "helper/png.hpp"
+#include <cstring>
+
+namespace nre {
+
+	//Decoder of zlib streams; codes up to fastBits long are decoded with one lookup, longer ones a bit at a time
+
+	static constexpr usz fastBits = 10, maxBits = 15;
+
+	static constexpr u16 lengthBase[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+	};
+
+	static constexpr u8 lengthExtra[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+	};
+
+	static constexpr u16 distanceBase[30] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+		1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+	};
+
+	static constexpr u8 distanceExtra[30] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+	};
+
+	class BitReader {
+
+	public:
+
+		BitReader(const u8 *data, usz size): data(data), size(size) {}
+
+		inline void refill() {
+			for (; count <= 56; count += 8, ++pos)
+				bits |= u64(pos < size ? data[pos] : 0) << count;
+		}
+
+		inline u32 peek(usz n) {
+			refill();
+			return u32(bits & ((u64(1) << n) - 1));
+		}
+
+		inline void consume(usz n) {
+			bits >>= n;
+			count -= u32(n);
+		}
+
+		inline u32 get(usz n) {
+			const u32 v = peek(n);
+			consume(n);
+			return v;
+		}
+
+		//Drops the bits up to the next byte and gives back the bytes that were read ahead, for stored blocks
+		inline const u8 *alignToByte() {
+			consume(count & 7);
+			pos -= count >> 3;
+			bits = 0;
+			count = 0;
+			return data + pos;
+		}
+
+		inline bool skip(usz n) {
+
+			if (n > size - std::min(pos, size))
+				return false;
+
+			pos += n;
+			return true;
+		}
+
+		//Reading past the end returns zeros; this checks if any of those were used
+		inline bool isOverrun() const {
+			return pos - (count >> 3) > size;
+		}
+
+		inline usz remaining() const {
+			return size - std::min(pos, size);
+		}
+
+	private:
+
+		const u8 *data;
+		usz size, pos{};
+
+		u64 bits{};
+		u32 count{};
+	};
+
+	struct Huffman {
+
+		u16 fast[1 << fastBits];					//symbol << 4 | length; 0 if the code is longer
+		u16 counts[maxBits + 1];
+		u16 symbols[288];
+
+		//Incomplete codes are allowed (a single distance code is), but over-subscribed ones aren't
+		bool build(const u8 *lengths, usz n) {
+
+			std::memset(counts, 0, sizeof(counts));
+			std::memset(fast, 0, sizeof(fast));
+
+			for (usz i = 0; i < n; ++i)
+				++counts[lengths[i]];
+
+			counts[0] = 0;
+
+			i32 left = 1;
+
+			for (usz len = 1; len <= maxBits; ++len) {
+
+				left = (left << 1) - counts[len];
+
+				if (left < 0)
+					return false;
+			}
+
+			u16 offsets[maxBits + 2]{};
+
+			for (usz len = 1; len <= maxBits; ++len)
+				offsets[len + 1] = u16(offsets[len] + counts[len]);
+
+			//Canonical codes; shorter codes come first and symbols of the same length are in order
+
+			u32 code = 0;
+			u16 next[maxBits + 1]{};
+
+			for (usz len = 1; len <= maxBits; ++len) {
+				code = (code + counts[len - 1]) << 1;
+				next[len] = u16(code);
+			}
+
+			for (usz i = 0; i < n; ++i) {
+
+				const usz len = lengths[i];
+
+				if (!len)
+					continue;
+
+				symbols[offsets[len]++] = u16(i);
+
+				if (len > fastBits) {
+					++next[len];
+					continue;
+				}
+
+				//Codes are stored from the most significant bit, but the stream is read from the least significant
+
+				u32 c = next[len]++, reversed = 0;
+
+				for (usz b = 0; b < len; ++b, c >>= 1)
+					reversed = reversed << 1 | (c & 1);
+
+				for (usz j = reversed; j < (usz(1) << fastBits); j += usz(1) << len)
+					fast[j] = u16(i << 4 | len);
+			}
+
+			return true;
+		}
+
+		//Returns u32_MAX for codes that aren't in the table
+		inline u32 decode(BitReader &in) const {
+
+			const u16 entry = fast[in.peek(fastBits)];
+
+			if (entry) {
+				in.consume(entry & 0xF);
+				return entry >> 4;
+			}
+
+			i32 code = 0, first = 0, index = 0;
+
+			for (usz len = 1; len <= maxBits; ++len) {
+
+				code |= i32(in.get(1));
+
+				const i32 count = counts[len];
+
+				if (code - first < count)
+					return symbols[index + code - first];
+
+				index += count;
+				first = (first + count) << 1;
+				code <<= 1;
+			}
+
+			return u32_MAX;
+		}
+	};
+
+	static bool inflateBlock(BitReader &in, const Huffman &lit, const Huffman &dist, Buffer &out) {
+
+		while (true) {
+
+			const u32 sym = lit.decode(in);
+
+			if (sym < 256) {
+				out.push_back(u8(sym));
+				continue;
+			}
+
+			if (sym == 256)
+				return true;
+
+			if (sym > 285)
+				return false;
+
+			const usz len = lengthBase[sym - 257] + in.get(lengthExtra[sym - 257]);
+			const u32 d = dist.decode(in);
+
+			if (d > 29)
+				return false;
+
+			const usz distance = distanceBase[d] + in.get(distanceExtra[d]);
+
+			if (distance > out.size())
+				return false;
+
+			//Matches can overlap themselves, so they're copied a byte at a time
+
+			const usz start = out.size() - distance;
+			out.resize(out.size() + len);
+
+			u8 *dst = out.data() + out.size() - len;
+			const u8 *src = out.data() + start;
+
+			for (usz i = 0; i < len; ++i)
+				dst[i] = src[i];
+
+			if (in.isOverrun())
+				return false;
+		}
+	}
+
+	bool PNGHelper::inflate(const u8 *data, usz size, Buffer &out) {
+
+		//zlib header: deflate with a window of at most 32 KiB and no preset dictionary
+
+		if (size < 6 || (data[0] & 0xF) != 8 || (data[0] >> 4) > 7 || ((data[0] << 8) | data[1]) % 31 || (data[1] & 0x20))
+			return false;
+
+		const usz begin = out.size();
+		BitReader in(data + 2, size - 2);
+
+		Huffman lit, dist;
+		bool last = false;
+
+		while (!last) {
+
+			last = in.get(1);
+			const u32 type = in.get(2);
+
+			if (type == 0) {
+
+				const u8 *ptr = in.alignToByte();
+
+				if (in.remaining() < 4)
+					return false;
+
+				const u16 len = u16(ptr[0] | ptr[1] << 8), nlen = u16(ptr[2] | ptr[3] << 8);
+
+				if (len != u16(~nlen) || !in.skip(4) || in.remaining() < len)
+					return false;
+
+				out.insert(out.end(), ptr + 4, ptr + 4 + len);
+				in.skip(len);
+				continue;
+			}
+
+			u8 lengths[288 + 32];
+
+			if (type == 1) {
+
+				std::memset(lengths, 8, 144);
+				std::memset(lengths + 144, 9, 112);
+				std::memset(lengths + 256, 7, 24);
+				std::memset(lengths + 280, 8, 8);
+
+				if (!lit.build(lengths, 288))
+					return false;
+
+				std::memset(lengths, 5, 30);
+
+				if (!dist.build(lengths, 30))
+					return false;
+			}
+
+			else if (type == 2) {
+
+				const usz litCount = in.get(5) + 257, distCount = in.get(5) + 1, codeCount = in.get(4) + 4;
+
+				if (litCount > 286 || distCount > 30)
+					return false;
+
+				static constexpr u8 order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+				u8 codeLengths[19]{};
+
+				for (usz i = 0; i < codeCount; ++i)
+					codeLengths[order[i]] = u8(in.get(3));
+
+				Huffman codes;
+
+				if (!codes.build(codeLengths, 19))
+					return false;
+
+				//The lengths of both tables are one sequence; repeats can cross from one into the other
+
+				for (usz i = 0; i < litCount + distCount; ) {
+
+					const u32 sym = codes.decode(in);
+
+					if (sym < 16) {
+						lengths[i++] = u8(sym);
+						continue;
+					}
+
+					usz repeat;
+					u8 value = 0;
+
+					if (sym == 16) {
+
+						if (!i)
+							return false;
+
+						value = lengths[i - 1];
+						repeat = 3 + in.get(2);
+					}
+
+					else if (sym == 17)
+						repeat = 3 + in.get(3);
+
+					else if (sym == 18)
+						repeat = 11 + in.get(7);
+
+					else return false;
+
+					if (i + repeat > litCount + distCount)
+						return false;
+
+					std::memset(lengths + i, value, repeat);
+					i += repeat;
+				}
+
+				if (!lengths[256] || !lit.build(lengths, litCount) || !dist.build(lengths + litCount, distCount))
+					return false;
+			}
+
+			else return false;
+
+			if (!inflateBlock(in, lit, dist, out) || in.isOverrun())
+				return false;
+		}
+
+		//The Adler-32 of the decompressed data follows the last block
+
+		const u8 *adler = in.alignToByte();
+
+		if (in.remaining() < 4)
+			return false;
+
+		const u32 expected = u32(adler[0]) << 24 | u32(adler[1]) << 16 | u32(adler[2]) << 8 | adler[3];
+		return adler32(out.data() + begin, out.size() - begin) == expected;
+	}
+
+}
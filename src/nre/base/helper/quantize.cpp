@@ -0,0 +1,230 @@
+#include "helper/quantize.hpp"
+#include <algorithm>
+
+namespace nre {
+
+	void QuantizeHelper::toBGR5(const rgba8 *pixels, usz count, bgr5 *out) {
+
+		BGR5::toBGR5Image(pixels, out, count);
+
+		for (usz i = 0; i < count; ++i)
+			if (pixels[i].a < alphaThreshold)
+				out[i] = transparent;
+	}
+
+	//Every opaque bgr5 color and how often it's used; sorted by color
+
+	struct HistogramEntry {
+		bgr5 color;
+		u32 count;
+	};
+
+	static void getHistogram(const bgr5 *colors, usz count, List<HistogramEntry> &entries) {
+
+		List<u32> counts(0x8000);
+
+		for (usz i = 0; i < count; ++i)
+			if (colors[i] != QuantizeHelper::transparent)
+				++counts[colors[i]];
+
+		entries.clear();
+
+		for (usz i = 0; i < counts.size(); ++i)
+			if (counts[i])
+				entries.push_back(HistogramEntry{ bgr5(i), counts[i] });
+	}
+
+	static inline u32 component(bgr5 c, usz axis) {
+		return (c >> (axis * 5)) & 0x1F;
+	}
+
+	//Colors of the histogram in [beg, end>; the error is how far they are from their weighted mean (the summed variance of the axes)
+
+	struct Box {
+
+		usz beg, end;
+		u64 count, sum[3];
+		f64 error;
+		usz axis;				//Axis with the most variance, which is where the box is split
+
+		Box(const List<HistogramEntry> &entries, usz beg, usz end): beg(beg), end(end), count(), sum{}, error(), axis() {
+
+			f64 sumSq[3]{};
+
+			for (usz i = beg; i < end; ++i) {
+
+				count += entries[i].count;
+
+				for (usz k = 0; k < 3; ++k) {
+					const u64 v = component(entries[i].color, k);
+					sum[k] += v * entries[i].count;
+					sumSq[k] += f64(v * v * entries[i].count);
+				}
+			}
+
+			f64 most = -1;
+
+			for (usz k = 0; k < 3; ++k) {
+
+				const f64 variance = sumSq[k] - f64(sum[k]) * f64(sum[k]) / f64(count);
+				error += variance;
+
+				if (variance > most) {
+					most = variance;
+					axis = k;
+				}
+			}
+		}
+
+		inline bgr5 mean() const {
+
+			bgr5 res = 0;
+
+			for (usz k = 0; k < 3; ++k)
+				res |= bgr5(((sum[k] + count / 2) / count) << (k * 5));
+
+			return res;
+		}
+	};
+
+	void QuantizeHelper::createPalette(const rgba8 *pixels, usz count, usz maxColors, List<bgr5> &palette, usz iterations) {
+
+		maxColors = std::clamp(maxColors, usz(2), usz(256));
+
+		List<bgr5> colors(count);
+		toBGR5(pixels, count, colors.data());
+
+		List<HistogramEntry> entries;
+		getHistogram(colors.data(), count, entries);
+
+		palette.assign(1, 0);
+
+		if (entries.size() < maxColors) {
+
+			for (const HistogramEntry &e : entries)
+				palette.push_back(e.color);
+
+			return;
+		}
+
+		//Median cut; the box with the biggest error is split at the weighted median of its widest axis
+
+		List<Box> boxes{ Box(entries, 0, entries.size()) };
+
+		while (boxes.size() < maxColors - 1) {
+
+			usz pick = usz_MAX;
+
+			for (usz i = 0; i < boxes.size(); ++i)
+				if (boxes[i].end - boxes[i].beg > 1 && (pick == usz_MAX || boxes[i].error > boxes[pick].error))
+					pick = i;
+
+			if (pick == usz_MAX)
+				break;
+
+			const Box box = boxes[pick];
+
+			std::sort(entries.begin() + box.beg, entries.begin() + box.end, [axis = box.axis](const HistogramEntry &a, const HistogramEntry &b) {
+				const u32 ca = component(a.color, axis), cb = component(b.color, axis);
+				return ca != cb ? ca < cb : a.color < b.color;
+			});
+
+			usz split = box.beg + 1;
+			u64 below = entries[box.beg].count;
+
+			while (split + 1 < box.end && below * 2 < box.count)
+				below += entries[split++].count;
+
+			boxes[pick] = Box(entries, box.beg, split);
+			boxes.push_back(Box(entries, split, box.end));
+		}
+
+		for (const Box &box : boxes)
+			palette.push_back(box.mean());
+
+		//k-means on the unique colors, weighted by how often they're used; stops once no color moves
+
+		List<bgr5> unique(entries.size());
+		List<u8> nearest(entries.size());
+
+		for (usz i = 0; i < entries.size(); ++i)
+			unique[i] = entries[i].color;
+
+		const usz k = palette.size() - 1;
+		List<u64> sums(k * 4);
+
+		for (usz it = 0; it < iterations; ++it) {
+
+			BGR5::toNearest(unique.data(), nearest.data(), unique.size(), palette.data() + 1, k);
+
+			std::fill(sums.begin(), sums.end(), 0);
+
+			for (usz i = 0; i < entries.size(); ++i) {
+
+				u64 *sum = sums.data() + nearest[i] * 4;
+
+				for (usz c = 0; c < 3; ++c)
+					sum[c] += u64(component(entries[i].color, c)) * entries[i].count;
+
+				sum[3] += entries[i].count;
+			}
+
+			bool changed = false;
+
+			for (usz j = 0; j < k; ++j) {
+
+				const u64 *sum = sums.data() + j * 4;
+
+				if (!sum[3])
+					continue;
+
+				bgr5 mean = 0;
+
+				for (usz c = 0; c < 3; ++c)
+					mean |= bgr5(((sum[c] + sum[3] / 2) / sum[3]) << (c * 5));
+
+				changed |= mean != palette[j + 1];
+				palette[j + 1] = mean;
+			}
+
+			if (!changed)
+				break;
+		}
+	}
+
+	u64 QuantizeHelper::remap(const rgba8 *pixels, usz count, const bgr5 *palette, usz colors, r8 *indices) {
+
+		List<bgr5> pixelColors(count);
+		toBGR5(pixels, count, pixelColors.data());
+
+		if (colors < 2) {
+			std::fill(indices, indices + count, 0);
+			return 0;
+		}
+
+		List<HistogramEntry> entries;
+		getHistogram(pixelColors.data(), count, entries);
+
+		List<bgr5> unique(entries.size());
+		List<u8> nearest(entries.size());
+
+		for (usz i = 0; i < entries.size(); ++i)
+			unique[i] = entries[i].color;
+
+		BGR5::toNearest(unique.data(), nearest.data(), unique.size(), palette + 1, colors - 1);
+
+		List<u8> lut(0x8000);
+		u64 error{};
+
+		for (usz i = 0; i < entries.size(); ++i) {
+			lut[unique[i]] = u8(nearest[i] + 1);
+			error += u64(BGR5::distance(unique[i], palette[nearest[i] + 1])) * entries[i].count;
+		}
+
+		for (usz i = 0; i < count; ++i)
+			indices[i] = pixelColors[i] == transparent ? 0 : lut[pixelColors[i]];
+
+		return error;
+	}
+
+}
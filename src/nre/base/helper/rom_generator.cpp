@@ -0,0 +1,749 @@
+#include "helper/rom_generator.hpp"
+#include "helper/checksum.hpp"
+#include "types/archive.hpp"
+#include "types/image.hpp"
+#include "types/model.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <cstdio>
+
+namespace nre {
+
+	//Layout: header, arm9 (+ footer), arm7, overlay tables, FNT, FAT, banner and then the files in FAT order
+	//Everything starts at a multiple of romAlignment, like ndstool does it
+
+	static constexpr usz romAlignment = 0x200, headerSize = 0x4000, arm9Size = 0x1000, arm7Size = 0x800, paramsOffset = 0x800;
+	static constexpr u32 arm9Load = 0x02000000, arm7Load = 0x02380000, overlayLoad = 0x02100000;
+
+	static constexpr u16 tilesX = 32, tilesY = 24;
+	static constexpr usz tileDataSize = usz(tilesX) * tilesY * 32;
+
+	static inline usz alignRom(usz v) {
+		return (v + romAlignment - 1) & ~(romAlignment - 1);
+	}
+
+	static inline usz align4(usz v) {
+		return (v + 3) & ~usz(3);
+	}
+
+	//splitmix64; every file has its own stream, so its size is known without generating the files before it
+
+	struct Random {
+
+		u64 state;
+
+		Random(u64 seed, u64 stream): state(seed ^ (stream * 0xD1B54A32D192ED03)) {}
+
+		inline u64 next() {
+			u64 z = state += 0x9E3779B97F4A7C15;
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+			return z ^ (z >> 31);
+		}
+
+		inline void fill(u8 *out, usz size) {
+
+			for (usz i = 0; i + 8 <= size; i += 8) {
+				const u64 v = next();
+				std::memcpy(out + i, &v, 8);
+			}
+
+			const u64 v = next();
+			std::memcpy(out + (size & ~usz(7)), &v, size & 7);
+		}
+	};
+
+	enum GeneratedType : u8 {
+		GENERATED_OVERLAY,
+		GENERATED_ARCHIVE,
+		GENERATED_NCGR,
+		GENERATED_NCLR,
+		GENERATED_BTX0,
+		GENERATED_PLAIN
+	};
+
+	//Overlays, then archives, then pairs of NCGR and NCLR, then BTX0s and then plain files
+
+	static inline GeneratedType getType(const ROMShape &shape, u32 id) {
+
+		const u32 overlays = u32(shape.arm9Overlays) + shape.arm7Overlays;
+
+		if (id < overlays)
+			return GENERATED_OVERLAY;
+
+		id -= overlays;
+
+		if (id < shape.archives)
+			return GENERATED_ARCHIVE;
+
+		id -= shape.archives;
+
+		if (u64(id) < u64(shape.graphics) * 2)
+			return id & 1 ? GENERATED_NCLR : GENERATED_NCGR;
+
+		if (u64(id) - u64(shape.graphics) * 2 < shape.textures)
+			return GENERATED_BTX0;
+
+		return GENERATED_PLAIN;
+	}
+
+	static inline u32 getPlainSize(const ROMShape &shape, Random &random) {
+		return u32(shape.fileSize / 2 + random.next() % (u64(shape.fileSize) + 1));
+	}
+
+	//Files in an archive are smaller, so archives stay around the size of a few plain files
+
+	static inline u32 getArchiveFileSize(const ROMShape &shape, Random &random) {
+		return u32(random.next() % (u64(shape.fileSize) / 4 + 1));
+	}
+
+	static inline usz getArchiveHeaderSize(const ROMShape &shape) {
+		return sizeof(GenericHeader) + sizeof(BTAF) + usz(shape.archiveFiles) * 8 + sizeof(BTNF) + sizeof(FNTFolder) + sizeof(GMIF);
+	}
+
+	//BTX0s have a 64x64 texture of every format; all but the direct one have a palette named after it (+ "_pl").
+	//The layout doesn't depend on the seed, so without out this only returns the size.
+	//Items are read by index and name rather than through the tree of a dictionary, so its nodes are left 0.
+
+	static constexpr TextureFormat textureFormats[] = {
+		TEXTURE_A3I5, TEXTURE_4_COLORS, TEXTURE_16_COLORS, TEXTURE_256_COLORS, TEXTURE_4X4, TEXTURE_A5I3, TEXTURE_DIRECT
+	};
+
+	static constexpr const c8 *textureNames[] = { "a3i5", "4_colors", "16_colors", "256_colors", "4x4", "a5i3", "direct" };
+	static constexpr usz textureCount = sizeof(textureFormats) / sizeof(textureFormats[0]), texturePixels = 64 * 64;
+
+	//Colors of the palette; 4x4 blocks pick 2 or 4 of them
+	static constexpr usz texturePaletteColors[] = { 32, 4, 16, 256, 16, 8, 0 };
+
+	static constexpr usz getTexelSize(TextureFormat format) {
+		switch (format) {
+			case TEXTURE_4_COLORS:		return texturePixels / 4;
+			case TEXTURE_16_COLORS:		return texturePixels / 2;
+			case TEXTURE_4X4:			return texturePixels / 4;
+			case TEXTURE_DIRECT:		return texturePixels * 2;
+			default:					return texturePixels;
+		}
+	}
+
+	static constexpr usz align8(usz v) {
+		return (v + 7) & ~usz(7);
+	}
+
+	static usz generateTextures(Random &random, u8 *out) {
+
+		//Dictionaries with the same names; the data of a texture is its TextureParams, the one of a palette its offset >> 3
+
+		auto getDictionarySize = [](usz count) {
+			return sizeof(Dictionary) + count * 4 + sizeof(DictionaryData) + count * (4 + 16);
+		};
+
+		constexpr usz palettes = textureCount - 1;
+
+		const usz textureDict = sizeof(TEX0), paletteDict = textureDict + getDictionarySize(textureCount);
+		const usz textureData = align8(paletteDict + getDictionarySize(palettes));
+
+		usz textureOffsets[textureCount], paletteOffsets[palettes];
+		usz textureDataSize{}, compressedDataSize{}, paletteDataSize{};
+
+		for (usz i = 0; i < textureCount; ++i) {
+
+			usz &size = textureFormats[i] == TEXTURE_4X4 ? compressedDataSize : textureDataSize;
+			textureOffsets[i] = size;
+			size += getTexelSize(textureFormats[i]);
+
+			if (i < palettes) {
+				paletteOffsets[i] = paletteDataSize;
+				paletteDataSize += align8(texturePaletteColors[i] * sizeof(bgr5));
+			}
+		}
+
+		const usz compressedData = textureData + textureDataSize, compressedInfo = compressedData + compressedDataSize;
+		const usz paletteData = compressedInfo + compressedDataSize / 2, end = paletteData + paletteDataSize;
+		const usz tex0Offset = sizeof(GenericHeader) + sizeof(u32);
+
+		if (!out)
+			return tex0Offset + end;
+
+		GenericHeader header{ RESOURCE_BTX0, 0x0001FEFF, u32(tex0Offset + end), sizeof(GenericHeader), 1 };
+		std::memcpy(out, &header, sizeof(header));
+
+		const u32 sectionOffset = u32(tex0Offset);
+		std::memcpy(out + sizeof(header), &sectionOffset, sizeof(sectionOffset));
+
+		u8 *ptr = out + tex0Offset;
+
+		TEX0 tex0{};
+		tex0.type = SECTION_TEX0;
+		tex0.size = u32(end);
+		tex0.textureDataSize = u16(textureDataSize >> 3);
+		tex0.textureDictOffset = u16(textureDict);
+		tex0.textureDataOffset = u32(textureData);
+		tex0.compressedDataSize = u16(compressedDataSize >> 3);
+		tex0.compressedDictOffset = u16(textureDict);
+		tex0.compressedDataOffset = u32(compressedData);
+		tex0.compressedInfoOffset = u32(compressedInfo);
+		tex0.paletteDataSize = u32(paletteDataSize >> 3);
+		tex0.paletteDictOffset = u32(paletteDict);
+		tex0.paletteDataOffset = u32(paletteData);
+		std::memcpy(ptr, &tex0, sizeof(tex0));
+
+		auto writeDictionary = [&](usz offset, usz count, const c8 *suffix, auto getData) {
+
+			u8 *dict = ptr + offset;
+
+			const Dictionary head{ 0, u8(count), u16(getDictionarySize(count)), 8, u16(sizeof(Dictionary) + count * 4), 0x17F };
+			std::memcpy(dict, &head, sizeof(head));
+
+			u8 *data = dict + head.treeSize;
+
+			const DictionaryData info{ 4, u16(sizeof(DictionaryData) + count * 4) };
+			std::memcpy(data, &info, sizeof(info));
+
+			for (usz i = 0; i < count; ++i) {
+
+				const u32 item = getData(i);
+				std::memcpy(data + sizeof(info) + i * 4, &item, sizeof(item));
+
+				std::snprintf((c8*)(data + info.size + i * 16), 16, "%s%s", textureNames[i], suffix);
+			}
+		};
+
+		//64 = 8 << 3 in both directions
+
+		writeDictionary(textureDict, textureCount, "", [&](usz i) {
+			return u32(textureOffsets[i] >> 3) | (3 << 20) | (3 << 23) | (u32(textureFormats[i]) << 26) | (u32(i & 1) << 29);
+		});
+
+		writeDictionary(paletteDict, palettes, "_pl", [&](usz i) {
+			return u32(paletteOffsets[i] >> 3);
+		});
+
+		random.fill(ptr + textureData, textureDataSize + compressedDataSize);
+
+		//Palette offsets of 4x4 blocks are in pairs of colors from the palette of the texture;
+		//they have to leave room for the 4 colors a block can read
+
+		for (usz i = 0; i < compressedDataSize / 4; ++i) {
+			const u64 r = random.next();
+			const u16 info = u16((r & 0xC000) | ((r >> 16) % 7));
+			std::memcpy(ptr + compressedInfo + i * 2, &info, sizeof(info));
+		}
+
+		for (usz i = 0; i < paletteDataSize / 2; ++i) {
+			const bgr5 color = bgr5(random.next() & 0x7FFF);
+			std::memcpy(ptr + paletteData + i * 2, &color, sizeof(color));
+		}
+
+		return tex0Offset + end;
+	}
+
+	static u64 getFileSize(const ROMShape &shape, u32 id) {
+
+		Random random(shape.seed, id);
+
+		switch (getType(shape, id)) {
+
+			case GENERATED_OVERLAY:
+				return align4(getPlainSize(shape, random));
+
+			case GENERATED_ARCHIVE: {
+
+				u64 size = getArchiveHeaderSize(shape);
+
+				for (u16 i = 0; i < shape.archiveFiles; ++i)
+					size += align4(getArchiveFileSize(shape, random));
+
+				return size;
+			}
+
+			case GENERATED_NCGR:
+				return sizeof(GenericHeader) + sizeof(RAHC) + tileDataSize;
+
+			case GENERATED_NCLR:
+				return sizeof(GenericHeader) + sizeof(TTLP) + 16 * sizeof(bgr5);
+
+			case GENERATED_BTX0:
+				return generateTextures(random, nullptr);
+
+			default:
+				return getPlainSize(shape, random);
+		}
+	}
+
+	//Graphics have runs of the same index like real tiles; the rest is noise
+
+	static void generateFile(const ROMShape &shape, u32 id, Buffer &out) {
+
+		Random random(shape.seed, id);
+
+		switch (getType(shape, id)) {
+
+			case GENERATED_OVERLAY:
+				out.assign(align4(getPlainSize(shape, random)), 0);
+				random.fill(out.data(), out.size());
+				break;
+
+			case GENERATED_ARCHIVE: {
+
+				List<u32> sizes(shape.archiveFiles);
+				usz dataSize{};
+
+				for (u32 &size : sizes) {
+					size = getArchiveFileSize(shape, random);
+					dataSize += align4(size);
+				}
+
+				out.assign(getArchiveHeaderSize(shape) + dataSize, 0);
+				u8 *ptr = out.data();
+
+				GenericHeader header{ RESOURCE_NARC, 0x0100FFFE, u32(out.size()), sizeof(GenericHeader), 3 };
+				std::memcpy(ptr, &header, sizeof(header));
+				ptr += sizeof(header);
+
+				BTAF btaf{};
+				btaf.type = SECTION_BTAF;
+				btaf.size = u32(sizeof(BTAF) + sizes.size() * 8);
+				btaf.fileCount = shape.archiveFiles;
+				std::memcpy(ptr, &btaf, sizeof(btaf));
+				ptr += sizeof(btaf);
+
+				u32 offset{};
+
+				for (u32 size : sizes) {
+					const u32 range[2] = { offset, offset + size };
+					std::memcpy(ptr, range, sizeof(range));
+					ptr += sizeof(range);
+					offset += u32(align4(size));
+				}
+
+				//Without names; only the root folder, which has every file
+
+				BTNF btnf{};
+				btnf.type = SECTION_BTNF;
+				btnf.size = sizeof(BTNF) + sizeof(FNTFolder);
+				std::memcpy(ptr, &btnf, sizeof(btnf));
+				ptr += sizeof(btnf);
+
+				const FNTFolder root{ sizeof(FNTFolder), 0, 1 };
+				std::memcpy(ptr, &root, sizeof(root));
+				ptr += sizeof(root);
+
+				GMIF gmif{};
+				gmif.type = SECTION_GMIF;
+				gmif.size = u32(sizeof(GMIF) + dataSize);
+				std::memcpy(ptr, &gmif, sizeof(gmif));
+				ptr += sizeof(gmif);
+
+				for (u32 size : sizes) {
+					random.fill(ptr, size);
+					ptr += align4(size);
+				}
+
+				break;
+			}
+
+			case GENERATED_NCGR: {
+
+				out.assign(getFileSize(shape, id), 0);
+				u8 *ptr = out.data();
+
+				GenericHeader header{ RESOURCE_NCGR, 0x0101FEFF, u32(out.size()), sizeof(GenericHeader), 1 };
+				std::memcpy(ptr, &header, sizeof(header));
+				ptr += sizeof(header);
+
+				RAHC rahc{};
+				rahc.type = SECTION_RAHC;
+				rahc.size = u32(sizeof(RAHC) + tileDataSize);
+				rahc.tileHeight = tilesY;
+				rahc.tileWidth = tilesX;
+				rahc.tileDepth = 3;
+				rahc.tileDataSize = u32(tileDataSize);
+				rahc.unknown3 = 0x18;
+				std::memcpy(ptr, &rahc, sizeof(rahc));
+				ptr += sizeof(rahc);
+
+				for (usz i = 0; i < tileDataSize; ++i) {
+					const u8 index = u8(((i >> 5) + (i >> 9) + (random.next() % 7 == 0)) & 0xF);
+					ptr[i] = u8(index | index << 4);
+				}
+
+				break;
+			}
+
+			case GENERATED_NCLR: {
+
+				out.assign(getFileSize(shape, id), 0);
+				u8 *ptr = out.data();
+
+				GenericHeader header{ RESOURCE_NCLR, 0x0100FEFF, u32(out.size()), sizeof(GenericHeader), 1 };
+				std::memcpy(ptr, &header, sizeof(header));
+				ptr += sizeof(header);
+
+				TTLP ttlp{};
+				ttlp.type = SECTION_TTLP;
+				ttlp.size = u32(sizeof(TTLP) + 16 * sizeof(bgr5));
+				ttlp.bitDepth = 3;
+				ttlp.dataSize = 16 * sizeof(bgr5);
+				ttlp.colors = 0x10;
+				std::memcpy(ptr, &ttlp, sizeof(ttlp));
+				ptr += sizeof(ttlp);
+
+				for (usz i = 0; i < 16; ++i) {
+					const bgr5 color = bgr5(random.next() & 0x7FFF);
+					std::memcpy(ptr + i * sizeof(bgr5), &color, sizeof(color));
+				}
+
+				break;
+			}
+
+			case GENERATED_BTX0:
+				out.assign(generateTextures(random, nullptr), 0);
+				generateTextures(random, out.data());
+				break;
+
+			default:
+				out.assign(getPlainSize(shape, random), 0);
+				random.fill(out.data(), out.size());
+		}
+	}
+
+	//Names are unique through their index; the padding comes before the extension, so an NCGR and its NCLR keep the same stem
+
+	static inline u8 makeName(c8 *out, const c8 *prefix, u32 index, const c8 *extension, u8 length) {
+
+		usz len = usz(std::snprintf(out, 128, "%s_%05u", prefix, index));
+		const usz extensionLength = std::strlen(extension);
+
+		for (; len + extensionLength < length; ++len)
+			out[len] = c8('a' + len % 26);
+
+		std::memcpy(out + len, extension, extensionLength);
+		return u8(len + extensionLength);
+	}
+
+	//Folders are chains of depth folders; the first folder of a chain is in the root
+
+	static inline u16 getParent(const ROMShape &shape, u16 folder) {
+		return (folder - 1) % shape.depth ? u16(folder - 1) : 0;
+	}
+
+	struct Layout {
+
+		u32 overlays, fileCount;
+
+		Buffer fnt;
+		List<u32> fat;
+
+		usz arm9Offset, arm7Offset, overlay9Offset, overlay7Offset, fntOffset, fatOffset, bannerOffset;
+		u64 size;
+
+		//Returns false if the ROM doesn't fit in the 4 GiB the header can describe
+		bool build(const ROMShape &shape) {
+
+			overlays = u32(shape.arm9Overlays) + shape.arm7Overlays;
+			fileCount = overlays + shape.files;
+
+			const u16 folders = shape.folders;
+
+			List<List<u16>> children(folders);
+
+			for (u16 i = 1; i < folders; ++i)
+				children[getParent(shape, i)].push_back(i);
+
+			//The FNT files are spread evenly over the folders; ids are consecutive in folder order.
+			//If every id is used, a folder at the end without files stores 0x10000 as firstFilePosition, which wraps to 0
+
+			List<u32> firstFile(usz(folders) + 1);
+			firstFile[0] = overlays;
+
+			for (u16 i = 0; i < folders; ++i)
+				firstFile[i + 1] = firstFile[i] + shape.files / folders + (i < shape.files % folders);
+
+			fnt.assign(usz(folders) * sizeof(FNTFolder), 0);
+			c8 name[128];
+
+			for (u16 i = 0; i < folders; ++i) {
+
+				const FNTFolder folder{ u32(fnt.size()), u16(firstFile[i]), u16(i ? 0xF000 | getParent(shape, i) : folders) };
+				std::memcpy(fnt.data() + usz(i) * sizeof(FNTFolder), &folder, sizeof(folder));
+
+				for (u32 id = firstFile[i]; id < firstFile[i + 1]; ++id) {
+
+					const u32 index = id - overlays, graphics = index - shape.archives;
+					u8 len;
+
+					switch (getType(shape, id)) {
+						case GENERATED_ARCHIVE:		len = makeName(name, "narc", index, ".narc", shape.nameLength);		break;
+						case GENERATED_NCGR:		len = makeName(name, "gfx", graphics >> 1, ".ncgr", shape.nameLength);	break;
+						case GENERATED_NCLR:		len = makeName(name, "gfx", graphics >> 1, ".nclr", shape.nameLength);	break;
+						case GENERATED_BTX0:		len = makeName(name, "tex", graphics - shape.graphics * 2, ".nsbtx", shape.nameLength);	break;
+						default:					len = makeName(name, "file", index, ".bin", shape.nameLength);
+					}
+
+					fnt.push_back(len);
+					fnt.insert(fnt.end(), name, name + len);
+				}
+
+				for (u16 child : children[i]) {
+					const u8 len = makeName(name, "dir", child, "", shape.nameLength);
+					fnt.push_back(u8(0x80 | len));
+					fnt.insert(fnt.end(), name, name + len);
+					fnt.push_back(u8(child));
+					fnt.push_back(u8(0xF0 | (child >> 8)));
+				}
+
+				fnt.push_back(0);
+			}
+
+			arm9Offset = headerSize;
+			arm7Offset = alignRom(arm9Offset + arm9Size + 12);
+			overlay9Offset = alignRom(arm7Offset + arm7Size);
+			overlay7Offset = alignRom(overlay9Offset + usz(shape.arm9Overlays) * sizeof(OVTEntry));
+			fntOffset = alignRom(overlay7Offset + usz(shape.arm7Overlays) * sizeof(OVTEntry));
+			fatOffset = alignRom(fntOffset + fnt.size());
+			bannerOffset = alignRom(fatOffset + usz(fileCount) * 8);
+
+			size = alignRom(bannerOffset + sizeof(NDSBanner));
+			fat.resize(usz(fileCount) * 2);
+
+			for (u32 i = 0; i < fileCount; ++i) {
+
+				const u64 fileSize = getFileSize(shape, i);
+
+				if (size + fileSize > u32_MAX)
+					return false;
+
+				fat[usz(i) << 1] = u32(size);
+				fat[(usz(i) << 1) + 1] = u32(size + fileSize);
+
+				size = alignRom(usz(size + fileSize));
+			}
+
+			return size <= u32_MAX;
+		}
+	};
+
+	static inline bool isValidShape(const ROMShape &shape) {
+		return
+			shape.folders && shape.folders <= 0x1000 && shape.depth && shape.nameLength < 0x80 &&
+			u64(shape.files) + shape.arm9Overlays + shape.arm7Overlays <= 0x10000 &&
+			u64(shape.archives) + u64(shape.graphics) * 2 + shape.textures <= shape.files;
+	}
+
+	//Writes the ROM in order through put(data, size); returns false as soon as put does
+
+	template<typename Put>
+	static bool emit(const ROMShape &shape, const Layout &layout, const Put &put) {
+
+		u64 position{};
+
+		auto write = [&](const void *data, usz size) {
+			position += size;
+			return put(data, size);
+		};
+
+		static const u8 zeros[romAlignment]{};
+
+		auto padTo = [&](u64 offset) {
+
+			while (position < offset)
+				if (!write(zeros, usz(std::min(offset - position, u64(sizeof(zeros))))))
+					return false;
+
+			return true;
+		};
+
+		//Header
+
+		Buffer header(headerSize);
+		NDS &nds = *(NDS*) header.data();
+
+		std::memcpy(nds.title, "NRE SYNTHETI", 12);
+		std::memcpy(nds.gameCode, "NRES", 4);
+		std::memcpy(nds.makerCode, "01", 2);
+
+		while ((u64(0x20000) << nds.capacity) < layout.size)
+			++nds.capacity;
+
+		nds.arm9Offset = u32(layout.arm9Offset);
+		nds.arm9Entry = nds.arm9Load = arm9Load;
+		nds.arm9Size = u32(arm9Size);
+
+		nds.arm7Offset = u32(layout.arm7Offset);
+		nds.arm7Entry = nds.arm7Load = arm7Load;
+		nds.arm7Size = u32(arm7Size);
+
+		nds.fntOffset = u32(layout.fntOffset);
+		nds.fntSize = u32(layout.fnt.size());
+		nds.fatOffset = u32(layout.fatOffset);
+		nds.fatSize = layout.fileCount * 8;
+
+		if (shape.arm9Overlays) {
+			nds.arm9OverlayOffset = u32(layout.overlay9Offset);
+			nds.arm9OverlaySize = u32(shape.arm9Overlays * sizeof(OVTEntry));
+		}
+
+		if (shape.arm7Overlays) {
+			nds.arm7OverlayOffset = u32(layout.overlay7Offset);
+			nds.arm7OverlaySize = u32(shape.arm7Overlays * sizeof(OVTEntry));
+		}
+
+		nds.cardControl = 0x00586000;
+		nds.sCardControl = 0x001808F8;
+		nds.bannerOffset = u32(layout.bannerOffset);
+		nds.sALT = 0x051E;
+
+		nds.romSize = u32(layout.size);
+		nds.romHeaderSize = u32(headerSize);
+
+		nds.nLC = ChecksumHelper::crc16(nds.nLogo, sizeof(nds.nLogo));
+		nds.nHC = ChecksumHelper::crc16(&nds, offsetof(NDS, nHC));
+
+		if (!write(header.data(), header.size()))
+			return false;
+
+		//arm9.bin only has the module params, with the footer after it that points to them
+		//It starts like the secure area of a decrypted dump, so the ROM doesn't have a secure area checksum
+
+		Buffer code(arm9Size);
+
+		const u32 decryptedSecureArea[2] = { 0xE7FFDEFF, 0xE7FFDEFF };
+		std::memcpy(code.data(), decryptedSecureArea, sizeof(decryptedSecureArea));
+
+		ModuleParams params{};
+		params.staticBssStart = params.staticBssEnd = arm9Load + u32(arm9Size);
+		params.sdkVersion = 0x04000000;
+		params.nitroCodeBE = ModuleParams::nitroCode;
+		params.nitroCodeLE = ModuleParams::nitroCodeSwapped;
+		std::memcpy(code.data() + paramsOffset, &params, sizeof(params));
+
+		const u32 footer[3] = { ModuleParams::nitroCode, u32(paramsOffset), 0 };
+
+		if (!write(code.data(), code.size()) || !write(footer, sizeof(footer)) || !padTo(layout.arm7Offset))
+			return false;
+
+		code.assign(arm7Size, 0);
+
+		if (!write(code.data(), code.size()))
+			return false;
+
+		//Overlay tables; every overlay of a processor loads at the same address, like overlays that replace each other
+
+		for (u32 i = 0; i < layout.overlays; ++i) {
+
+			const bool isArm7 = i >= shape.arm9Overlays;
+			const u32 index = isArm7 ? i - shape.arm9Overlays : i;
+
+			if (!index && !padTo(isArm7 ? layout.overlay7Offset : layout.overlay9Offset))
+				return false;
+
+			const OVTEntry entry{
+				index,
+				isArm7 ? arm7Load + u32(arm7Size) : overlayLoad,
+				layout.fat[(usz(i) << 1) + 1] - layout.fat[usz(i) << 1],
+				0,
+				0, 0,
+				i,
+				0
+			};
+
+			if (!write(&entry, sizeof(entry)))
+				return false;
+		}
+
+		if (
+			!padTo(layout.fntOffset) || !write(layout.fnt.data(), layout.fnt.size()) ||
+			!padTo(layout.fatOffset) || !write(layout.fat.data(), layout.fat.size() * sizeof(u32)) ||
+			!padTo(layout.bannerOffset)
+		)
+			return false;
+
+		//Banner; the icon is a gradient of a random palette
+
+		Buffer bannerData(sizeof(NDSBanner));
+		NDSBanner &banner = *(NDSBanner*) bannerData.data();
+		Random random(shape.seed, u64(-1));
+
+		banner.Version = 1;
+
+		for (usz i = 0; i < 16; ++i)
+			banner.Palette[i] = bgr5(random.next() & 0x7FFF);
+
+		for (usz i = 0; i < sizeof(banner.Icon); ++i)
+			banner.Icon[i] = u8(((i >> 4) & 0xF) * 0x11);
+
+		for (usz i = 0; i < NDSBanner::LANGUAGE_END; ++i)
+			for (usz j = 0; j < sizeof(nds.title); ++j)
+				banner.titles[i][j] = c16(nds.title[j]);
+
+		banner.Checksum = ChecksumHelper::crc16(bannerData.data() + 0x20, 0x820);
+
+		if (!write(bannerData.data(), bannerData.size()))
+			return false;
+
+		//Files; only one is in memory at a time
+
+		Buffer file;
+
+		for (u32 i = 0; i < layout.fileCount; ++i) {
+
+			generateFile(shape, i, file);
+
+			if (!padTo(layout.fat[usz(i) << 1]) || !write(file.data(), file.size()))
+				return false;
+		}
+
+		return padTo(layout.size);
+	}
+
+	bool ROMGenerator::validate(const ROMShape &shape) {
+		return getSize(shape);
+	}
+
+	u64 ROMGenerator::getSize(const ROMShape &shape) {
+
+		Layout layout;
+
+		if (!isValidShape(shape) || !layout.build(shape))
+			return 0;
+
+		return layout.size;
+	}
+
+	bool ROMGenerator::write(const String &file, const ROMShape &shape) {
+
+		Layout layout;
+
+		if (!isValidShape(shape) || !layout.build(shape))
+			return false;
+
+		std::FILE *f = std::fopen(file.c_str(), "wb");
+
+		if (!f)
+			return false;
+
+		const bool success = emit(shape, layout, [f](const void *data, usz size) {
+			return std::fwrite(data, 1, size, f) == size;
+		});
+
+		return std::fclose(f) == 0 && success;
+	}
+
+	bool ROMGenerator::generate(const ROMShape &shape, Buffer &out) {
+
+		Layout layout;
+
+		if (!isValidShape(shape) || !layout.build(shape))
+			return false;
+
+		out.clear();
+		out.reserve(usz(layout.size));
+
+		return emit(shape, layout, [&out](const void *data, usz size) {
+			out.insert(out.end(), (const u8*) data, (const u8*) data + size);
+			return true;
+		});
+	}
+
+}
@@ -0,0 +1,103 @@
+#include "helper/rom_mapping.hpp"
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace nre {
+
+	#ifdef _WIN32
+
+		ROMMapping::ROMMapping(const String &path, Mode mode): mode(mode) {
+
+			file = CreateFileA(
+				path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+			);
+
+			if (file == INVALID_HANDLE_VALUE) {
+				file = nullptr;
+				throw std::runtime_error("Couldn't open ROM");
+			}
+
+			LARGE_INTEGER fileSize{};
+
+			if (!GetFileSizeEx(file, &fileSize) || !fileSize.QuadPart) {
+				CloseHandle(file);
+				throw std::runtime_error("Couldn't map an empty ROM");
+			}
+
+			length = usz(fileSize.QuadPart);
+
+			//Copy on write requires the mapping to be created as read only, but viewed with FILE_MAP_COPY
+
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+			if (!mapping) {
+				CloseHandle(file);
+				throw std::runtime_error("Couldn't create ROM mapping");
+			}
+
+			ptr = (u8*) MapViewOfFile(mapping, mode == COPY_ON_WRITE ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+
+			if (!ptr) {
+				CloseHandle(mapping);
+				CloseHandle(file);
+				throw std::runtime_error("Couldn't map ROM into memory");
+			}
+		}
+
+		ROMMapping::~ROMMapping() {
+			UnmapViewOfFile(ptr);
+			CloseHandle(mapping);
+			CloseHandle(file);
+		}
+
+	#else
+
+		ROMMapping::ROMMapping(const String &path, Mode mode): mode(mode) {
+
+			fd = open(path.c_str(), O_RDONLY);
+
+			if (fd < 0)
+				throw std::runtime_error("Couldn't open ROM");
+
+			struct stat st{};
+
+			if (fstat(fd, &st) || !st.st_size) {
+				close(fd);
+				throw std::runtime_error("Couldn't map an empty ROM");
+			}
+
+			length = usz(st.st_size);
+
+			//A private mapping of a read only file descriptor can still be written to; it just never gets flushed
+
+			void *res = mmap(
+				nullptr, length,
+				mode == COPY_ON_WRITE ? PROT_READ | PROT_WRITE : PROT_READ,
+				MAP_PRIVATE, fd, 0
+			);
+
+			if (res == MAP_FAILED) {
+				close(fd);
+				throw std::runtime_error("Couldn't map ROM into memory");
+			}
+
+			ptr = (u8*) res;
+		}
+
+		ROMMapping::~ROMMapping() {
+			munmap(ptr, length);
+			close(fd);
+		}
+
+	#endif
+
+}
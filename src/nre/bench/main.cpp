@@ -0,0 +1,754 @@
+#include "main.hpp"
+#include "helper/color.hpp"
+#include "helper/compression.hpp"
+#include "helper/model.hpp"
+#include "helper/nds_file_system.hpp"
+#include "helper/nds_file_table.hpp"
+#include "helper/png.hpp"
+#include "types/image.hpp"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <unordered_map>
+
+using namespace oic;
+using namespace nre;
+
+//Allocations of every thread are counted by replacing the global operator new
+//The array and nothrow versions forward to these, so they're counted as well
+//GCC can't see that the frees below pair with the malloc in operator new and warns about it
+
+static std::atomic<u64> allocations{}, allocatedBytes{};
+
+#if defined(__GNUC__) && !defined(__clang__)
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(std::size_t size) {
+
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+	if (void *ptr = std::malloc(size ? size : 1))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+	#pragma GCC diagnostic pop
+#endif
+
+//Results are written here, so the compiler can't drop the work of a stage
+
+static volatile u64 sink;
+
+//Runs func until minTime passed; the first run is a warm up (lookup tables, caches) and isn't measured
+
+template<typename Func>
+static BenchResult measure(const String &name, u64 ops, u64 bytes, usz minTime, const Func &func) {
+
+	using namespace std::chrono;
+	using clock = steady_clock;
+
+	func();
+
+	BenchResult res{ name, 0, ops, bytes, 0, 0, 0, 0 };
+
+	const u64 allocs = allocations.load(), allocBytes = allocatedBytes.load();
+	const clock::time_point start = clock::now(), end = start + milliseconds(minTime);
+	clock::time_point now;
+
+	do {
+		func();
+		++res.runs;
+		now = clock::now();
+	} while (now < end);
+
+	res.ns = u64(duration_cast<nanoseconds>(now - start).count());
+	res.allocations = allocations.load() - allocs;
+	res.allocatedBytes = allocatedBytes.load() - allocBytes;
+	return res;
+}
+
+//The library only compresses with LZ, so Huffman and RLE data for the decompression stages is encoded here
+
+static void putHeader(CompressionType type, usz size, Buffer &out) {
+	out.assign({ u8(type), u8(size), u8(size >> 8), u8(size >> 16) });
+}
+
+//Huffman with a fixed tree of 16 leaves that all have 4 bit codes; for 8 bit data, every byte has to be below 16
+
+static void encodeHuffman(const u8 *data, usz size, bool is4Bit, Buffer &out) {
+
+	putHeader(is4Bit ? COMPRESSION_HUFFMAN4 : COMPRESSION_HUFFMAN8, size, out);
+
+	//Nodes in breadth first order; node i has its children at 2i + 1 and 2i + 2, so the last 8 only have data
+
+	u8 tree[32];
+	tree[0] = 15;
+
+	for (usz i = 0; i < 15; ++i)
+		tree[1 + i] = u8((i >= 7 ? 0xC0 : 0) | (i * 2 - ((i + 1) & ~usz(1))) / 2);
+
+	for (usz i = 0; i < 16; ++i)
+		tree[16 + i] = u8(i);
+
+	out.insert(out.end(), tree, tree + sizeof(tree));
+
+	//Codes fill u32s from the most significant bit
+
+	u32 word{}, bits{};
+
+	auto put = [&](u8 code) {
+
+		word = word << 4 | code;
+		bits += 4;
+
+		if (bits == 32) {
+			out.insert(out.end(), (const u8*) &word, (const u8*) &word + 4);
+			word = bits = 0;
+		}
+	};
+
+	for (usz i = 0; i < size; ++i)
+		if (is4Bit) {
+			put(data[i] & 0xF);
+			put(data[i] >> 4);
+		}
+		else put(data[i]);
+
+	if (bits) {
+		word <<= 32 - bits;
+		out.insert(out.end(), (const u8*) &word, (const u8*) &word + 4);
+	}
+}
+
+static void encodeRLE(const u8 *data, usz size, Buffer &out) {
+
+	putHeader(COMPRESSION_RLE, size, out);
+
+	auto isRun = [&](usz i) {
+		return i + 2 < size && data[i] == data[i + 1] && data[i] == data[i + 2];
+	};
+
+	for (usz i = 0; i < size;) {
+
+		usz len = 0;
+
+		if (isRun(i)) {
+
+			while (i + len < size && len < 0x82 && data[i + len] == data[i])
+				++len;
+
+			out.push_back(u8(0x80 | (len - 3)));
+			out.push_back(data[i]);
+
+		} else {
+
+			while (i + len < size && len < 0x80 && !isRun(i + len))
+				++len;
+
+			out.push_back(u8(len - 1));
+			out.insert(out.end(), data + i, data + i + len);
+		}
+
+		i += len;
+	}
+}
+
+//Options with a value; values above max are invalid
+
+struct Option {
+	const c8 *name, *desc;
+	u64 max;
+	void (*set)(BenchConfig&, u64);
+};
+
+static const Option options[] = {
+	{ "seed", "Seed of the generated data", ~u64(), [](BenchConfig &c, u64 v) { c.shape.seed = v; } },
+	{ "files", "Files in the ROM, besides the overlays (at most 65536 together)", 0x10000, [](BenchConfig &c, u64 v) { c.shape.files = u32(v); } },
+	{ "folders", "Folders in the ROM (1-4096)", 0x1000, [](BenchConfig &c, u64 v) { c.shape.folders = u16(v); } },
+	{ "depth", "Depth of the folder chains under the root", 0xFFFF, [](BenchConfig &c, u64 v) { c.shape.depth = u16(v); } },
+	{ "name-length", "Length names are padded to (up to 127)", 127, [](BenchConfig &c, u64 v) { c.shape.nameLength = u8(v); } },
+	{ "file-size", "Average size of plain files in bytes", u32_MAX, [](BenchConfig &c, u64 v) { c.shape.fileSize = u32(v); } },
+	{ "arm9-overlays", "Overlays of the ARM9", 0xFFFF, [](BenchConfig &c, u64 v) { c.shape.arm9Overlays = u16(v); } },
+	{ "arm7-overlays", "Overlays of the ARM7", 0xFFFF, [](BenchConfig &c, u64 v) { c.shape.arm7Overlays = u16(v); } },
+	{ "archives", "Files that are NARCs", 0x10000, [](BenchConfig &c, u64 v) { c.shape.archives = u32(v); } },
+	{ "archive-files", "Files in every NARC", 0xFFFF, [](BenchConfig &c, u64 v) { c.shape.archiveFiles = u16(v); } },
+	{ "graphics", "256x192 4 bit NCGRs (with an NCLR each), converted and encoded as PNG", 0x8000, [](BenchConfig &c, u64 v) { c.shape.graphics = u32(v); } },
+	{ "textures", "BTX0s with a 64x64 texture of every format, decoded to RGBA8", 0x10000, [](BenchConfig &c, u64 v) { c.shape.textures = u32(v); } },
+	{ "min-time", "Milliseconds every stage runs for", u32_MAX, [](BenchConfig &c, u64 v) { c.minTime = usz(v); } }
+};
+
+inline int help() {
+
+	using namespace std;
+
+	cout << "Invalid usage of command" << endl;
+	cout << "Benchmarks the base library on a generated ROM; the options are:" << endl;
+
+	for (const Option &option : options)
+		cout << '-' << option.name << " N " << option.desc << endl;
+
+	cout << "-json PATH Writes the results as JSON, to compare runs; - writes to the console instead of the table" << endl;
+	cout << "-write PATH Only writes the generated ROM, for testing the cli at scale" << endl;
+
+	return 1;
+}
+
+int main(int argc, char *argv[]) {
+
+	using namespace std;
+
+	BenchConfig config;
+	config.shape.graphics = 64;
+	config.shape.textures = 16;
+
+	String json, write;
+
+	for (int i = 1; i < argc; ++i) {
+
+		if (argv[i][0] != '-' || i + 1 == argc)
+			return help();
+
+		const String arg = argv[i++] + 1;
+
+		if (arg == "json") {
+			json = argv[i];
+			continue;
+		}
+
+		if (arg == "write") {
+			write = argv[i];
+			continue;
+		}
+
+		bool isOption{};
+
+		for (const Option &option : options)
+			if (arg == option.name) {
+
+				c8 *end{};
+				const u64 value = u64(std::strtoull(argv[i], &end, 10));
+
+				if (*end || !*argv[i] || value > option.max)
+					return help();
+
+				option.set(config, value);
+				isOption = true;
+				break;
+			}
+
+		if (!isOption)
+			return help();
+	}
+
+	ROMShape &shape = config.shape;
+	shape.graphics = u32(std::min(u64(shape.graphics), (u64(shape.files) - std::min(u64(shape.archives), u64(shape.files))) / 2));
+	shape.textures = u32(std::min(u64(shape.textures), u64(shape.files) - std::min(u64(shape.archives) + u64(shape.graphics) * 2, u64(shape.files))));
+
+	if (!ROMGenerator::validate(shape)) {
+		cout << "ERROR: The ROM can't have this many files or folders, or would be larger than 4 GiB" << endl;
+		return help();
+	}
+
+	if (!write.empty()) {
+
+		if (!ROMGenerator::write(write, shape)) {
+			cout << "ERROR: Couldn't write \"" << write << "\"" << endl;
+			return 2;
+		}
+
+		cout << "Wrote a ROM of " << ROMGenerator::getSize(shape) << " bytes to \"" << write << "\"" << endl;
+		return 0;
+	}
+
+	Buffer rom;
+
+	if (!ROMGenerator::generate(shape, rom)) {
+		cout << "ERROR: Couldn't generate the ROM" << endl;
+		return 2;
+	}
+
+	NDS *nds = NDS::get(rom.data(), rom.size());
+
+	if (!nds) {
+		cout << "ERROR: The generated ROM isn't a valid NDS file" << endl;
+		return 2;
+	}
+
+	List<BenchResult> results;
+
+	try {
+
+		//Header validation
+
+		static constexpr u64 headerOps = 1024;
+
+		results.push_back(measure("NDS::get", headerOps, 0, config.minTime, [&]() {
+			for (u64 i = 0; i < headerOps; ++i)
+				sink = u64(usz(NDS::get(rom.data(), rom.size())));
+		}));
+
+		results.push_back(measure("NDS::invalid", headerOps, 0, config.minTime, [&]() {
+			for (u64 i = 0; i < headerOps; ++i)
+				sink = nds->invalid();
+		}));
+
+		//File system; this parses the FNT and FAT and builds the path index
+
+		results.push_back(measure("NDSFileSystem::NDSFileSystem", 1, nds->fntSize + nds->fatSize, config.minTime, [&]() {
+			NDSFileSystem fs(nds);
+			sink = fs.getVirtualFiles().size();
+		}));
+
+		//The lazy view that -info-folders uses; opening only checks the folder table, listing decodes every folder
+
+		results.push_back(measure("NDSFileTable::NDSFileTable", 1, 0, config.minTime, [&]() {
+			NDSFileTable table(nds);
+			sink = table.getFolderCount();
+		}));
+
+		results.push_back(measure("NDSFileTable::getEntries (all folders)", 1, nds->fntSize, config.minTime, [&]() {
+
+			NDSFileTable table(nds);
+
+			for (u16 i = 0; i < table.getFolderCount(); ++i)
+				sink = table.getEntries(i).size();
+		}));
+
+		NDSFileSystem fs(nds);
+
+		List<const FileInfo*> files;
+		List<const u8*> graphics;
+		List<const TEX0*> textures;
+		u64 fileBytes{};
+
+		for (const FileInfo &f : fs.getVirtualFiles())
+			if (!f.isFolder()) {
+
+				files.push_back(&f);
+				fileBytes += f.fileSize;
+
+				NCGR ncgr;
+
+				BTX0 btx0;
+
+				if (ncgr.parse((const u8*) f.dataExt, usz(f.fileSize)))
+					graphics.push_back(getSectionData(ncgr.get<RAHC>()));
+
+				else if (btx0.parse((const u8*) f.dataExt, usz(f.fileSize)))
+					textures.push_back(btx0.get<TEX0>());
+			}
+
+		//Reads go through the path lookup and NDSFile::read, like reads through oic do
+
+		Buffer buffer;
+
+		results.push_back(measure("NDSFile::read", files.size(), fileBytes, config.minTime, [&]() {
+			for (const FileInfo *f : files) {
+				fs.read(f->path, buffer);
+				sink = buffer.size();
+			}
+		}));
+
+		//Path lookups through the FNV index, against the map of paths -import-files used to build
+
+		results.push_back(measure("NDSFileIndex::find", files.size(), 0, config.minTime, [&]() {
+			for (const FileInfo *f : files)
+				sink = fs.getIndex().find(f->path);
+		}));
+
+		//Decoded folders are kept, so after the first run this only measures the search
+
+		NDSFileTable table(nds);
+
+		results.push_back(measure("NDSFileTable::find", files.size(), 0, config.minTime, [&]() {
+
+			NDSFileTable::Entry entry;
+
+			for (const FileInfo *f : files)
+				sink = table.find(f->path, entry) ? entry.id : u16_MAX;
+		}));
+
+		unordered_map<String, const FileInfo*> lookup;
+
+		for (const FileInfo &f : fs.getVirtualFiles())
+			lookup[f.path] = &f;
+
+		results.push_back(measure("unordered_map::find (paths)", files.size(), 0, config.minTime, [&]() {
+			for (const FileInfo *f : files)
+				sink = u64(usz(lookup.find(f->path)->second));
+		}));
+
+		//Color conversions of the graphics; throughput is of the input
+
+		static constexpr u16 w = 256, h = 192;
+		static constexpr usz pixels = usz(w) * h;
+
+		if (!graphics.empty()) {
+
+			const bgr5 *palette = nds->getBanner()->Palette;
+			const u64 count = graphics.size(), tileBytes = count * pixels / 2;
+
+			List<r8> indices(pixels * count);
+			List<bgr5> colors(pixels * count);
+			List<rgba8> rgba(pixels * count);
+
+			results.push_back(measure("R4_8::toR8Image", count, tileBytes, config.minTime, [&]() {
+				for (usz i = 0; i < count; ++i)
+					R4_8::toR8Image<true, true>(graphics[i], indices.data() + i * pixels, w, h);
+			}));
+
+			results.push_back(measure("R4_8::toBGR5Image", count, tileBytes, config.minTime, [&]() {
+				for (usz i = 0; i < count; ++i)
+					R4_8::toBGR5Image<true, true>(graphics[i], colors.data() + i * pixels, w, h, palette, 16);
+			}));
+
+			results.push_back(measure("R4_8::toRGBA8Image", count, tileBytes, config.minTime, [&]() {
+				for (usz i = 0; i < count; ++i)
+					R4_8::toRGBA8Image<true, true>(graphics[i], rgba.data() + i * pixels, w, h, palette, 16);
+			}));
+
+			results.push_back(measure("BGR5::toRGBA8Image", count, count * pixels * sizeof(bgr5), config.minTime, [&]() {
+				for (usz i = 0; i < count; ++i)
+					BGR5::toRGBA8Image(colors.data() + i * pixels, rgba.data() + i * pixels, pixels);
+			}));
+
+			results.push_back(measure("BGR5::toBGR5Image", count, count * pixels * sizeof(rgba8), config.minTime, [&]() {
+				for (usz i = 0; i < count; ++i)
+					BGR5::toBGR5Image(rgba.data() + i * pixels, colors.data() + i * pixels, pixels);
+			}));
+
+			//The dispatched kernels against the scalar ones and the lookup table
+
+			for (const ColorKernels *kernels : { &ColorKernels::scalar(), &ColorKernels::get() }) {
+
+				const String suffix = String(" (") + kernels->name + ")";
+
+				results.push_back(measure("ColorKernels::tilesToR8" + suffix, count, tileBytes, config.minTime, [&]() {
+					for (usz i = 0; i < count; ++i)
+						kernels->tilesToR8[true](graphics[i], indices.data() + i * pixels, w, h);
+				}));
+
+				results.push_back(measure("ColorKernels::tilesToRGBA8" + suffix, count, tileBytes, config.minTime, [&]() {
+					for (usz i = 0; i < count; ++i)
+						kernels->tilesToRGBA8[true](graphics[i], rgba.data() + i * pixels, w, h, palette);
+				}));
+
+				results.push_back(measure("ColorKernels::bgr5ToRGBA8" + suffix, count, count * pixels * sizeof(bgr5), config.minTime, [&]() {
+					for (usz i = 0; i < count; ++i)
+						kernels->bgr5ToRGBA8(colors.data() + i * pixels, rgba.data() + i * pixels, pixels);
+				}));
+			}
+
+			results.push_back(measure("ColorKernels::bgr5ToRGBA8Table", count, count * pixels * sizeof(bgr5), config.minTime, [&]() {
+				for (usz i = 0; i < count; ++i)
+					ColorKernels::bgr5ToRGBA8Table(colors.data() + i * pixels, rgba.data() + i * pixels, pixels);
+			}));
+
+			//PNG export, as -export-graphics does it (indexed) and with RGBA8 for images without a palette
+
+			Buffer png;
+
+			results.push_back(measure("PNGHelper::encode (indexed4)", count, count * pixels, config.minTime, [&]() {
+				for (usz i = 0; i < count; ++i) {
+					png.clear();
+					PNGHelper::encode(indices.data() + i * pixels, w, h, PNG_INDEXED4, png, palette, 16);
+					sink = png.size();
+				}
+			}));
+
+			results.push_back(measure("PNGHelper::encode (rgba8)", count, count * pixels * sizeof(rgba8), config.minTime, [&]() {
+				for (usz i = 0; i < count; ++i) {
+					png.clear();
+					PNGHelper::encode(rgba.data() + i * pixels, w, h, PNG_RGBA8, png);
+					sink = png.size();
+				}
+			}));
+
+			//RAHC decryption of the graphics, as -decrypt-graphics does it; it has to give back what was encrypted
+
+			const usz rahcCount = pixels / 4;
+
+			List<u16> plain(rahcCount * count), encrypted, decrypted(plain.size());
+
+			for (usz i = 0; i < count; ++i) {
+				std::memcpy(plain.data() + i * rahcCount, graphics[i], rahcCount * sizeof(u16));
+				plain[(i + 1) * rahcCount - 1] = 0;
+			}
+
+			encrypted = plain;
+
+			for (usz i = 0; i < count; ++i)
+				if (!CompressionHelper::encryptRAHC(encrypted.data() + i * rahcCount, rahcCount, u16(config.shape.seed + i))) {
+					cout << "ERROR: RAHC encryption refused valid data" << endl;
+					return 3;
+				}
+
+			results.push_back(measure("RandomStream::xorBackward (RAHC)", count, count * rahcCount * sizeof(u16), config.minTime, [&]() {
+				for (usz i = 0; i < count; ++i) {
+					const u16 *in = encrypted.data() + i * rahcCount;
+					CompressionHelper::RandomStream{ in[rahcCount - 1] }.xorBackward(in, decrypted.data() + i * rahcCount, rahcCount);
+				}
+			}));
+
+			if (decrypted != plain) {
+				cout << "ERROR: RAHC decryption didn't give back the encrypted data" << endl;
+				return 3;
+			}
+
+			//LZ compression of every graphic on its own, like files in a ROM are compressed
+
+			const usz tileSize = pixels / 2;
+
+			struct Compressed {
+				String name;
+				List<Buffer> data;
+				bool isIndices;				//Of the indices instead of the tiles
+			};
+
+			List<Compressed> compressed;
+			Buffer decompressed(pixels);
+
+			auto roundTrips = [&](const Compressed &c) {
+
+				const usz size = c.isIndices ? pixels : tileSize;
+
+				for (usz i = 0; i < count; ++i)
+					if (
+						!CompressionHelper::decompress(c.data[i].data(), c.data[i].size(), decompressed.data(), size) ||
+						std::memcmp(decompressed.data(), c.isIndices ? indices.data() + i * pixels : graphics[i], size)
+					)
+						return false;
+
+				return true;
+			};
+
+			for (CompressionType type : { COMPRESSION_LZ10, COMPRESSION_LZ11 })
+				for (CompressionLevel level : { COMPRESSION_FAST, COMPRESSION_SMALLEST }) {
+
+					const String name = String(CompressionHelper::getName(type)) + (level == COMPRESSION_FAST ? ", fast" : ", smallest");
+					Compressed c{ name, List<Buffer>(count), false };
+
+					BenchResult res = measure("CompressionHelper::compress (" + name + ")", count, count * tileSize, config.minTime, [&]() {
+						for (usz i = 0; i < count; ++i)
+							if (!CompressionHelper::compress(graphics[i], tileSize, type, c.data[i], level))
+								throw std::runtime_error("Couldn't compress with " + name);
+					});
+
+					u64 size{};
+
+					for (const Buffer &b : c.data)
+						size += b.size();
+
+					res.ratio = f64(size) / f64(count * tileSize);
+					results.push_back(res);
+
+					if (!roundTrips(c)) {
+						cout << "ERROR: " << name << " decompression didn't give back the compressed data" << endl;
+						return 3;
+					}
+
+					//Games store the smallest
+					if (level == COMPRESSION_SMALLEST)
+						compressed.push_back(std::move(c));
+				}
+
+			//Huffman 8 is of the indices, since the encoder only handles 16 symbols
+
+			compressed.push_back(Compressed{ CompressionHelper::getName(COMPRESSION_HUFFMAN4), List<Buffer>(count), false });
+			compressed.push_back(Compressed{ CompressionHelper::getName(COMPRESSION_HUFFMAN8), List<Buffer>(count), true });
+			compressed.push_back(Compressed{ CompressionHelper::getName(COMPRESSION_RLE), List<Buffer>(count), false });
+
+			const usz encoded = compressed.size() - 3;
+
+			for (usz i = 0; i < count; ++i) {
+				encodeHuffman(graphics[i], tileSize, true, compressed[encoded].data[i]);
+				encodeHuffman(indices.data() + i * pixels, pixels, false, compressed[encoded + 1].data[i]);
+				encodeRLE(graphics[i], tileSize, compressed[encoded + 2].data[i]);
+			}
+
+			//Decompression; throughput is of the output
+
+			for (const Compressed &c : compressed) {
+
+				if (!roundTrips(c)) {
+					cout << "ERROR: " << c.name << " decompression didn't give back the encoded data" << endl;
+					return 3;
+				}
+
+				const usz size = c.isIndices ? pixels : tileSize;
+
+				results.push_back(measure("CompressionHelper::decompress (" + c.name + ")", count, count * size, config.minTime, [&]() {
+					for (usz i = 0; i < count; ++i)
+						sink = CompressionHelper::decompress(c.data[i].data(), c.data[i].size(), decompressed.data(), size);
+				}));
+			}
+		}
+
+		//Textures, as -export-textures reads and decodes them; every texture has to be found with its palette
+
+		if (!textures.empty()) {
+
+			const u64 count = textures.size();
+			List<List<TextureEntry>> entries(count);
+
+			u64 textureCount{}, pixels{};
+
+			for (usz i = 0; i < count; ++i) {
+
+				if (!ModelHelper::getTextures(textures[i], entries[i]) || entries[i].size() != 7) {
+					cout << "ERROR: The textures of a generated BTX0 couldn't be read" << endl;
+					return 3;
+				}
+
+				for (const TextureEntry &tex : entries[i]) {
+
+					if (tex.format != TEXTURE_DIRECT && tex.palette != tex.name + "_pl") {
+						cout << "ERROR: Texture \"" << tex.name << "\" of a generated BTX0 didn't get its palette" << endl;
+						return 3;
+					}
+
+					pixels += usz(tex.w) * tex.h;
+				}
+
+				textureCount += entries[i].size();
+			}
+
+			List<TextureEntry> found;
+
+			results.push_back(measure("ModelHelper::getTextures", count, 0, config.minTime, [&]() {
+				for (const TEX0 *tex0 : textures) {
+					ModelHelper::getTextures(tex0, found);
+					sink = found.size();
+				}
+			}));
+
+			List<List<rgba8>> images;
+
+			results.push_back(measure("ModelHelper::toRGBA8Images", textureCount, pixels * sizeof(rgba8), config.minTime, [&]() {
+				for (usz i = 0; i < count; ++i)
+					if (ModelHelper::toRGBA8Images(textures[i], entries[i], images, 1) != entries[i].size())
+						throw std::runtime_error("Couldn't decode the textures of a generated BTX0");
+			}));
+		}
+
+	} catch (const std::runtime_error &e) {
+		cout << "ERROR: Couldn't benchmark the generated ROM" << endl << e.what() << endl;
+		return 3;
+	}
+
+	if (json == "-") {
+		printJson(config, results, cout);
+		return 0;
+	}
+
+	printResults(config, results, cout);
+
+	if (json.empty())
+		return 0;
+
+	ofstream out(json, ios::binary);
+
+	if (!out) {
+		cout << "ERROR: Couldn't write \"" << json << "\"" << endl;
+		return 4;
+	}
+
+	printJson(config, results, out);
+	return 0;
+}
+
+void printResults(const BenchConfig &config, const List<BenchResult> &results, std::ostream &out) {
+
+	using namespace std;
+
+	const ROMShape &shape = config.shape;
+
+	out << "Generated ROM with " << shape.files << " files (" << shape.archives << " archives, " << shape.graphics << " graphics, " << shape.textures << " textures) and ";
+	out << (u32(shape.arm9Overlays) + shape.arm7Overlays) << " overlays in " << shape.folders << " folders of depth " << shape.depth << endl;
+
+	out << left << setw(48) << "Stage" << right << setw(14) << "ns/op" << setw(12) << "MB/s" << setw(14) << "allocs/op" << setw(14) << "bytes/op" << setw(8) << "ratio" << endl;
+
+	for (const BenchResult &res : results) {
+
+		out << left << setw(48) << res.name << right << fixed << setprecision(1) << setw(14) << res.nsPerOp();
+
+		if (res.bytes)
+			out << setw(12) << res.mbPerSecond();
+		else
+			out << setw(12) << "-";
+
+		out << setprecision(2) << setw(14) << res.allocationsPerOp() << setprecision(0) << setw(14) << res.allocatedBytesPerOp();
+
+		if (res.ratio)
+			out << setprecision(3) << setw(8) << res.ratio << endl;
+		else
+			out << setw(8) << "-" << endl;
+	}
+}
+
+void printJson(const BenchConfig &config, const List<BenchResult> &results, std::ostream &out) {
+
+	using namespace std;
+
+	out << "{" << endl;
+	const ROMShape &shape = config.shape;
+
+	out << "\t\"config\": {" << endl;
+	out << "\t\t\"seed\": " << shape.seed << "," << endl;
+	out << "\t\t\"files\": " << shape.files << "," << endl;
+	out << "\t\t\"folders\": " << shape.folders << "," << endl;
+	out << "\t\t\"depth\": " << shape.depth << "," << endl;
+	out << "\t\t\"nameLength\": " << u32(shape.nameLength) << "," << endl;
+	out << "\t\t\"fileSize\": " << shape.fileSize << "," << endl;
+	out << "\t\t\"arm9Overlays\": " << shape.arm9Overlays << "," << endl;
+	out << "\t\t\"arm7Overlays\": " << shape.arm7Overlays << "," << endl;
+	out << "\t\t\"archives\": " << shape.archives << "," << endl;
+	out << "\t\t\"archiveFiles\": " << shape.archiveFiles << "," << endl;
+	out << "\t\t\"graphics\": " << shape.graphics << "," << endl;
+	out << "\t\t\"textures\": " << shape.textures << "," << endl;
+	out << "\t\t\"minTime\": " << config.minTime << endl;
+	out << "\t}," << endl;
+	out << "\t\"stages\": [" << endl;
+
+	//Names don't have quotes or backslashes, so they don't have to be escaped
+
+	for (usz i = 0; i < results.size(); ++i) {
+
+		const BenchResult &res = results[i];
+
+		out << "\t\t{" << endl;
+		out << "\t\t\t\"name\": \"" << res.name << "\"," << endl;
+		out << "\t\t\t\"runs\": " << res.runs << "," << endl;
+		out << "\t\t\t\"opsPerRun\": " << res.ops << "," << endl;
+		out << "\t\t\t\"bytesPerRun\": " << res.bytes << "," << endl;
+		out << "\t\t\t\"ns\": " << res.ns << "," << endl;
+		out << setprecision(3) << fixed;
+		out << "\t\t\t\"nsPerOp\": " << res.nsPerOp() << "," << endl;
+		out << "\t\t\t\"mbPerSecond\": " << res.mbPerSecond() << "," << endl;
+		out << "\t\t\t\"allocationsPerOp\": " << res.allocationsPerOp() << "," << endl;
+		out << "\t\t\t\"allocatedBytesPerOp\": " << res.allocatedBytesPerOp() << "," << endl;
+		out << "\t\t\t\"ratio\": " << res.ratio << endl;
+		out << "\t\t}" << (i + 1 == results.size() ? "" : ",") << endl;
+	}
+
+	out << "\t]" << endl;
+	out << "}" << endl;
+}
@@ -1,12 +1,31 @@
 #include "main.hpp"
 #include "helper/color.hpp"
 #include "helper/nds_file_system.hpp"
+#include "helper/nds_file_table.hpp"
+#include "helper/narc_file_system.hpp"
+#include "helper/rom_mapping.hpp"
+#include "helper/nds_repacker.hpp"
+#include "helper/parallel.hpp"
+#include "helper/graphics.hpp"
+#include "helper/compression.hpp"
+#include "helper/content_index.hpp"
+#include "helper/patch.hpp"
+#include "helper/checksum.hpp"
+#include "helper/hash.hpp"
+#include "helper/png.hpp"
+#include "helper/quantize.hpp"
+#include "helper/model.hpp"
 #include <system/local_file_system.hpp>
 #include <iostream>
+#include <sstream>
 #include <codecvt>
-
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb/stb_image_write.h"
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
 
 using namespace oic;
 using namespace nre;
@@ -23,11 +42,152 @@ inline int help() {
 	for (auto &flag : flags)
 		cout << '-' << flag.name << ' ' << flag.desc << endl;
 
+	cout << "-jobs N Processes N ROMs at the same time and shows a summary with the time taken per ROM" << endl;
+	cout << "Folders can be used instead of ROM paths; all .nds files in them are processed" << endl;
+
 	return 1;
 }
 
 void setupConsole();
 
+//How many threads a single ROM can use, so -jobs doesn't start hardware threads * jobs threads
+
+usz threadsPerRom = Parallel::hardwareThreads();
+
+//If file routines should go into NARCs (-walk-narc)
+
+bool walkArchives = false;
+
+//If graphics are encrypted (-decrypt-graphics); NCGRs don't store this, so it has to be known per title
+
+bool decryptGraphics = false;
+
+//Runs all flag routines on a single ROM; returns false if the ROM couldn't be processed
+
+bool processRom(const String &str, u64 flagValue, std::ostream &out) {
+
+	using namespace std;
+
+	//Map the ROM rather than reading it, so flags only load the pages they actually touch
+
+	unique_ptr<ROMMapping> rom;
+
+	try {
+		rom = make_unique<ROMMapping>(str);
+	} catch (std::runtime_error&) {
+		out << "WARNING: Couldn't read ROM at path \"" << str << "\"" << endl;
+		return false;
+	}
+
+	NDS *nds = NDS::get(rom->data(), rom->size());
+
+	if(!nds) {
+		out << "WARNING: File at \"" << str << "\" is not a valid NDS file" << endl;
+		return false;
+	}
+
+	bool success = true;
+
+	try {
+
+		NDSFileSystem fs(flagValue & EFlag::fileSystem ? nds : nullptr);
+
+		out << "-------\t" << str << "\t--------" << endl;
+
+		for (auto &flag : flags)
+			if (auto *routine = flag.routine)
+				if ((flagValue & flag.value) == flag.value)
+					if (routine(str, nds, &fs, out)) {
+						out << "WARNING: File at \"" << str << "\" had a flag routine interrupt the execution process" << endl;
+						success = false;
+						continue;
+					}
+
+		out << endl;
+
+	} catch (const std::runtime_error &e) {
+		out << "WARNING: File at \"" << str << "\" doesn't have a valid file system" << endl;
+		out << e.what() << endl;
+		return false;
+	}
+
+	return success;
+}
+
+//Runs the flags on every ROM; with -jobs multiple ROMs are processed at the same time
+
+int processRoms(const List<String> &paths, u64 flagValue, usz jobs) {
+
+	using namespace std;
+
+	//Without -jobs we can just stream everything to the console
+
+	if (!jobs) {
+
+		bool failed{};
+
+		for (const String &str : paths)
+			failed |= !processRom(str, flagValue, cout);
+
+		return failed ? 1 : 0;
+	}
+
+	//Every ROM gets its own output buffer, which is printed in one go when it's done,
+	//so the blocks of different ROMs never interleave
+
+	struct ROMResult {
+		f64 ms;
+		bool success;
+	};
+
+	List<ROMResult> results(paths.size());
+	mutex outputMutex;
+
+	const auto start = chrono::high_resolution_clock::now();
+
+	Parallel::forEach(paths.size(), jobs, [&](usz i) {
+
+		ostringstream out;
+
+		const auto romStart = chrono::high_resolution_clock::now();
+		bool success = processRom(paths[i], flagValue, out);
+		const auto romEnd = chrono::high_resolution_clock::now();
+
+		results[i] = { chrono::duration<f64, milli>(romEnd - romStart).count(), success };
+
+		lock_guard<mutex> lock(outputMutex);
+		cout << out.str() << flush;
+	});
+
+	const f64 total = chrono::duration<f64, milli>(chrono::high_resolution_clock::now() - start).count();
+
+	//Summary
+
+	usz failed{};
+	f64 summed{};
+
+	cout << "-------\tSummary\t--------" << endl;
+
+	for (usz i = 0; i < paths.size(); ++i) {
+
+		const ROMResult &res = results[i];
+
+		cout << paths[i] << ": " << res.ms << " ms" << (res.success ? "" : " (failed)") << endl;
+
+		summed += res.ms;
+		failed += !res.success;
+	}
+
+	cout
+		<< endl
+		<< "Processed " << paths.size() << " ROM" << (paths.size() == 1 ? "" : "s")
+		<< " with " << jobs << " job" << (jobs == 1 ? "" : "s") << " in " << total << " ms" << endl
+		<< "Failed: " << failed << endl
+		<< "Time spent on ROMs: " << summed << " ms" << endl;
+
+	return failed ? 1 : 0;
+}
+
 int main(int argc, char *argv[]) {
 
 	setupConsole();
@@ -37,11 +197,28 @@ int main(int argc, char *argv[]) {
 
 	List<String> paths;
 	u64 flagValue{};
+	usz jobs{};
 
 	for (int i = 1; i < argc; ++i) {
 
 		if (argv[i][0] == '-') {
 
+			//-jobs is the only flag that takes a value
+
+			if (String(argv[i]) == "-jobs") {
+
+				if (i + 1 == argc)
+					return help();
+
+				c8 *end{};
+				jobs = usz(std::strtoull(argv[++i], &end, 10));
+
+				if (!jobs || *end)
+					return help();
+
+				continue;
+			}
+
 			bool isFlag{};
 
 			for (auto &flag : flags)
@@ -58,56 +235,54 @@ int main(int argc, char *argv[]) {
 
 			String path = argv[i];
 
-			if (!System::files()->regionExists(path, 1, 0))
-				return help();
+			//Folders are searched for ROMs, so a whole collection can be processed at once
 
-			paths.push_back(path);
-		}
-	}
+			std::error_code err;
 
-	for (const String &str : paths) {
+			if (std::filesystem::is_directory(path, err)) {
 
-		using namespace std;
+				namespace fsys = std::filesystem;
 
-		Buffer rom;
-		if (!System::files()->read(str, rom)) {
-			cout << "WARNING: Couldn't read ROM at path \"" << str << "\"" << endl;
-			continue;
-		}
+				for (auto it = fsys::recursive_directory_iterator(path, err); !err && it != fsys::recursive_directory_iterator(); it.increment(err))
+					if (it->is_regular_file(err) && it->path().extension() == ".nds")
+						paths.push_back(it->path().generic_string());
 
-		u8* const romPtr = rom.data();
-		const usz romSize = rom.size();
+				continue;
+			}
 
-		NDS *nds = NDS::get(romPtr, romSize);
+			if (!System::files()->regionExists(path, 1, 0))
+				return help();
 
-		if(!nds) {
-			cout << "WARNING: File at \"" << str << "\" is not a valid NDS file" << endl;
-			continue;
+			paths.push_back(path);
 		}
+	}
 
-		try {
+	if ((flagValue & EFlag::repack) & ((flagValue & EFlag::repack) - 1)) {
+		std::cout << "ERROR: -import-files, -import-graphics and -import-arm9 all write ./rom_repacked.nds, so only one can be used at a time" << std::endl;
+		return 1;
+	}
 
-			NDSFileSystem fs(nds);
+	walkArchives = flagValue & EFlag::walkArchives;
+	decryptGraphics = flagValue & EFlag::decryptGraphics;
 
-			cout << "-------\t" << str << "\t--------" << endl;
+	if (jobs)
+		threadsPerRom = std::max(usz(1), Parallel::hardwareThreads() / jobs);
 
-			for (auto &flag : flags)
-				if (auto *routine = flag.routine)
-					if ((flagValue & flag.value) == flag.value)
-						if (routine(str, nds, &fs)) {
-							cout << "WARNING: File at \"" << str << "\" had a flag routine interrupt the execution process" << endl;
-							continue;
-						}
+	//-diff and -icon-atlas work on all ROMs at once and run after the other flags,
+	//so -diff can use the indices of -index-files
 
-			cout << endl;
+	int result = 0;
 
-		} catch (std::runtime_error e) {
-			cout << "WARNING: File at \"" << str << "\" doesn't have a valid file system" << endl;
-			cout << e.what() << endl;
-		}
-	}
+	if (flagValue & ~EFlag::collection)
+		result = processRoms(paths, flagValue, jobs);
 
-	return 0;
+	if (flagValue & EFlag::diffFiles)
+		result |= diffFiles(paths, jobs, std::cout);
+
+	if (flagValue & EFlag::iconAtlas)
+		result |= iconAtlas(paths, jobs, std::cout);
+
+	return result;
 }
 
 inline String toUTF8(const WString &wstr) {
@@ -115,46 +290,101 @@ inline String toUTF8(const WString &wstr) {
 	return wstring_convert<codecvt_utf8<wchar_t>>().to_bytes(wstr);
 }
 
+//Names in the FNT (or a NARC) can be any bytes, so paths made from them are checked before they're used as local paths;
+//"..", empty names and Windows separators or drives would write outside of the export folder
+
+inline bool isSafePath(const String &path) {
+
+	usz beg = 0;
+
+	do {
+
+		const usz end = std::min(path.find('/', beg), path.size());
+		const String name = path.substr(beg, end - beg);
+
+		if (name.empty() || name == "." || name == ".." || name.find_first_of("\\:") != String::npos)
+			return false;
+
+		beg = end + 1;
+
+	} while (beg <= path.size());
+
+	return true;
+}
+
 //Helper functions for adding files and encoding data
+//The file system isn't thread safe, so adding files and folders is done by one ROM at a time;
+//writing them afterwards goes straight to the local file, so that isn't serialized
 
-inline int makeFile(const String &path, String &file, bool isFolder = false) {
+std::mutex fileMutex;
+
+inline int makeFile(const String &path, String &file, std::ostream &out, bool isFolder = false) {
 
 	using namespace std;
 
 	const String &base = path.substr(0, path.find_last_of('.'));
 	file = base + "/" + file;
 
+	lock_guard<mutex> lock(fileMutex);
+
 	if (!System::files()->add(file, isFolder)) {
-		cout << "ERROR: Couldn't add subdir \"" << base << "\"" << endl;
+		out << "ERROR: Couldn't add subdir \"" << base << "\"" << endl;
 		return 1;
 	}
 
 	return 0;
 }
 
-inline Buffer encodePng(const List<r8> &colors, u16 w, u16 h) {
-	int len{};
-	u8 *dat = stbi_write_png_to_mem(colors.data(), 0, w, h, 1, &len);
-	Buffer res(dat, dat + len);
-	free(dat);
-	return res;
+//Output that's derived from the files (graphics, textures, overlays) goes next to the export folder (./rom.graphics),
+//so -import-files never mistakes it for files of the rom, whatever folders the rom has
+
+inline String getDerivedFolder(const String &path, const c8 *name) {
+	return path.substr(0, path.find_last_of('.')) + "." + name;
 }
 
-inline Buffer encodePng(const List<rgba8> &colors, u16 w, u16 h) {
-	int len{};
-	u8 *dat = stbi_write_png_to_mem((u8*)colors.data(), 0, w, h, 4, &len);
-	Buffer res(dat, dat + len);
-	free(dat);
-	return res;
+//Writes data straight to a local file that's not tracked by the file system
+//This is safe to call from multiple threads, as long as the folder already exists
+
+inline bool writeFile(const String &file, const void *data, usz size) {
+
+	std::FILE *f = std::fopen(file.c_str(), "wb");
+
+	if (!f)
+		return false;
+
+	//Skip the stdio buffer; the data is already in memory, so it would only be an extra copy
+
+	std::setvbuf(f, nullptr, _IONBF, 0);
+
+	bool success = !size || std::fwrite(data, 1, size, f) == size;
+	return !std::fclose(f) && success;
+}
+
+//Encodes and writes a PNG straight to a local file; safe to call from multiple threads once the folder exists
+
+inline bool writePng(const String &file, const List<r8> &colors, u16 w, u16 h) {
+	return PNGHelper::write(file, colors.data(), w, h, PNG_R8);
+}
+
+inline bool writePng(const String &file, const List<rgba8> &colors, u16 w, u16 h) {
+	return PNGHelper::write(file, colors.data(), w, h, PNG_RGBA8);
+}
+
+//Palette indices with their bgr5 palette; stored as 4-bit if the palette allows it
+
+inline bool writePng(const String &file, const List<r8> &indices, u16 w, u16 h, const bgr5 *palette, usz colors) {
+	return PNGHelper::write(
+		file, indices.data(), w, h, colors <= 16 ? PNG_INDEXED4 : PNG_INDEXED8, palette, u16(colors)
+	);
 }
 
 //Implementations of flags
 
-int infoBasics(const String&, NDS *nds, FileSystem*) {
+int infoBasics(const String&, NDS *nds, FileSystem*, std::ostream &out) {
 
 	using namespace std;
 
-	cout
+	out
 		<< "-------\tROM header base\t--------" << endl
 		<< "Game title: " << nds->title << endl
 		<< "Game code: " << String(nds->gameCode, nds->gameCode + 4) << endl
@@ -163,7 +393,7 @@ int infoBasics(const String&, NDS *nds, FileSystem*) {
 		<< "Unit code: " << u32(nds->unitCode) << endl
 		<< "Localized names: " << endl;
 
-	NDSBanner *banner = NDSBanner::get(nds);
+	NDSBanner *banner = nds->getBanner();
 
 	const char *languages[] = {
 		"Japanese",
@@ -176,11 +406,11 @@ int infoBasics(const String&, NDS *nds, FileSystem*) {
 
 	for(u8 l = NDSBanner::LANGUAGE_START; l != NDSBanner::LANGUAGE_END; ++l)
 		if (banner->hasTitle(NDSBanner::Language(l)))
-			cout << "\t" << languages[l] << ": " << toUTF8(banner->getTitle(NDSBanner::Language(l))) << endl;
+			out << "\t" << languages[l] << ": " << toUTF8(banner->getTitle(NDSBanner::Language(l))) << endl;
 
-	cout << endl;
+	out << endl;
 
-	cout
+	out
 		<< "-------\tROM header advanced\t--------" << endl
 		<< "Encryption seed: " << u32(nds->encryptionSeed) << endl
 		<< "Capacity: " << u32(nds->capacity) << endl
@@ -195,11 +425,11 @@ int infoBasics(const String&, NDS *nds, FileSystem*) {
 	return 0;
 }
 
-int infoLocations(const String&, NDS *nds, FileSystem*) {
+int infoLocations(const String&, NDS *nds, FileSystem*, std::ostream &out) {
 
 	using namespace std;
 
-	cout
+	out
 		<< "-------\tROM header locations\t--------" << endl
 
 		<< "ARM9 Binary: [0x" << Log::num<16>(nds->arm9Load) << ", 0x" << Log::num<16>(nds->arm9Load + nds->arm9Size) << ">" << endl
@@ -229,224 +459,1954 @@ int infoLocations(const String&, NDS *nds, FileSystem*) {
 	return 0;
 }
 
-int exportIcon(const String &path, NDS *nds, FileSystem*) {
+int exportIcon(const String &path, NDS *nds, FileSystem*, std::ostream &out) {
 
 	String file = "icon.png";
-	if (int ret = makeFile(path, file)) return ret;
+	if (int ret = makeFile(path, file, out)) return ret;
 
-	NDSBanner *banner = NDSBanner::get(nds);
+	NDSBanner *banner = nds->getBanner();
 
-	List<rgba8> col(32 * 32);
-	R4_8::toRGBA8Image<true, true>(banner->icon, col.data(), 32, 32, banner->palette);
-
-	List<u8> buffer = encodePng(col, 32, 32);
+	List<r8> col(32 * 32);
+	R4_8::toR8Image<true, true>(banner->Icon, col.data(), 32, 32);
 
-	if (!System::files()->write(file, buffer))
+	if (!writePng(file, col, 32, 32, banner->Palette, 16))
 		return 2;
 
 	return 0;
 }
 
-int exportIconPalette(const String &path, NDS *nds, FileSystem*) {
+int exportIconPalette(const String &path, NDS *nds, FileSystem*, std::ostream &out) {
 
 	String file = "icon_palette.png";
-	if (int ret = makeFile(path, file)) return ret;
+	if (int ret = makeFile(path, file, out)) return ret;
 
-	NDSBanner *banner = NDSBanner::get(nds);
+	NDSBanner *banner = nds->getBanner();
 
 	List<rgba8> col(16);
-	BGR5::toRGBA8Image(banner->palette, col.data(), 16);
+	BGR5::toRGBA8Image(banner->Palette, col.data(), 16);
 
-	List<u8> buffer = encodePng(col, 16, 1);
-
-	if (!System::files()->write(file, buffer))
+	if (!writePng(file, col, 16, 1))
 		return 2;
 
 	return 0;
 }
 
-int exportIconTilemap(const String &path, NDS *nds, FileSystem*) {
+int exportIconTilemap(const String &path, NDS *nds, FileSystem*, std::ostream &out) {
 
 	String file = "icon_tilemap.png";
-	if (int ret = makeFile(path, file)) return ret;
+	if (int ret = makeFile(path, file, out)) return ret;
 
-	NDSBanner *banner = NDSBanner::get(nds);
+	NDSBanner *banner = nds->getBanner();
 
 	List<r8> col(32 * 32);
-	R4_8::toR8Image<true, true>(banner->icon, col.data(), 32, 32);
-
-	List<u8> buffer = encodePng(col, 32, 32);
+	R4_8::toR8Image<true, true>(banner->Icon, col.data(), 32, 32);
 
-	if (!System::files()->write(file, buffer))
+	if (!writePng(file, col, 32, 32))
 		return 2;
 
 	return 0;
 }
 
-int exportArm9Bin(const String &path, NDS *nds, FileSystem*) {
+int exportArm9Bin(const String &path, NDS *nds, FileSystem*, std::ostream &out) {
 
 	if(nds->arm9Size){
 
 		String file = "arm9.bin";
-		if (int ret = makeFile(path, file)) return ret;
+		if (int ret = makeFile(path, file, out)) return ret;
 
-		System::files()->write(
-			file, Buffer((u8*)nds + nds->arm9Offset, (u8*)nds + nds->arm9Offset + nds->arm9Size)
-		);
+		writeFile(file, (u8*)nds + nds->arm9Offset, nds->arm9Size);
 	}
 
 	return 0;
 }
 
-int exportArm7Bin(const String &path, NDS *nds, FileSystem*) {
+int exportArm7Bin(const String &path, NDS *nds, FileSystem*, std::ostream &out) {
 
 	if(nds->arm7Size){
 
 		String file = "arm7.bin";
-		if (int ret = makeFile(path, file)) return ret;
+		if (int ret = makeFile(path, file, out)) return ret;
 
-		System::files()->write(
-			file, Buffer((u8*)nds + nds->arm7Offset, (u8*)nds + nds->arm7Offset + nds->arm7Size)
-		);
+		writeFile(file, (u8*)nds + nds->arm7Offset, nds->arm7Size);
 	}
 
 	return 0;
 }
 
-int exportArm9Overlay(const String &path, NDS *nds, FileSystem*) {
+//Exports the overlay table of a CPU as is, and every overlay of it decompressed (./rom.overlay9/overlay9_0000.bin)
 
-	if(nds->arm9OverlaySize){
+inline int exportOverlays(const String &path, NDS *nds, FileSystem *fs, bool isArm7, std::ostream &out) {
 
-		String file = "arm9_overlay.bin";
-		if (int ret = makeFile(path, file)) return ret;
+	using namespace std;
+
+	const u32 offset = isArm7 ? nds->arm7OverlayOffset : nds->arm9OverlayOffset;
+	const u32 size = isArm7 ? nds->arm7OverlaySize : nds->arm9OverlaySize;
+
+	if (!size)
+		return 0;
+
+	String file = isArm7 ? "arm7_overlay.bin" : "arm9_overlay.bin";
+	if (int ret = makeFile(path, file, out)) return ret;
+
+	writeFile(file, (u8*)nds + offset, size);
+
+	//The table is exported as is, even if the file system is broken, so the file system is only parsed here
+	//if no other flag needed it; an invalid one only skips the decompressed overlays
+
+	unique_ptr<NDSFileSystem> parsed;
+	const NDSFileSystem *nfsPtr = (const NDSFileSystem*)fs;
+
+	if (fs->getVirtualFiles().empty()) {
+
+		try {
+			parsed = make_unique<NDSFileSystem>(nds);
+			nfsPtr = parsed.get();
+		} catch (const std::runtime_error &e) {
+			out << "WARNING: Couldn't parse the overlays, so only the overlay table is exported; " << e.what() << endl;
+			return 0;
+		}
+	}
+
+	const NDSFileSystem &nfs = *nfsPtr;
+	const List<NDSFileSystem::Overlay> &overlays = nfs.getOverlays();
+
+	const String folder = getDerivedFolder(path, isArm7 ? "overlay7" : "overlay9");
+
+	error_code err;
+
+	if (!filesystem::create_directories(folder, err) && err) {
+		out << "ERROR: Couldn't add subdir \"" << folder << "\"" << endl;
+		return 1;
+	}
+
+	//Overlays are decompressed in parallel; writing is straight to the local files, so that's safe as well
+
+	atomic<usz> failed{ usz_MAX }, invalid{ usz_MAX };
+
+	Parallel::forEach(overlays.size(), threadsPerRom, [&](usz i) {
+
+		const NDSFileSystem::Overlay &overlay = overlays[i];
+
+		if (overlay.isArm7 != isArm7)
+			return;
+
+		const u8 *data;
+		usz dataSize;
+
+		if (!nfs.getOverlayData(i, data, dataSize)) {
+			invalid = i;
+			return;
+		}
+
+		if (!writeFile(folder + "/" + overlay.file.name, data, dataSize))
+			failed = i;
+	});
+
+	if (invalid != usz_MAX)
+		out << "WARNING: Couldn't decompress \"" << overlays[invalid].file.name << "\"" << endl;
+
+	if (failed != usz_MAX) {
+		out << "ERROR: Couldn't write file \"" << folder << "/" << overlays[failed].file.name << "\"" << endl;
+		return 2;
+	}
+
+	return 0;
+}
+
+int exportArm9Overlay(const String &path, NDS *nds, FileSystem *fs, std::ostream &out) {
+	return exportOverlays(path, nds, fs, false, out);
+}
+
+int exportArm7Overlay(const String &path, NDS *nds, FileSystem *fs, std::ostream &out) {
+	return exportOverlays(path, nds, fs, true, out);
+}
+
+int exportArm9Decompressed(const String &path, NDS *nds, FileSystem *fs, std::ostream &out) {
+
+	if (!nds->arm9Size)
+		return 0;
 
-		System::files()->write(
-			file,  Buffer((u8*)nds + nds->arm9OverlayOffset, (u8*)nds + nds->arm9OverlayOffset + nds->arm9OverlaySize)
-		);
+	const u8 *data;
+	usz size;
+
+	if (!((const NDSFileSystem*)fs)->getArm9Data(data, size)) {
+		out << "ERROR: Couldn't decompress the arm9 binary" << std::endl;
+		return 1;
 	}
 
+	String file = "arm9_decompressed.bin";
+	if (int ret = makeFile(path, file, out)) return ret;
+
+	writeFile(file, data, size);
 	return 0;
 }
 
-int exportArm7Overlay(const String &path, NDS *nds, FileSystem*) {
+int infoOverlays(const String&, NDS*, FileSystem *fs, std::ostream &out) {
+
+	using namespace std;
+
+	const List<NDSFileSystem::Overlay> &overlays = ((const NDSFileSystem*)fs)->getOverlays();
+
+	out << "Overlays: " << overlays.size() << endl;
+
+	for (const NDSFileSystem::Overlay &overlay : overlays) {
 
-	if (nds->arm7OverlaySize) {
+		const OVTEntry &e = *overlay.entry;
 
-		String file = "arm7_overlay.bin";
-		if (int ret = makeFile(path, file)) return ret;
+		out
+			<< overlay.file.name << ": id " << e.id << ", file " << e.fileId << hex
+			<< ", RAM 0x" << e.ramAddress << " - 0x" << (u64(e.ramAddress) + e.ramSize)
+			<< ", BSS 0x" << e.bssSize << ", static init 0x" << e.staticInitStart << " - 0x" << e.staticInitEnd << dec
+			<< ", " << overlay.file.fileSize << " bytes";
 
-		System::files()->write(
-			file, Buffer((u8*)nds + nds->arm7OverlayOffset, (u8*)nds + nds->arm7OverlayOffset + nds->arm7OverlaySize)
-		);
+		if (e.isCompressed())
+			out << " (BLZ compressed, " << e.getCompressedSize() << " bytes)";
+
+		out << endl;
 	}
 
 	return 0;
 }
 
-int exportDebug(const String &path, NDS *nds, FileSystem*) {
+int exportDebug(const String &path, NDS *nds, FileSystem*, std::ostream &out) {
 
 	if (nds->dRomSize) {
 
 		String file = "debug.bin";
-		if (int ret = makeFile(path, file)) return ret;
+		if (int ret = makeFile(path, file, out)) return ret;
 
-		System::files()->write(
-			file, Buffer((u8*)nds + nds->dRomOff, (u8*)nds + nds->dRomOff + nds->dRomSize)
-		);
+		writeFile(file, (u8*)nds + nds->dRomOff, nds->dRomSize);
 	}
 
 	return 0;
 }
 
-int exportFiles(const String &path, NDS*, FileSystem *fs) {
+//Opens a file as NARC if archives are walked; the archive points into the data of the file
+
+inline std::unique_ptr<NARCFileSystem> openArchive(const FileInfo &f, std::ostream &out) {
+
+	using namespace std;
+
+	if (!walkArchives || f.isFolder() || !NARCFileSystem::isArchive(f.dataExt, usz(f.fileSize)))
+		return nullptr;
+
+	try {
+		return make_unique<NARCFileSystem>((u8*) f.dataExt, usz(f.fileSize));
+	} catch (runtime_error &e) {
+		out << "WARNING: Couldn't open \"" << f.path << "\" as archive; " << e.what() << endl;
+		return nullptr;
+	}
+}
+
+//A file that has to be written and where to
+
+struct ExportJob {
+	const FileInfo *file;
+	String path;
+};
+
+//Creates the folders and collects the files of a file system and the archives in it;
+//the archives are kept alive by archives, since their files point into them
+
+inline int collectExports(
+	FileSystem *fs, const String &base, List<ExportJob> &jobs,
+	List<std::unique_ptr<NARCFileSystem>> &archives, std::ostream &out
+) {
 
-	usz i = usz_MAX;
+	using namespace std;
+
+	error_code err;
 
 	for (auto &f : fs->getVirtualFiles()) {
 
-		++i;
+		if (f.path.size() > 2 && !isSafePath(f.path.substr(2))) {
+			out << "WARNING: Skipped \"" << f.path << "\", since its name would be written outside of \"" << base << "\"" << endl;
+			continue;
+		}
+
+		const String local = f.path.size() <= 2 ? base : base + "/" + f.path.substr(2);
+
+		if (f.isFolder()) {
+
+			if (!filesystem::create_directories(local, err) && err) {
+				out << "ERROR: Couldn't add subdir \"" << local << "\"" << endl;
+				return 1;
+			}
+
+			continue;
+		}
 
-		if (i == 0 || f.isFolder()) continue;
+		jobs.push_back({ &f, local });
 
-		String file = f.path.substr(2);
-		if (int ret = makeFile(path, file, f.isFolder())) return ret;
+		if (auto archive = openArchive(f, out)) {
 
-		Buffer buf;
-		fs->read(f.path, buf);
+			archives.push_back(std::move(archive));
 
-		if(f.fileSize)
-			System::files()->write(file, buf);
+			if (int ret = collectExports(archives.back().get(), local + ".d", jobs, archives, out))
+				return ret;
+		}
 	}
 
 	return 0;
 }
 
-inline void logFile(u8 *ptr, const FileInfo &f) {
+inline int exportFiles(const String &path, FileSystem *fs, std::ostream &out, bool decompress) {
 
 	using namespace std;
 
-	cout << f.path << " ";
+	//Create all folders up front in one pass, so writing the files doesn't have to go through the file system
+	//Archives are flattened into the same list, so all of their files are written in parallel as well
 
-	if (f.getFileObjects() || f.fileSize)
-		cout << "with ";
+	List<ExportJob> jobs;
+	List<unique_ptr<NARCFileSystem>> archives;
 
-	if (auto folders = f.getFolders()) {
+	if (int ret = collectExports(fs, path.substr(0, path.find_last_of('.')), jobs, archives, out))
+		return ret;
 
-		cout << folders << " folder" << (folders == 1 ? "" : "s");
+	//Files can now be written straight from the ROM in parallel, since no folders have to be made anymore
 
-		if(auto files = f.getFiles())
-			cout << ", " << files << " file" << (files == 1 ? " " : "s ");
+	atomic<usz> failed{ usz_MAX };
 
-	} else if(auto files = f.getFiles())
-		cout << files << " file" << (files == 1 ? "" : "s");
+	Parallel::forEach(jobs.size(), threadsPerRom, [&](usz i) {
 
-	if (f.fileSize) {
+		const FileInfo &f = *jobs[i].file;
+		const String &file = jobs[i].path;
 
-		if (f.getFileObjects())
-			cout << ", ";
+		CompressionInfo info;
 
-		cout
-			<< "offset 0x" << Log::num<16>(u32((u8*)f.dataExt - ptr))
-			<< " and size " << f.fileSize << " (0x" << Log::num<16>(u32(f.fileSize))
-			<< ") ";
+		if (decompress && CompressionHelper::probe((const u8*) f.dataExt, usz(f.fileSize), info)) {
 
-		u8 magicNum[4];
-		std::memcpy(magicNum, f.dataExt, std::min(FileSize(4), f.fileSize));
+			Buffer data(info.decompressedSize);
 
-		String magicNumber(magicNum, magicNum + sizeof(magicNum));
+			if (
+				!CompressionHelper::decompress((const u8*) f.dataExt, usz(f.fileSize), data.data(), data.size()) ||
+				!writeFile(file, data.data(), data.size())
+			)
+				failed = i;
 
-		bool isValidMagicNum = true;
+			return;
+		}
 
-		for (const c8 c : magicNumber)
-			if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_')) {
-				isValidMagicNum = false;
-				break;
-			}
+		if (!writeFile(file, f.dataExt, usz(f.fileSize)))
+			failed = i;
+	});
 
-		if (isValidMagicNum)
-			cout << "and magic number \"" << magicNumber << "\"";
+	if (failed != usz_MAX) {
+		out << "ERROR: Couldn't write file \"" << jobs[failed].path << "\"" << endl;
+		return 2;
 	}
 
-	cout << endl;
+	return 0;
+}
+
+int exportFiles(const String &path, NDS*, FileSystem *fs, std::ostream &out) {
+	return exportFiles(path, fs, out, false);
 }
 
-int infoFiles(const String&, NDS *nds, FileSystem *fs) {
+int exportFilesDecompressed(const String &path, NDS*, FileSystem *fs, std::ostream &out) {
+	return exportFiles(path, fs, out, true);
+}
 
-	u8 *ptr = (u8*)nds;
+//Graphics with their palette and screen (usz_MAX if there's none), found by their magic number
+//Graphics use the palette with the same name, or the only palette in the folder if there's none
 
-	for (auto &f : fs->getVirtualFiles())
-		logFile(ptr, f);
+struct Graphics {
+	usz ncgr, nclr, nscr;
+	String file;				//Relative to the graphics folder
+};
 
-	return 0;
-}
+inline List<Graphics> findGraphics(const List<FileInfo> &files, usz &noPalette) {
+
+	using namespace std;
+
+	auto getStem = [](const String &file) {
+
+		const usz dot = file.find_last_of('.'), slash = file.find_last_of('/');
+
+		if (dot == String::npos || (slash != String::npos && dot < slash))
+			return file;
+
+		return file.substr(0, dot);
+	};
+
+	List<usz> graphics;
+	unordered_map<String, usz> palettes, screens;
+	unordered_map<FileHandle, List<usz>> palettesPerFolder;
+
+	for (usz i = 0; i < files.size(); ++i) {
+
+		const FileInfo &f = files[i];
+
+		if (f.isFolder() || f.fileSize < sizeof(GenericHeader))
+			continue;
+
+		u32 magic;
+		std::memcpy(&magic, f.dataExt, sizeof(magic));
+
+		if (magic == RESOURCE_NCGR && isSafePath(f.path.substr(2)))
+			graphics.push_back(i);
+
+		else if (magic == RESOURCE_NCLR) {
+			palettes[getStem(f.path)] = i;
+			palettesPerFolder[f.parent].push_back(i);
+		}
+
+		else if (magic == RESOURCE_NCSR)
+			screens[getStem(f.path)] = i;
+	}
+
+	List<Graphics> res;
+	res.reserve(graphics.size());
+
+	noPalette = 0;
+
+	for (usz i : graphics) {
+
+		const FileInfo &f = files[i];
+		const String stem = getStem(f.path);
+
+		usz nclr = usz_MAX, nscr = usz_MAX;
+
+		auto palette = palettes.find(stem);
+
+		if (palette != palettes.end())
+			nclr = palette->second;
+
+		else {
+
+			auto folder = palettesPerFolder.find(f.parent);
+
+			if (folder != palettesPerFolder.end() && folder->second.size() == 1)
+				nclr = folder->second[0];
+		}
+
+		if (nclr == usz_MAX) {
+			++noPalette;
+			continue;
+		}
+
+		auto screen = screens.find(stem);
 
-int infoFolders(const String&, NDS *nds, FileSystem *fs) {
+		if (screen != screens.end())
+			nscr = screen->second;
+
+		res.push_back(Graphics{ i, nclr, nscr, stem.substr(2) + ".png" });
+	}
+
+	return res;
+}
+
+//Parses the resources of graphics; the screen is optional
+
+inline bool parseGraphics(const List<FileInfo> &files, const Graphics &g, NCGR &ncgr, NCLR &nclr, NSCR &nscr, bool &hasScreen) {
+
+	const FileInfo &c = files[g.ncgr], &p = files[g.nclr];
+
+	if (!ncgr.parse((const u8*) c.dataExt, usz(c.fileSize)) || !nclr.parse((const u8*) p.dataExt, usz(p.fileSize)))
+		return false;
+
+	hasScreen = false;
+
+	if (g.nscr != usz_MAX) {
+		const FileInfo &s = files[g.nscr];
+		hasScreen = nscr.parse((const u8*) s.dataExt, usz(s.fileSize));
+	}
+
+	return true;
+}
+
+int exportGraphics(const String &path, NDS*, FileSystem *fs, std::ostream &out) {
+
+	using namespace std;
+
+	const String base = getDerivedFolder(path, "graphics");
+	const List<FileInfo> &files = fs->getVirtualFiles();
+
+	usz noPalette;
+	List<Graphics> jobs = findGraphics(files, noPalette);
+
+	//Folders are made up front, so the images can be written in parallel
+
+	error_code err;
+
+	for (Graphics &job : jobs) {
+
+		job.file = base + "/" + job.file;
+		const String folder = job.file.substr(0, job.file.find_last_of('/'));
+
+		if (!filesystem::create_directories(folder, err) && err) {
+			out << "ERROR: Couldn't add subdir \"" << folder << "\"" << endl;
+			return 1;
+		}
+	}
+
+	atomic<usz> decoded{}, unwritten{}, failed{ usz_MAX };
+
+	Parallel::forEach(jobs.size(), threadsPerRom, [&](usz i) {
+
+		const Graphics &job = jobs[i];
+
+		NCGR ncgr;
+		NCLR nclr;
+		NSCR nscr;
+		bool hasScreen;
+
+		if (!parseGraphics(files, job, ncgr, nclr, nscr, hasScreen))
+			return;
+
+		List<r8> image;
+		List<bgr5> palette;
+		u16 w, h;
+
+		if (!GraphicsHelper::toIndexedImage(ncgr, nclr, hasScreen ? &nscr : nullptr, image, palette, w, h, decryptGraphics))
+			return;
+
+		++decoded;
+
+		if (!writePng(job.file, image, w, h, palette.data(), palette.size())) {
+			failed = i;
+			++unwritten;
+		}
+	});
+
+	out
+		<< "Exported " << (decoded - unwritten) << " of " << (jobs.size() + noPalette) << " graphics to \"" << base << "\"" << endl
+		<< "Without a palette: " << noPalette << endl
+		<< "Couldn't be decoded: " << (jobs.size() - decoded) << endl;
+
+	if (unwritten) {
+		out << "ERROR: Couldn't write " << unwritten << " file(s), like \"" << jobs[failed].file << "\"" << endl;
+		return 2;
+	}
+
+	return 0;
+}
+
+//The contents of a folder (with 2 folders, 1 file); hasData continues the line with the location of a file
+
+inline void logContents(usz folders, usz files, bool hasData, std::ostream &out) {
+
+	if (folders || files || hasData)
+		out << "with ";
+
+	if (folders) {
+
+		out << folders << " folder" << (folders == 1 ? "" : "s");
+
+		if(files)
+			out << ", " << files << " file" << (files == 1 ? " " : "s ");
+
+	} else if(files)
+		out << files << " file" << (files == 1 ? "" : "s");
+}
+
+//Files in archives are prefixed by the path of the archive (~/a.narc.d/b.bin)
+
+inline void logFile(u8 *ptr, const FileInfo &f, const String &prefix, std::ostream &out) {
+
+	using namespace std;
+
+	out << prefix << f.path.substr(1) << " ";
+	logContents(usz(f.getFolders()), usz(f.getFiles()), f.fileSize, out);
+
+	if (f.fileSize) {
+
+		if (f.getFileObjects())
+			out << ", ";
+
+		out
+			<< "offset 0x" << Log::num<16>(u32((u8*)f.dataExt - ptr))
+			<< " and size " << f.fileSize << " (0x" << Log::num<16>(u32(f.fileSize))
+			<< ") ";
+
+		u8 magicNum[4];
+		std::memcpy(magicNum, f.dataExt, std::min(FileSize(4), f.fileSize));
+
+		String magicNumber(magicNum, magicNum + sizeof(magicNum));
+
+		bool isValidMagicNum = true;
+
+		for (const c8 c : magicNumber)
+			if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_')) {
+				isValidMagicNum = false;
+				break;
+			}
+
+		if (isValidMagicNum)
+			out << "and magic number \"" << magicNumber << "\" ";
+
+		CompressionInfo info;
+
+		if (CompressionHelper::probe((const u8*) f.dataExt, usz(f.fileSize), info))
+			out
+				<< "compressed with " << CompressionHelper::getName(info.type)
+				<< " (" << info.compressedSize << " -> " << info.decompressedSize << " bytes)";
+	}
+
+	out << endl;
+}
+
+//Archives are zero-copy, so the offsets of their files are still offsets into the ROM
+
+inline void logFiles(u8 *ptr, FileSystem *fs, const String &prefix, bool foldersOnly, std::ostream &out) {
+
+	for (auto &f : fs->getVirtualFiles()) {
+
+		if (!foldersOnly || f.isFolder())
+			logFile(ptr, f, prefix, out);
+
+		if (auto archive = openArchive(f, out))
+			logFiles(ptr, archive.get(), prefix + f.path.substr(1) + ".d", foldersOnly, out);
+	}
+}
+
+int infoFiles(const String&, NDS *nds, FileSystem *fs, std::ostream &out) {
+	logFiles((u8*)nds, fs, "~", false, out);
+	return 0;
+}
+
+//Folders only need the FNT, so they're listed from NDSFileTable unless the file system is needed anyway (-walk-narc or other flags).
+//The order is the same as NDSFileSystem's: the root, then the folders in every folder, with the parents in order of their id.
+
+int infoFolders(const String&, NDS *nds, FileSystem *fs, std::ostream &out) {
+
+	using namespace std;
+
+	if (walkArchives || !fs->getVirtualFiles().empty()) {
+
+		unique_ptr<NDSFileSystem> parsed;
+
+		if (fs->getVirtualFiles().empty()) {
+			parsed = make_unique<NDSFileSystem>(nds);
+			fs = parsed.get();
+		}
+
+		logFiles((u8*)nds, fs, "~", true, out);
+		return 0;
+	}
+
+	const NDSFileTable table(nds);
+	const u16 count = table.getFolderCount();
+
+	//Sort the folders by parent; parents have a lower id, so their path is known before the ones of their folders
+
+	List<u32> first(usz(count) + 1);
+
+	for (u16 i = 1; i < count; ++i)
+		++first[table.getParent(i) + 1];
+
+	for (u16 i = 0; i < count; ++i)
+		first[i + 1] += first[i];
+
+	List<u16> order(count);
+	List<u32> next(first.begin(), first.end() - 1);
+
+	for (u16 i = 1; i < count; ++i)
+		order[1 + next[table.getParent(i)]++] = i;
+
+	List<String> paths(count);
+	List<usz> files(count);
+
+	for (u16 i = 0; i < count; ++i)
+		for (const NDSFileTable::Entry &e : table.getEntries(i))
+			if (e.isFolder)
+				paths[e.id] = String(e.name);
+			else ++files[i];
+
+	for (u16 i = 1; i < count; ++i)
+		paths[i] = paths[table.getParent(i)] + "/" + paths[i];
+
+	for (const u16 i : order) {
+		out << "~" << paths[i] << " ";
+		logContents(first[i + 1] - first[i], files[i], false, out);
+		out << endl;
+	}
+
+	return 0;
+}
+
+inline bool readFile(const std::filesystem::path &file, Buffer &buffer) {
+
+	std::ifstream in(file, std::ios::binary | std::ios::ate);
+
+	if (!in)
+		return false;
+
+	buffer.resize(usz(in.tellg()));
+	in.seekg(0);
+
+	return buffer.empty() || in.read((c8*)buffer.data(), buffer.size());
+}
+
+int importFiles(const String &path, NDS*, FileSystem *fs, std::ostream &out) {
+
+	using namespace std;
+	namespace fsys = std::filesystem;
+
+	const String base = path.substr(0, path.find_last_of('.'));
+
+	error_code err;
+
+	if (!fsys::is_directory(base, err)) {
+		out << "ERROR: There are no files to import from \"" << base << "\"" << endl;
+		return 1;
+	}
+
+	try {
+
+		//The repacker copies from the ROM file itself, so it needs a mapping of it
+
+		ROMMapping rom(path);
+		const NDSFileSystem &nfs = *(const NDSFileSystem*)fs;
+		NDSRepacker repacker(rom, nfs);
+
+		usz replaced{}, added{}, skipped{};
+
+		for (auto it = fsys::recursive_directory_iterator(base, err); !err && it != fsys::recursive_directory_iterator(); it.increment(err)) {
+
+			const String rel = it->path().lexically_relative(base).generic_string();
+
+			//Folders of walked archives (-walk-narc) aren't part of the rom
+
+			if (
+				it->is_directory(err) && rel.size() > 2 && !rel.compare(rel.size() - 2, 2, ".d") &&
+				nfs.getIndex().find(std::string_view(rel).substr(0, rel.size() - 2)) != NDSFileIndex::notFound
+			) {
+				it.disable_recursion_pending();
+				continue;
+			}
+
+			if (!it->is_regular_file(err))
+				continue;
+
+			const FileHandle found = nfs.getIndex().find(rel);
+
+			//The root of the export folder also has the icon, binaries and such, so only existing files are used there.
+			//New files are only added under folders the rom already has at its root.
+
+			if (found == NDSFileIndex::notFound) {
+
+				const usz slash = rel.find('/');
+
+				if (slash == String::npos)
+					continue;
+
+				const FileHandle folder = nfs.getIndex().find(std::string_view(rel).substr(0, slash));
+
+				if (folder == NDSFileIndex::notFound || !fs->getVirtualFiles()[folder].isFolder()) {
+					++skipped;
+					continue;
+				}
+			}
+
+			Buffer data;
+
+			if (!readFile(it->path(), data)) {
+				out << "ERROR: Couldn't read \"" << it->path().generic_string() << "\"" << endl;
+				return 2;
+			}
+
+			if (found == NDSFileIndex::notFound) {
+
+				if (!repacker.add(rel, std::move(data))) {
+					out << "ERROR: Couldn't add \"" << rel << "\" to the rom" << endl;
+					return 3;
+				}
+
+				++added;
+				continue;
+			}
+
+			const FileInfo &f = fs->getVirtualFiles()[found];
+
+			if (f.isFolder())
+				continue;
+
+			if (data.size() == f.fileSize && (data.empty() || !std::memcmp(data.data(), f.dataExt, data.size())))
+				continue;
+
+			//Compressed files are usually exported decompressed (-export-files-decompressed),
+			//so those are compared with the decompressed original and compressed again the same way
+
+			CompressionInfo info, imported;
+
+			if (
+				CompressionHelper::probe((const u8*) f.dataExt, usz(f.fileSize), info) &&
+				!CompressionHelper::probe(data.data(), data.size(), imported)
+			) {
+
+				Buffer original;
+
+				if (CompressionHelper::decompress((const u8*) f.dataExt, usz(f.fileSize), original) && original == data)
+					continue;
+
+				if (info.type == COMPRESSION_LZ10 || info.type == COMPRESSION_LZ11) {
+
+					Buffer compressed;
+
+					if (!CompressionHelper::compress(data.data(), data.size(), info.type, compressed, COMPRESSION_SMALLEST, threadsPerRom)) {
+						out << "ERROR: Couldn't compress \"" << rel << "\" with " << CompressionHelper::getName(info.type) << endl;
+						return 7;
+					}
+
+					data = std::move(compressed);
+
+				} else
+					out
+						<< "WARNING: \"" << rel << "\" was compressed with " << CompressionHelper::getName(info.type)
+						<< ", which can't be compressed again; it's imported uncompressed" << endl;
+			}
+
+			repacker.replace(f.path, std::move(data));
+			++replaced;
+		}
+
+		if (err) {
+			out << "ERROR: Couldn't walk \"" << base << "\"" << endl;
+			return 4;
+		}
+
+		if (skipped)
+			out << "WARNING: Skipped " << skipped << " new file(s) that aren't in a folder of the rom" << endl;
+
+		if (!repacker.hasChanges()) {
+			out << "No changed files to import" << endl;
+			return 0;
+		}
+
+		const String output = base + "_repacked.nds";
+
+		if (!repacker.write(output)) {
+			out << "ERROR: Couldn't write \"" << output << "\"" << endl;
+			return 5;
+		}
+
+		out << "Imported " << replaced << " changed and " << added << " new file(s) into \"" << output << "\"" << endl;
+
+	} catch (const std::runtime_error &e) {
+		out << "ERROR: Couldn't repack the rom" << endl << e.what() << endl;
+		return 6;
+	}
+
+	return 0;
+}
+
+//Compresses code with BLZ if the original was; returns false if it doesn't get smaller, in which case data is left as is
+
+inline bool compressCode(Buffer &data, usz uncompressed) {
+
+	Buffer compressed;
+
+	if (!CompressionHelper::compressBLZ(data.data(), data.size(), compressed, uncompressed, COMPRESSION_SMALLEST, threadsPerRom))
+		return false;
+
+	data = std::move(compressed);
+	return true;
+}
+
+int importArm9(const String &path, NDS *nds, FileSystem *fs, std::ostream &out) {
+
+	using namespace std;
+	namespace fsys = std::filesystem;
+
+	const String base = path.substr(0, path.find_last_of('.'));
+	const NDSFileSystem &nfs = *(const NDSFileSystem*)fs;
+
+	error_code err;
+
+	try {
+
+		ROMMapping rom(path);
+		NDSRepacker repacker(rom, nfs);
+
+		//arm9.bin; -export-arm9-decompressed is preferred over -export-arm9-bin, since that can be edited.
+		//arm9.bin of -export-arm9-bin is stored as is, so it's compared with the rom and never compressed again.
+
+		String file = base + "/arm9_decompressed.bin";
+		const bool isDecompressed = fsys::is_regular_file(file, err);
+
+		if (!isDecompressed)
+			file = base + "/arm9.bin";
+
+		Buffer arm9;
+		const u8 *arm9Ptr = (const u8*)nds + nds->arm9Offset;
+		const u8 *original = arm9Ptr;
+		usz originalSize = nds->arm9Size;
+		bool isArm9Changed{};
+
+		if (fsys::is_regular_file(file, err) && (!isDecompressed || nfs.getArm9Data(original, originalSize))) {
+
+			if (!readFile(file, arm9)) {
+				out << "ERROR: Couldn't read \"" << file << "\"" << endl;
+				return 1;
+			}
+
+			const u8 *footer = usz(nds->arm9Offset) + nds->arm9Size + 12 <= nds->romSize ? arm9Ptr + nds->arm9Size : nullptr;
+
+			const usz romParams = ModuleParams::find(arm9Ptr, nds->arm9Size, footer);
+			const usz params = ModuleParams::find(arm9.data(), arm9.size());
+
+			ModuleParams romValues{}, values{};
+
+			if (romParams != usz_MAX)
+				std::memcpy(&romValues, arm9Ptr + romParams, sizeof(romValues));
+
+			if (params != usz_MAX)
+				std::memcpy(&values, arm9.data() + params, sizeof(values));
+
+			//The footer points to the params, so they can't move
+
+			if (footer && romParams != params) {
+				out << "ERROR: The module params of \"" << file << "\" moved, so the footer of the arm9 binary can't point to them" << endl;
+				return 2;
+			}
+
+			isArm9Changed = arm9.size() != originalSize || std::memcmp(arm9.data(), original, originalSize);
+
+			if (isArm9Changed && isDecompressed && romValues.compressedStaticEnd && params != usz_MAX && !values.compressedStaticEnd) {
+
+				//The secure area (and the params, which the boot code needs before it decompresses) stay uncompressed
+
+				if (compressCode(arm9, std::max(usz(0x4000), params + sizeof(ModuleParams)))) {
+					values.compressedStaticEnd = u32(nds->arm9Load + arm9.size());
+					std::memcpy(arm9.data() + params, &values, sizeof(values));
+				}
+
+				else out << "WARNING: The arm9 binary doesn't get smaller when compressed; it's imported uncompressed" << endl;
+			}
+
+			if (isArm9Changed)
+				repacker.replaceArm9(std::move(arm9));
+		}
+
+		//Overlays that changed; these are exported decompressed, so the ones that were compressed are compressed again
+
+		const List<NDSFileSystem::Overlay> &overlays = nfs.getOverlays();
+
+		List<OVTEntry> tables[2];
+		bool isTableChanged[2]{};
+
+		for (const NDSFileSystem::Overlay &overlay : overlays)
+			tables[overlay.isArm7].push_back(*overlay.entry);
+
+		usz imported{}, indices[2]{};
+
+		for (usz i = 0; i < overlays.size(); ++i) {
+
+			const NDSFileSystem::Overlay &overlay = overlays[i];
+			OVTEntry &entry = tables[overlay.isArm7][indices[overlay.isArm7]++];
+
+			const String overlayFile = getDerivedFolder(path, overlay.isArm7 ? "overlay7" : "overlay9") + "/" + overlay.file.name;
+
+			if (!fsys::is_regular_file(overlayFile, err) || !nfs.getOverlayData(i, original, originalSize))
+				continue;
+
+			Buffer data;
+
+			if (!readFile(overlayFile, data)) {
+				out << "ERROR: Couldn't read \"" << overlayFile << "\"" << endl;
+				return 3;
+			}
+
+			if (data.size() == originalSize && !std::memcmp(data.data(), original, originalSize))
+				continue;
+
+			if (data.size() > entry.ramSize)
+				out << "WARNING: \"" << overlay.file.name << "\" grew by " << (data.size() - entry.ramSize) << " bytes; its BSS moves with it" << endl;
+
+			entry.ramSize = u32(data.size());
+			entry.flags &= ~u32(0x1FFFFFF);
+
+			if (overlay.entry->isCompressed() && compressCode(data, 0))
+				entry.flags |= u32(data.size()) | (1 << 24);
+
+			repacker.replace(u16(entry.fileId), std::move(data));
+			isTableChanged[overlay.isArm7] = true;
+			++imported;
+		}
+
+		for (usz i = 0; i < 2; ++i)
+			if (isTableChanged[i])
+				repacker.replaceOverlayTable(
+					bool(i), Buffer((const u8*) tables[i].data(), (const u8*)(tables[i].data() + tables[i].size()))
+				);
+
+		if (!repacker.hasChanges()) {
+			out << "No changed code to import" << endl;
+			return 0;
+		}
+
+		const String output = base + "_repacked.nds";
+
+		if (!repacker.write(output)) {
+			out << "ERROR: Couldn't write \"" << output << "\"" << endl;
+			return 4;
+		}
+
+		out << "Imported ";
+
+		if (isArm9Changed)
+			out << "the arm9 binary from \"" << file << "\" and ";
+
+		out << imported << " changed overlay(s) into \"" << output << "\"" << endl;
+
+	} catch (const std::runtime_error &e) {
+		out << "ERROR: Couldn't repack the rom" << endl << e.what() << endl;
+		return 5;
+	}
+
+	return 0;
+}
+
+int importGraphics(const String &path, NDS*, FileSystem *fs, std::ostream &out) {
+
+	using namespace std;
+
+	const String rom = path.substr(0, path.find_last_of('.')), base = getDerivedFolder(path, "graphics");
+	const List<FileInfo> &files = fs->getVirtualFiles();
+
+	error_code err;
+
+	if (!filesystem::is_directory(base, err)) {
+		out << "ERROR: There are no graphics to import from \"" << base << "\"" << endl;
+		return 1;
+	}
+
+	usz noPalette;
+	const List<Graphics> jobs = findGraphics(files, noPalette);
+
+	//A palette that's used by other graphics as well can't be changed without breaking those
+
+	unordered_map<usz, usz> paletteUsers;
+
+	for (const Graphics &job : jobs)
+		++paletteUsers[job.nclr];
+
+	struct Result {
+		EncodedGraphics encoded;
+		bool isChanged, hasNewPalette;
+		String message;
+	};
+
+	List<Result> results(jobs.size());
+
+	Parallel::forEach(jobs.size(), threadsPerRom, [&](usz i) {
+
+		const Graphics &job = jobs[i];
+		Result &res = results[i];
+		res.isChanged = false;
+
+		List<rgba8> pixels;
+		u16 w, h;
+
+		if (!PNGHelper::read(base + "/" + job.file, pixels, w, h))
+			return;
+
+		NCGR ncgr;
+		NCLR nclr;
+		NSCR nscr;
+		bool hasScreen;
+
+		if (!parseGraphics(files, job, ncgr, nclr, nscr, hasScreen))
+			return;
+
+		const RAHC *rahc = ncgr.get<RAHC>();
+
+		//Encrypted graphics were exported decrypted, but can't be encrypted again yet
+
+		if (decryptGraphics) {
+			res.message = "WARNING: \"" + job.file + "\" is encrypted (-decrypt-graphics), which isn't supported; it's skipped";
+			return;
+		}
+
+		//Images that didn't change (in bgr5) are left alone, so their graphics stay byte for byte the same
+
+		List<rgba8> original;
+		u16 ow, oh;
+
+		if (!GraphicsHelper::toRGBA8Image(ncgr, nclr, hasScreen ? &nscr : nullptr, original, ow, oh))
+			return;
+
+		const usz count = usz(w) * h;
+		List<bgr5> colors(count);
+		QuantizeHelper::toBGR5(pixels.data(), count, colors.data());
+
+		if (ow == w && oh == h) {
+
+			List<bgr5> originalColors(count);
+			QuantizeHelper::toBGR5(original.data(), count, originalColors.data());
+
+			if (colors == originalColors)
+				return;
+		}
+
+		//The original palette is kept if it has every color, or if other graphics use it as well
+
+		List<r8> indices;
+		List<bgr5> palette;
+
+		if (!GraphicsHelper::toIndexedImage(ncgr, nclr, hasScreen ? &nscr : nullptr, indices, palette, ow, oh))
+			return;
+
+		List<u8> known(0x8000);
+
+		for (usz j = 1; j < palette.size(); ++j)
+			known[palette[j] & 0x7FFF] = 1;
+
+		bool hasAllColors = true;
+
+		for (const bgr5 c : colors)
+			if (c != QuantizeHelper::transparent && !known[c]) {
+				hasAllColors = false;
+				break;
+			}
+
+		const bool isShared = paletteUsers.at(job.nclr) > 1;
+
+		GraphicsEncoding encoding;
+		encoding.is4Bit = rahc->tileDepth == 3;
+		encoding.hasScreen = hasScreen;
+		encoding.isLinear = rahc->isLinear;
+
+		if (hasAllColors || isShared)
+			encoding.palette = palette;
+
+		if (!GraphicsHelper::fromRGBA8Image(pixels.data(), w, h, encoding, res.encoded)) {
+			res.message = "WARNING: \"" + job.file + "\" couldn't be encoded (its size isn't a multiple of 8 or it has too many different tiles)";
+			return;
+		}
+
+		res.isChanged = true;
+		res.hasNewPalette = !hasAllColors && !isShared;
+
+		if (!hasAllColors && isShared)
+			res.message =
+				"WARNING: \"" + job.file + "\" has new colors, but its palette is used by other graphics; "
+				"the nearest colors of the palette are used instead";
+	});
+
+	usz changed{}, newPalettes{};
+
+	try {
+
+		ROMMapping mapping(path);
+		NDSRepacker repacker(mapping, *(const NDSFileSystem*)fs);
+
+		for (usz i = 0; i < jobs.size(); ++i) {
+
+			Result &res = results[i];
+
+			if (!res.message.empty())
+				out << res.message << endl;
+
+			if (!res.isChanged)
+				continue;
+
+			const Graphics &job = jobs[i];
+
+			repacker.replace(files[job.ncgr].path, std::move(res.encoded.ncgr));
+
+			if (res.hasNewPalette) {
+				repacker.replace(files[job.nclr].path, std::move(res.encoded.nclr));
+				++newPalettes;
+			}
+
+			if (job.nscr != usz_MAX && !res.encoded.nscr.empty())
+				repacker.replace(files[job.nscr].path, std::move(res.encoded.nscr));
+
+			++changed;
+		}
+
+		if (!repacker.hasChanges()) {
+			out << "No changed graphics to import" << endl;
+			return 0;
+		}
+
+		const String output = rom + "_repacked.nds";
+
+		if (!repacker.write(output)) {
+			out << "ERROR: Couldn't write \"" << output << "\"" << endl;
+			return 2;
+		}
+
+		out << "Imported " << changed << " changed graphics (" << newPalettes << " with a new palette) into \"" << output << "\"" << endl;
+
+	} catch (const std::runtime_error &e) {
+		out << "ERROR: Couldn't repack the rom" << endl << e.what() << endl;
+		return 3;
+	}
+
+	return 0;
+}
+
+//Files with models or textures (BMD0, BTX0), relative to the rom; archives are walked with -walk-narc
+//The archives are kept alive by archives, since their files point into them
+
+inline void collectModels(
+	FileSystem *fs, const String &prefix, List<ExportJob> &models,
+	List<std::unique_ptr<NARCFileSystem>> &archives, std::ostream &out
+) {
+
+	for (auto &f : fs->getVirtualFiles()) {
+
+		if (f.isFolder() || f.fileSize < sizeof(GenericHeader) || !isSafePath(f.path.substr(2)))
+			continue;
+
+		const String path = prefix + f.path.substr(2);
+
+		u32 magic;
+		std::memcpy(&magic, f.dataExt, sizeof(magic));
+
+		if (magic == RESOURCE_BMD0 || magic == RESOURCE_BTX0)
+			models.push_back({ &f, path });
+
+		else if (auto archive = openArchive(f, out)) {
+			archives.push_back(std::move(archive));
+			collectModels(archives.back().get(), path + ".d/", models, archives, out);
+		}
+	}
+}
+
+//The models and textures of a BMD0 or BTX0; both are optional
+
+inline bool parseModels(const FileInfo &f, const MDL0 *&mdl0, const TEX0 *&tex0) {
+
+	BMD0 bmd0;
+	BTX0 btx0;
+
+	mdl0 = nullptr;
+	tex0 = nullptr;
+
+	if (bmd0.parse((const u8*) f.dataExt, usz(f.fileSize))) {
+		mdl0 = bmd0.get<MDL0>();
+		tex0 = bmd0.get<TEX0>();
+		return true;
+	}
+
+	if (btx0.parse((const u8*) f.dataExt, usz(f.fileSize))) {
+		tex0 = btx0.get<TEX0>();
+		return true;
+	}
+
+	return false;
+}
+
+int exportTextures(const String &path, NDS*, FileSystem *fs, std::ostream &out) {
+
+	using namespace std;
+
+	const String base = getDerivedFolder(path, "textures");
+
+	List<ExportJob> models;
+	List<unique_ptr<NARCFileSystem>> archives;
+	collectModels(fs, "", models, archives, out);
+
+	usz total{}, decoded{};
+	error_code err;
+
+	for (const ExportJob &model : models) {
+
+		const MDL0 *mdl0;
+		const TEX0 *tex0;
+		List<TextureEntry> textures;
+
+		if (!parseModels(*model.file, mdl0, tex0) || !ModelHelper::getTextures(tex0, textures) || textures.empty())
+			continue;
+
+		//Every texture of the file is converted at once, then written
+
+		List<List<rgba8>> images;
+		decoded += ModelHelper::toRGBA8Images(tex0, textures, images, threadsPerRom);
+		total += textures.size();
+
+		const String folder = base + "/" + model.path;
+
+		if (!filesystem::create_directories(folder, err) && err) {
+			out << "ERROR: Couldn't add subdir \"" << folder << "\"" << endl;
+			return 1;
+		}
+
+		atomic<usz> failed{ usz_MAX };
+
+		Parallel::forEach(textures.size(), threadsPerRom, [&](usz i) {
+
+			if (images[i].empty())
+				return;
+
+			//Names are up to 16 characters of anything, so characters that can't be in a file name are replaced
+
+			String name = textures[i].name;
+
+			for (c8 &c : name)
+				if (c < ' ' || String("/\\:*?\"<>|").find(c) != String::npos)
+					c = '_';
+
+			if (!writePng(folder + "/" + name + ".png", images[i], textures[i].w, textures[i].h))
+				failed = i;
+		});
+
+		if (failed != usz_MAX) {
+			out << "ERROR: Couldn't write texture \"" << textures[failed].name << "\" of \"" << model.path << "\"" << endl;
+			return 2;
+		}
+	}
+
+	out
+		<< "Exported " << decoded << " of " << total << " textures of " << models.size() << " files to \"" << base << "\"" << endl
+		<< "Couldn't be decoded: " << (total - decoded) << endl;
+
+	return 0;
+}
+
+int infoModels(const String&, NDS*, FileSystem *fs, std::ostream &out) {
+
+	using namespace std;
+
+	List<ExportJob> models;
+	List<unique_ptr<NARCFileSystem>> archives;
+	collectModels(fs, "", models, archives, out);
+
+	u64 modelCount{}, vertices{}, polygons{}, materials{}, textureCount{}, textureSize{};
+
+	for (const ExportJob &model : models) {
+
+		const MDL0 *mdl0;
+		const TEX0 *tex0;
+
+		if (!parseModels(*model.file, mdl0, tex0)) {
+			out << model.path << ": Couldn't be parsed" << endl;
+			continue;
+		}
+
+		List<ModelSummary> summaries;
+		List<TextureEntry> textures;
+
+		ModelHelper::getModels(mdl0, summaries);
+		ModelHelper::getTextures(tex0, textures);
+
+		usz size{};
+
+		for (const TextureEntry &tex : textures)
+			size += ModelHelper::getTextureSize(tex);
+
+		out << model.path << ": " << summaries.size() << " models, " << textures.size() << " textures (" << size << " bytes)" << endl;
+
+		for (const ModelSummary &s : summaries) {
+
+			out
+				<< "\t" << s.name << ": " << s.vertices << " vertices, " << s.polygons << " polygons ("
+				<< s.triangles << " triangles, " << s.quads << " quads), " << u32(s.materials) << " materials, "
+				<< u32(s.shapes) << " shapes, " << u32(s.nodes) << " nodes" << endl;
+
+			vertices += s.vertices;
+			polygons += s.polygons;
+			materials += s.materials;
+		}
+
+		modelCount += summaries.size();
+		textureCount += textures.size();
+		textureSize += size;
+	}
+
+	out
+		<< "Files: " << models.size() << endl
+		<< "Models: " << modelCount << " (" << vertices << " vertices, " << polygons << " polygons, " << materials << " materials)" << endl
+		<< "Textures: " << textureCount << " (" << textureSize << " bytes)" << endl;
+
+	return 0;
+}
+
+//The size and modification time of a ROM, to know if its index is still up to date
+
+inline bool getRomVersion(const String &path, u64 &size, i64 &time) {
+
+	std::error_code err;
+	size = u64(std::filesystem::file_size(path, err));
+
+	if (err)
+		return false;
+
+	time = i64(std::filesystem::last_write_time(path, err).time_since_epoch().count());
+	return !err;
+}
+
+int indexFiles(const String &path, NDS*, FileSystem *fs, std::ostream &out) {
+
+	using namespace std;
+
+	u64 size;
+	i64 time;
+
+	if (!getRomVersion(path, size, time)) {
+		out << "ERROR: Couldn't get the size and time of \"" << path << "\"" << endl;
+		return 1;
+	}
+
+	const ContentIndex index(*(const NDSFileSystem*)fs, walkArchives, threadsPerRom);
+	const String file = ContentIndex::getPath(path);
+
+	if (!index.save(file, size, time)) {
+		out << "ERROR: Couldn't write index \"" << file << "\"" << endl;
+		return 2;
+	}
+
+	out << "Indexed " << index.getEntries().size() << " files to \"" << file << "\"" << endl;
+	return 0;
+}
+
+int diffFiles(const List<String> &paths, usz jobs, std::ostream &out) {
+
+	using namespace std;
+
+	//Indices that are up to date are loaded, so those ROMs aren't read at all
+
+	List<ContentIndex> indices(paths.size());
+	List<u8> isCached(paths.size());
+	atomic<usz> failed{ usz_MAX };
+
+	Parallel::forEach(paths.size(), std::max(jobs, usz(1)), [&](usz i) {
+
+		const String file = ContentIndex::getPath(paths[i]);
+
+		u64 size;
+		i64 time;
+
+		if (!getRomVersion(paths[i], size, time)) {
+			failed = i;
+			return;
+		}
+
+		if (indices[i].load(file, size, time, walkArchives)) {
+			isCached[i] = true;
+			return;
+		}
+
+		try {
+
+			ROMMapping rom(paths[i]);
+			NDS *nds = NDS::get(rom.data(), rom.size());
+
+			if (!nds) {
+				failed = i;
+				return;
+			}
+
+			NDSFileSystem fs(nds);
+			indices[i] = ContentIndex(fs, walkArchives, threadsPerRom);
+
+		} catch (std::runtime_error&) {
+			failed = i;
+			return;
+		}
+
+		//Not being able to save the index only means it has to be built again next time
+
+		indices[i].save(file, size, time);
+	});
+
+	if (failed != usz_MAX) {
+		out << "ERROR: Couldn't index \"" << paths[failed] << "\"" << endl;
+		return 1;
+	}
+
+	//Where every path occurs and how much data there is with and without duplicates
+
+	struct Occurrence {
+		usz rom;
+		u64 hash;
+	};
+
+	unordered_map<String, List<Occurrence>> occurrences;
+	unordered_map<u64, u32> contents;
+
+	u64 totalSize{}, uniqueSize{};
+
+	for (usz i = 0; i < indices.size(); ++i)
+		for (const ContentEntry &e : indices[i].getEntries()) {
+
+			occurrences[e.path].push_back({ i, e.hash });
+			totalSize += e.size;
+
+			if (contents.emplace(e.hash, e.size).second)
+				uniqueSize += e.size;
+		}
+
+	List<const String*> sorted;
+	sorted.reserve(occurrences.size());
+
+	for (auto &o : occurrences)
+		sorted.push_back(&o.first);
+
+	std::sort(sorted.begin(), sorted.end(), [](const String *a, const String *b) { return *a < *b; });
+
+	out << "-------\tDiff\t--------" << endl;
+
+	for (usz i = 0; i < paths.size(); ++i)
+		out << i << ": " << paths[i] << (isCached[i] ? " (cached index)" : "") << endl;
+
+	out << endl;
+
+	usz shared{}, changed{}, unique{};
+
+	for (const String *path : sorted) {
+
+		const List<Occurrence> &occ = occurrences[*path];
+
+		if (occ.size() == 1) {
+			out << "unique " << *path << " in " << occ[0].rom << endl;
+			++unique;
+			continue;
+		}
+
+		//Group the ROMs by the version of the file they have
+
+		List<u64> hashes;
+		List<List<usz>> roms;
+
+		for (const Occurrence &o : occ) {
+
+			const usz j = usz(std::find(hashes.begin(), hashes.end(), o.hash) - hashes.begin());
+
+			if (j == hashes.size()) {
+				hashes.push_back(o.hash);
+				roms.emplace_back();
+			}
+
+			roms[j].push_back(o.rom);
+		}
+
+		out << (hashes.size() == 1 ? "shared " : "changed ") << *path << (hashes.size() == 1 ? " in " : ": ");
+
+		for (usz j = 0; j < roms.size(); ++j) {
+
+			if (j)
+				out << " | ";
+
+			for (usz k = 0; k < roms[j].size(); ++k)
+				out << (k ? ", " : "") << roms[j][k];
+		}
+
+		out << endl;
+
+		if (hashes.size() == 1)
+			++shared;
+		else
+			++changed;
+	}
+
+	out
+		<< endl
+		<< "Shared: " << shared << endl
+		<< "Changed: " << changed << endl
+		<< "Unique: " << unique << endl
+		<< "Unique content: " << uniqueSize << " of " << totalSize << " bytes" << endl;
+
+	return 0;
+}
+
+int createPatch(const String &path, NDS*, FileSystem*, std::ostream &out) {
+
+	using namespace std;
+
+	const String base = path.substr(0, path.find_last_of('.'));
+	const String target = base + "_repacked.nds", file = base + ".patch";
+
+	Buffer patch;
+
+	try {
+
+		//Both are mapped as a whole, since the ROM can be bigger than its header says (padding or a signature)
+
+		ROMMapping source(path), repacked(target);
+
+		if (!PatchHelper::create(source.data(), source.size(), repacked.data(), repacked.size(), patch, threadsPerRom)) {
+			out << "ERROR: Couldn't create a patch to \"" << target << "\"" << endl;
+			return 1;
+		}
+
+	} catch (std::runtime_error&) {
+		out << "ERROR: Couldn't read \"" << target << "\"" << endl;
+		return 2;
+	}
+
+	if (!writeFile(file, patch.data(), patch.size())) {
+		out << "ERROR: Couldn't write \"" << file << "\"" << endl;
+		return 3;
+	}
+
+	out << "Created patch \"" << file << "\" of " << patch.size() << " bytes" << endl;
+	return 0;
+}
+
+int applyPatch(const String &path, NDS*, FileSystem*, std::ostream &out) {
+
+	using namespace std;
+
+	const String base = path.substr(0, path.find_last_of('.'));
+	const String file = base + ".patch", target = base + "_patched.nds";
+
+	try {
+
+		ROMMapping source(path);
+
+		if (!PatchHelper::apply(source.data(), source.size(), file, target)) {
+			out << "ERROR: Couldn't apply \"" << file << "\"; it's invalid or made for another rom" << endl;
+			return 1;
+		}
+
+	} catch (std::runtime_error&) {
+		out << "ERROR: Couldn't read \"" << path << "\"" << endl;
+		return 2;
+	}
+
+	out << "Applied \"" << file << "\" to \"" << target << "\"" << endl;
+	return 0;
+}
+
+int verifyChecksums(const String&, NDS *nds, FileSystem*, std::ostream &out) {
+
+	using namespace std;
+
+	usz invalid{};
+
+	for (const Checksum &c : ChecksumHelper::getChecksums((const u8*)nds, nds->romSize)) {
+
+		out << "Checksum " << ChecksumHelper::getName(c.type) << ": 0x" << Log::num<16>(c.stored);
+
+		if (c.isValid())
+			out << " (valid)" << endl;
+
+		else {
+			out << " (invalid, should be 0x" << Log::num<16>(c.computed) << ")" << endl;
+			++invalid;
+		}
+	}
+
+	if (invalid)
+		out << "WARNING: " << invalid << " invalid checksum" << (invalid == 1 ? "" : "s") << endl;
+
+	return 0;
+}
+
+int fixChecksums(const String &path, NDS*, FileSystem*, std::ostream &out) {
+
+	using namespace std;
+
+	List<Checksum> fixed;
+
+	//Fixed in a private mapping first, since checksums depend on each other; then only the changed u16s are written
+
+	try {
+		ROMMapping rom(path, ROMMapping::COPY_ON_WRITE);
+		fixed = ChecksumHelper::fixChecksums(rom.data(), rom.size());
+	} catch (std::runtime_error&) {
+		out << "ERROR: Couldn't read \"" << path << "\"" << endl;
+		return 1;
+	}
+
+	if (fixed.empty()) {
+		out << "All checksums are valid" << endl;
+		return 0;
+	}
+
+	std::FILE *f = std::fopen(path.c_str(), "r+b");
+
+	if (!f) {
+		out << "ERROR: Couldn't open \"" << path << "\" for writing" << endl;
+		return 2;
+	}
+
+	bool success = true;
+
+	for (const Checksum &c : fixed) {
+
+		success &= !std::fseek(f, long(c.offset), SEEK_SET) && std::fwrite(&c.computed, sizeof(c.computed), 1, f) == 1;
+
+		out
+			<< "Fixed " << ChecksumHelper::getName(c.type) << " checksum: 0x"
+			<< Log::num<16>(c.stored) << " -> 0x" << Log::num<16>(c.computed) << endl;
+	}
+
+	if (std::fclose(f) || !success) {
+		out << "ERROR: Couldn't write the checksums to \"" << path << "\"" << endl;
+		return 3;
+	}
+
+	return 0;
+}
+
+//Icons of the previous -icon-atlas run by ROM path; ROMs with the same banner checksum don't have to be decoded again
+
+struct CachedIcon {
+	u16 checksum;
+	c8 gameCode[4];
+	rgba8 pixels[32 * 32];
+};
+
+inline void loadIconCache(const String &file, std::unordered_map<String, CachedIcon> &cache) {
+
+	std::FILE *f = std::fopen(file.c_str(), "rb");
+
+	if (!f)
+		return;
+
+	c8 magic[4];
+	u32 count;
+
+	if (std::fread(magic, 4, 1, f) == 1 && !std::memcmp(magic, "NRIC", 4) && std::fread(&count, 4, 1, f) == 1)
+		for (u32 i = 0; i < count; ++i) {
+
+			u16 len;
+			String path;
+			CachedIcon icon;
+
+			if (std::fread(&len, 2, 1, f) != 1)
+				break;
+
+			path.resize(len);
+
+			if (
+				std::fread(path.data(), 1, len, f) != len ||
+				std::fread(&icon, sizeof(icon), 1, f) != 1
+			)
+				break;
+
+			cache[path] = icon;
+		}
+
+	std::fclose(f);
+}
+
+inline bool saveIconCache(const String &file, const List<String> &paths, const List<CachedIcon> &icons, const List<u8> &hasIcon) {
+
+	std::FILE *f = std::fopen(file.c_str(), "wb");
+
+	if (!f)
+		return false;
+
+	u32 count{};
+
+	for (const u8 has : hasIcon)
+		count += has;
+
+	bool success = std::fwrite("NRIC", 4, 1, f) == 1 && std::fwrite(&count, 4, 1, f) == 1;
+
+	for (usz i = 0; i < paths.size() && success; ++i)
+		if (hasIcon[i]) {
+
+			const u16 len = u16(paths[i].size());
+
+			success =
+				std::fwrite(&len, 2, 1, f) == 1 &&
+				std::fwrite(paths[i].data(), 1, len, f) == len &&
+				std::fwrite(&icons[i], sizeof(icons[i]), 1, f) == 1;
+		}
+
+	return !std::fclose(f) && success;
+}
+
+inline String toJSONString(const String &str) {
+
+	String res = "\"";
+
+	for (const c8 c : str)
+		if (c == '"' || c == '\\') {
+			res += '\\';
+			res += c;
+		}
+
+		else if (u8(c) < 0x20)
+			res += ' ';
+
+		else res += c;
+
+	return res + "\"";
+}
+
+int iconAtlas(const List<String> &paths, usz jobs, std::ostream &out) {
+
+	using namespace std;
+
+	//Every atlas has 32x32 icons; identical icons (regions of the same game) share a rect
+
+	constexpr u16 iconSize = 32, iconsPerRow = 32, atlasSize = iconSize * iconsPerRow;
+	constexpr usz iconsPerAtlas = usz(iconsPerRow) * iconsPerRow;
+
+	const String folder = "icon_atlas", cacheFile = folder + "/cache.bin", indexFile = folder + "/index.json";
+
+	error_code err;
+
+	if (!filesystem::create_directories(folder, err) && err) {
+		out << "ERROR: Couldn't add subdir \"" << folder << "\"" << endl;
+		return 1;
+	}
+
+	unordered_map<String, CachedIcon> cache;
+	loadIconCache(cacheFile, cache);
+
+	//Only the header and banner of every ROM are read, so this mostly waits on the disk
+	//Like -diff, this uses as many threads as -jobs allows
+
+	const usz threads = std::max(jobs, usz(1));
+
+	List<CachedIcon> icons(paths.size());
+	List<u8> hasIcon(paths.size()), isCached(paths.size());
+
+	Parallel::forEach(paths.size(), threads, [&](usz i) {
+
+		try {
+
+			ROMMapping rom(paths[i]);
+			NDS *nds = NDS::get(rom.data(), rom.size());
+			Checksum checksum;
+
+			if (!nds || !ChecksumHelper::getChecksum(rom.data(), nds->romSize, CHECKSUM_BANNER, checksum))
+				return;
+
+			CachedIcon &icon = icons[i];
+			hasIcon[i] = true;
+
+			auto it = cache.find(paths[i]);
+
+			if (it != cache.end() && it->second.checksum == checksum.stored) {
+				icon = it->second;
+				isCached[i] = true;
+				return;
+			}
+
+			icon.checksum = checksum.stored;
+			std::memcpy(icon.gameCode, nds->gameCode, sizeof(icon.gameCode));
+
+			NDSBanner *banner = nds->getBanner();
+			R4_8::toRGBA8Image<true, true>(banner->Icon, icon.pixels, iconSize, iconSize, banner->Palette, 16);
+
+		} catch (std::runtime_error&) {}
+	});
+
+	usz count{}, cached{};
+
+	for (usz i = 0; i < paths.size(); ++i) {
+		count += hasIcon[i];
+		cached += isCached[i];
+	}
+
+	if (cached == count && count == cache.size() && filesystem::exists(indexFile, err)) {
+		out << "Icon atlas of " << count << " roms is up to date" << endl;
+		return 0;
+	}
+
+	//Place the icons
+
+	struct Placed {
+		usz rom;
+		u64 hash;
+	};
+
+	List<Placed> placed;
+	List<usz> slots(paths.size());
+	unordered_map<u64, List<usz>> byHash;
+
+	for (usz i = 0; i < paths.size(); ++i) {
+
+		if (!hasIcon[i])
+			continue;
+
+		const rgba8 *pixels = icons[i].pixels;
+		const u64 hash = HashHelper::xxh64(pixels, sizeof(icons[i].pixels));
+
+		usz slot = usz_MAX;
+
+		for (const usz j : byHash[hash])
+			if (!std::memcmp(icons[placed[j].rom].pixels, pixels, sizeof(icons[i].pixels))) {
+				slot = j;
+				break;
+			}
+
+		if (slot == usz_MAX) {
+			slot = placed.size();
+			placed.push_back({ i, hash });
+			byHash[hash].push_back(slot);
+		}
+
+		slots[i] = slot;
+	}
+
+	//Encode the atlases in parallel; the last one is only as tall as it needs to be
+
+	const usz atlases = (placed.size() + iconsPerAtlas - 1) / iconsPerAtlas;
+	atomic<usz> failed{ usz_MAX };
+
+	Parallel::forEach(atlases, threads, [&](usz a) {
+
+		const usz first = a * iconsPerAtlas, end = std::min(placed.size(), first + iconsPerAtlas);
+		const u16 h = u16(((end - first + iconsPerRow - 1) / iconsPerRow) * iconSize);
+
+		List<rgba8> atlas(usz(atlasSize) * h);
+
+		for (usz j = first; j < end; ++j) {
+
+			const usz x = ((j - first) % iconsPerRow) * iconSize, y = ((j - first) / iconsPerRow) * iconSize;
+			const rgba8 *pixels = icons[placed[j].rom].pixels;
+
+			for (usz k = 0; k < iconSize; ++k)
+				std::memcpy(atlas.data() + (y + k) * atlasSize + x, pixels + k * iconSize, iconSize * sizeof(rgba8));
+		}
+
+		if (!writePng(folder + "/atlas_" + to_string(a) + ".png", atlas, atlasSize, h))
+			failed = a;
+	});
+
+	if (failed != usz_MAX) {
+		out << "ERROR: Couldn't write atlas " << failed << endl;
+		return 2;
+	}
+
+	//Index by game code; every rom gets an entry, since revisions can share a game code
+
+	ostringstream json;
+	json << "{\n\t\"iconSize\": " << iconSize << ",\n\t\"atlases\": [";
+
+	for (usz a = 0; a < atlases; ++a)
+		json << (a ? ", " : "") << "\"atlas_" << a << ".png\"";
+
+	json << "],\n\t\"icons\": [";
+
+	bool isFirst = true;
+
+	for (usz i = 0; i < paths.size(); ++i) {
+
+		if (!hasIcon[i])
+			continue;
+
+		const usz slot = slots[i], a = slot / iconsPerAtlas, local = slot % iconsPerAtlas;
+
+		json
+			<< (isFirst ? "\n" : ",\n")
+			<< "\t\t{ \"gameCode\": " << toJSONString(String(icons[i].gameCode, icons[i].gameCode + 4))
+			<< ", \"rom\": " << toJSONString(paths[i])
+			<< ", \"atlas\": " << a
+			<< ", \"x\": " << (local % iconsPerRow) * iconSize
+			<< ", \"y\": " << (local / iconsPerRow) * iconSize
+			<< ", \"w\": " << iconSize << ", \"h\": " << iconSize << " }";
+
+		isFirst = false;
+	}
+
+	json << "\n\t]\n}\n";
+
+	const String index = json.str();
+
+	if (!writeFile(indexFile, index.data(), index.size())) {
+		out << "ERROR: Couldn't write \"" << indexFile << "\"" << endl;
+		return 3;
+	}
 
-	u8 *ptr = (u8*)nds;
+	if (!saveIconCache(cacheFile, paths, icons, hasIcon))
+		out << "WARNING: Couldn't write \"" << cacheFile << "\"; all icons will be decoded again next time" << endl;
 
-	for (auto &f : fs->getVirtualFiles())
-		if(f.isFolder())
-			logFile(ptr, f);
+	out
+		<< "Packed " << count << " icons (" << placed.size() << " unique) into " << atlases
+		<< " atlas" << (atlases == 1 ? "" : "es") << "; " << (count - cached) << " decoded, " << cached << " cached" << endl;
 
 	return 0;
 }
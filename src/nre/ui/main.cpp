@@ -1,6 +1,8 @@
 #include "ui.hpp"
 #include "system/viewport_manager.hpp"
 #include "system/local_file_system.hpp"
+#include "helper/rom_mapping.hpp"
+#include <memory>
 
 using namespace oic;
 using namespace ignis;
@@ -9,11 +11,16 @@ using namespace nre;
 int main(int argc, char *argv[]) {
 
 	NDS *nds{};
-	Buffer buffer;
+	std::unique_ptr<ROMMapping> rom;
+
+	//The explorer can edit header fields, so those edits have to stay private to our mapping
 
 	if (argc == 2 && oic::System::files()->exists(argv[1])) {
-		oic::System::files()->read(argv[1], buffer);
-		nds = NDS::get(buffer.data(), buffer.size());
+
+		try {
+			rom = std::make_unique<ROMMapping>(argv[1], ROMMapping::COPY_ON_WRITE);
+			nds = NDS::get(rom->data(), rom->size());
+		} catch (std::runtime_error&) {}
 	}
 
 	Graphics g(nds ? "NRE - " + String(nds->title) : "NRE", 1, "Igx", 1);